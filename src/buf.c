@@ -11,6 +11,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+// Allocations made in this file are accounted as buffer allocations.
+#define NATS_MEM_CATEGORY   natsAlloc_Buffers
+
 #include <string.h>
 #include <assert.h>
 
@@ -438,25 +438,288 @@ natsSock_ReadLine(natsSockCtx *ctx, char *buffer, size_t maxBufferSize)
     }
 }
 
+#if defined(NATS_HAS_TLS)
+
+// Size of the buffer used to stage encrypted data before sending it.
+#define _TLS_OUT_SIZE_      (32768)
+
+// Maximum amount of clear data encrypted per natsSock_Write() call, so
+// that the memory BIO does not grow too much.
+#define _TLS_MAX_WRITE_     (65536)
+
+natsStatus
+natsSock_UseTLSMemoryBIOs(natsSockCtx *ctx, SSL *ssl)
+{
+    natsStatus  s     = NATS_OK;
+    BIO         *rbio = NULL;
+    BIO         *wbio = NULL;
+
+    if (ctx->tlsSendMu == NULL)
+        s = natsMutex_Create(&(ctx->tlsSendMu));
+    if ((s == NATS_OK) && (ctx->tlsOut == NULL))
+    {
+        ctx->tlsOut = (char*) NATS_MALLOC(_TLS_OUT_SIZE_);
+        if (ctx->tlsOut == NULL)
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    if (s == NATS_OK)
+    {
+        rbio = BIO_new(BIO_s_mem());
+        wbio = BIO_new(BIO_s_mem());
+        if ((rbio == NULL) || (wbio == NULL))
+        {
+            BIO_free(rbio);
+            BIO_free(wbio);
+            s = nats_setError(NATS_SSL_ERROR, "Error creating memory BIOs: %s",
+                              NATS_SSL_ERR_REASON_STRING);
+        }
+    }
+    if (s == NATS_OK)
+    {
+        // An empty BIO means "retry", not end of file.
+        BIO_set_mem_eof_return(rbio, -1);
+        BIO_set_mem_eof_return(wbio, -1);
+
+        // This releases the socket BIO (the socket itself is not closed).
+        SSL_set_bio(ssl, rbio, wbio);
+        ctx->tlsMemBIO = true;
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Sends 'len' bytes of encrypted data, waiting up to the deadline when
+// the socket is not ready.
+static natsStatus
+_tlsSendRaw(natsSockCtx *ctx, const char *data, int len)
+{
+    natsStatus  s = NATS_OK;
+    int         bytes;
+
+    while ((s == NATS_OK) && (len > 0))
+    {
+#ifdef MSG_NOSIGNAL
+        bytes = send(ctx->fd, data, len, MSG_NOSIGNAL);
+#else
+        bytes = send(ctx->fd, data, len, 0);
+#endif
+        if (bytes == 0)
+            return nats_setDefaultError(NATS_CONNECTION_CLOSED);
+
+        if (bytes < 0)
+        {
+            if (NATS_SOCK_GET_ERROR != NATS_SOCK_WOULD_BLOCK)
+                return nats_setError(NATS_IO_ERROR, "send error: %d",
+                                     NATS_SOCK_GET_ERROR);
+
+            s = natsSock_WaitReady(WAIT_FOR_WRITE, ctx);
+            continue;
+        }
+        data += bytes;
+        len  -= bytes;
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Sends everything OpenSSL has produced in the write BIO. The SSL lock is
+// only held to copy the data out of the BIO.
+//
+// Must be called with ctx->tlsSendMu held.
+static natsStatus
+_tlsFlushOut(natsSockCtx *ctx)
+{
+    natsStatus  s = NATS_OK;
+    int         n;
+
+    while (s == NATS_OK)
+    {
+        natsMutex_Lock(ctx->sslMu);
+        n = BIO_read(SSL_get_wbio(ctx->ssl), ctx->tlsOut, _TLS_OUT_SIZE_);
+        natsMutex_Unlock(ctx->sslMu);
+
+        if (n <= 0)
+            break;
+
+        s = _tlsSendRaw(ctx, ctx->tlsOut, n);
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+static natsStatus
+_tlsMemBIORead(natsSockCtx *ctx, char *buffer, size_t maxBufferSize, int *n)
+{
+    natsStatus  s = NATS_OK;
+
+    for (;;)
+    {
+        int     readBytes;
+        int     sslErr  = 0;
+        bool    pending = false;
+
+        natsMutex_Lock(ctx->sslMu);
+        readBytes = SSL_read(ctx->ssl, buffer, (int) maxBufferSize);
+        if (readBytes <= 0)
+            sslErr = SSL_get_error(ctx->ssl, readBytes);
+        pending = (BIO_ctrl_pending(SSL_get_wbio(ctx->ssl)) > 0);
+        natsMutex_Unlock(ctx->sslMu);
+
+        // Processing incoming records may produce some to send back
+        // (alerts, key updates).
+        if (pending)
+        {
+            natsMutex_Lock(ctx->tlsSendMu);
+            s = _tlsFlushOut(ctx);
+            natsMutex_Unlock(ctx->tlsSendMu);
+
+            if (s != NATS_OK)
+                return NATS_UPDATE_ERR_STACK(s);
+        }
+
+        if (readBytes > 0)
+        {
+            nats_atomicAdd64(&(ctx->readBytes), readBytes);
+            if (n != NULL)
+                *n = readBytes;
+
+            return NATS_OK;
+        }
+        if (sslErr == SSL_ERROR_ZERO_RETURN)
+            return nats_setDefaultError(NATS_CONNECTION_CLOSED);
+        if (sslErr != SSL_ERROR_WANT_READ)
+            return nats_setError(NATS_IO_ERROR, "SSL_read error: %s",
+                                 NATS_SSL_ERR_REASON_STRING);
+
+        // OpenSSL needs more encrypted data. Read it from the socket into
+        // the caller's buffer, which is not in use at this point, without
+        // holding the SSL lock.
+        nats_atomicAdd64(&(ctx->readCalls), 1);
+        readBytes = recv(ctx->fd, buffer, (natsRecvLen) maxBufferSize, 0);
+        if (readBytes == 0)
+            return nats_setDefaultError(NATS_CONNECTION_CLOSED);
+
+        if (readBytes < 0)
+        {
+            if (NATS_SOCK_GET_ERROR != NATS_SOCK_WOULD_BLOCK)
+                return nats_setError(NATS_IO_ERROR, "recv error: %d",
+                                     NATS_SOCK_GET_ERROR);
+
+            s = natsSock_WaitReady(WAIT_FOR_READ, ctx);
+            if (s != NATS_OK)
+                return NATS_UPDATE_ERR_STACK(s);
+
+            continue;
+        }
+
+        natsMutex_Lock(ctx->sslMu);
+        if (BIO_write(SSL_get_rbio(ctx->ssl), buffer, readBytes) != readBytes)
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+        natsMutex_Unlock(ctx->sslMu);
+
+        if (s != NATS_OK)
+            return s;
+    }
+}
+
+static natsStatus
+_tlsMemBIOWrite(natsSockCtx *ctx, const char *data, int len, int *n)
+{
+    natsStatus  s      = NATS_OK;
+    int         bytes  = 0;
+    int         sslErr = 0;
+
+    if (len > _TLS_MAX_WRITE_)
+        len = _TLS_MAX_WRITE_;
+
+    // Holding the send lock while encrypting ensures that records are sent
+    // in the order they were produced.
+    natsMutex_Lock(ctx->tlsSendMu);
+
+    natsMutex_Lock(ctx->sslMu);
+    bytes = SSL_write(ctx->ssl, data, len);
+    if (bytes <= 0)
+        sslErr = SSL_get_error(ctx->ssl, bytes);
+    natsMutex_Unlock(ctx->sslMu);
+
+    if (sslErr == SSL_ERROR_ZERO_RETURN)
+        s = nats_setDefaultError(NATS_CONNECTION_CLOSED);
+    else if (sslErr != 0)
+        s = nats_setError(NATS_IO_ERROR, "SSL_write error: %s",
+                          NATS_SSL_ERR_REASON_STRING);
+    else
+        s = _tlsFlushOut(ctx);
+
+    natsMutex_Unlock(ctx->tlsSendMu);
+
+    if ((s == NATS_OK) && (n != NULL))
+        *n = bytes;
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+#endif // NATS_HAS_TLS
+
 natsStatus
 natsSock_Read(natsSockCtx *ctx, char *buffer, size_t maxBufferSize, int *n)
 {
     natsStatus  s         = NATS_OK;
     int         readBytes = 0;
     bool        needRead  = true;
+#if defined(NATS_HAS_TLS)
+    bool        resumeSSL = false;
+
+    if (ctx->tlsMemBIO)
+        return _tlsMemBIORead(ctx, buffer, maxBufferSize, n);
+#endif
 
     while (needRead)
     {
 #if defined(NATS_HAS_TLS)
-        if (ctx->ssl != NULL)
+        bool useSSL = (ctx->ssl != NULL);
+        bool counted = false;
+
+        // With kTLS, the kernel decrypts the records and application data
+        // can be read with recv(). Other records (alerts, post-handshake
+        // messages) make recv() fail with EIO and are left in the socket
+        // for OpenSSL to process. Once OpenSSL has started, recv() is not
+        // used until it has returned everything it has read, which may be
+        // more than the buffer can hold, and it is resumed as is after it
+        // asks to wait.
+        if (useSSL && ctx->ktlsRecv && !resumeSSL)
+        {
+            int pending;
+
+            if (!ctx->ktlsSend)
+                natsMutex_Lock(ctx->sslMu);
+            pending = SSL_pending(ctx->ssl);
+            if (!ctx->ktlsSend)
+                natsMutex_Unlock(ctx->sslMu);
+
+            if (pending == 0)
+            {
+                nats_atomicAdd64(&(ctx->readCalls), 1);
+                counted   = true;
+                readBytes = recv(ctx->fd, buffer, (natsRecvLen) maxBufferSize, 0);
+                useSSL    = ((readBytes < 0) && (NATS_SOCK_GET_ERROR == EIO));
+            }
+        }
+        if (useSSL)
         {
             int sslErr = 0;
 
-            natsMutex_Lock(ctx->sslMu);
+            // The lock is not needed if writes do not use the SSL object.
+            if (!ctx->ktlsSend)
+                natsMutex_Lock(ctx->sslMu);
+            // The SSL_read() that processes what recv() could not is counted
+            // with it as a single read.
+            if (!counted)
+                nats_atomicAdd64(&(ctx->readCalls), 1);
             readBytes = SSL_read(ctx->ssl, buffer, (int) maxBufferSize);
             if (readBytes < 0)
                 sslErr = SSL_get_error(ctx->ssl, readBytes);
-            natsMutex_Unlock(ctx->sslMu);
+            if (!ctx->ktlsSend)
+                natsMutex_Unlock(ctx->sslMu);
 
             if (sslErr != 0)
             {
@@ -467,19 +730,24 @@ natsSock_Read(natsSockCtx *ctx, char *buffer, size_t maxBufferSize, int *n)
                 {
                     int waitMode = (sslErr == SSL_ERROR_WANT_READ ? WAIT_FOR_READ : WAIT_FOR_WRITE);
 
+                    nats_atomicAdd64(&(ctx->readWaits), 1);
                     if ((s = natsSock_WaitReady(waitMode, ctx)) != NATS_OK)
                         return NATS_UPDATE_ERR_STACK(s);
 
                     // SSL requires that we go back with the same buffer
                     // and size. We can't return until SSL_read returns
                     // success (bytes read) or a different error.
+                    resumeSSL = true;
                     continue;
                 }
             }
         }
-        else
+        else if (ctx->ssl == NULL)
 #endif
+        {
+            nats_atomicAdd64(&(ctx->readCalls), 1);
             readBytes = recv(ctx->fd, buffer, (natsRecvLen) maxBufferSize, 0);
+        }
 
         if (readBytes == 0)
         {
@@ -490,7 +758,7 @@ natsSock_Read(natsSockCtx *ctx, char *buffer, size_t maxBufferSize, int *n)
             if (NATS_SOCK_GET_ERROR != NATS_SOCK_WOULD_BLOCK)
             {
 #if defined(NATS_HAS_TLS)
-                if (ctx->ssl != NULL)
+                if (useSSL)
                     return nats_setError(NATS_IO_ERROR, "SSL_read error: %s",
                                         NATS_SSL_ERR_REASON_STRING);
                 else
@@ -510,6 +778,7 @@ natsSock_Read(natsSockCtx *ctx, char *buffer, size_t maxBufferSize, int *n)
 
             // For non-blocking sockets, if the read would block, we need to
             // wait up to the deadline.
+            nats_atomicAdd64(&(ctx->readWaits), 1);
             s = natsSock_WaitReady(WAIT_FOR_READ, ctx);
             if (s != NATS_OK)
                 return NATS_UPDATE_ERR_STACK(s);
@@ -517,6 +786,8 @@ natsSock_Read(natsSockCtx *ctx, char *buffer, size_t maxBufferSize, int *n)
             continue;
         }
 
+        nats_atomicAdd64(&(ctx->readBytes), readBytes);
+
         if (n != NULL)
             *n = readBytes;
 
@@ -533,10 +804,17 @@ natsSock_Write(natsSockCtx *ctx, const char *data, int len, int *n)
     int         bytes     = 0;
     bool        needWrite = true;
 
+#if defined(NATS_HAS_TLS)
+    if (ctx->tlsMemBIO)
+        return _tlsMemBIOWrite(ctx, data, len, n);
+#endif
+
     while (needWrite)
     {
 #if defined(NATS_HAS_TLS)
-        if (ctx->ssl != NULL)
+        // With kTLS, the kernel builds and encrypts the records, so data
+        // is written with send() like for a plain connection.
+        if ((ctx->ssl != NULL) && !ctx->ktlsSend)
         {
             int sslErr = 0;
 
@@ -582,7 +860,7 @@ natsSock_Write(natsSockCtx *ctx, const char *data, int len, int *n)
             if (NATS_SOCK_GET_ERROR != NATS_SOCK_WOULD_BLOCK)
             {
 #if defined(NATS_HAS_TLS)
-                if (ctx->ssl != NULL)
+                if ((ctx->ssl != NULL) && !ctx->ktlsSend)
                     return nats_setError(NATS_IO_ERROR, "SSL_write error: %s",
                                          NATS_SSL_ERR_REASON_STRING);
                 else
@@ -653,6 +931,110 @@ natsSock_WriteFully(natsSockCtx *ctx, const char *data, int len)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+natsStatus
+natsSock_WriteFullyV(natsSockCtx *ctx, natsIOVec *iov, int count)
+{
+    natsStatus  s     = NATS_OK;
+    int64_t     bytes = 0;
+    int         n     = 0;
+
+#if defined(NATS_HAS_TLS)
+    // There is no gather variant of SSL_write(), so write each segment
+    // in turn. This still avoids having to copy them in a single buffer.
+    if (ctx->ssl != NULL)
+    {
+        for (; (s == NATS_OK) && (count > 0); iov++, count--)
+            s = natsSock_WriteFully(ctx, (const char*) natsIOVec_Base(iov),
+                                    (int) natsIOVec_Len(iov));
+
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+#endif
+
+    while (count > 0)
+    {
+        // Skip segments that have been fully written (or are empty).
+        if (natsIOVec_Len(iov) == 0)
+        {
+            iov++;
+            count--;
+            continue;
+        }
+
+        n = (count > NATS_IOV_MAX ? NATS_IOV_MAX : count);
+
+#ifdef _WIN32
+        {
+            DWORD sent = 0;
+
+            if (WSASend(ctx->fd, iov, (DWORD) n, &sent, 0, NULL, NULL) == 0)
+                bytes = (int64_t) sent;
+            else
+                bytes = -1;
+        }
+#else
+        {
+            struct msghdr mh;
+
+            memset(&mh, 0, sizeof(mh));
+            mh.msg_iov    = iov;
+            mh.msg_iovlen = n;
+#ifdef MSG_NOSIGNAL
+            bytes = (int64_t) sendmsg(ctx->fd, &mh, MSG_NOSIGNAL);
+#else
+            bytes = (int64_t) sendmsg(ctx->fd, &mh, 0);
+#endif
+        }
+#endif
+        if (bytes == 0)
+        {
+            s = nats_setDefaultError(NATS_CONNECTION_CLOSED);
+            break;
+        }
+        else if (bytes < 0)
+        {
+            if (NATS_SOCK_GET_ERROR != NATS_SOCK_WOULD_BLOCK)
+            {
+                s = nats_setError(NATS_IO_ERROR, "sendmsg error: %d",
+                                  NATS_SOCK_GET_ERROR);
+                break;
+            }
+
+            // For non-blocking sockets, if the write would block, we need to
+            // wait up to the deadline.
+            s = natsSock_WaitReady(WAIT_FOR_WRITE, ctx);
+            if (s != NATS_OK)
+                break;
+
+            continue;
+        }
+
+        // Move past what has been written. The last segment may have been
+        // only partially written.
+        while ((count > 0) && (bytes >= (int64_t) natsIOVec_Len(iov)))
+        {
+            bytes -= (int64_t) natsIOVec_Len(iov);
+            iov++;
+            count--;
+        }
+        if (bytes > 0)
+        {
+            natsIOVec_Base(iov) = (char*) natsIOVec_Base(iov) + bytes;
+            natsIOVec_Len(iov) -= bytes;
+        }
+    }
+
+    // If we are using a write deadline, shutdown the socket to trigger a
+    // possible reconnect
+    if (s == NATS_TIMEOUT)
+    {
+        natsSock_Shutdown(ctx->fd);
+        ctx->fdActive = false;
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 void
 natsSock_ClearDeadline(natsSockCtx *ctx)
 {
@@ -68,6 +68,23 @@ natsSock_Write(natsSockCtx *ctx, const char *data, int len, int *n);
 natsStatus
 natsSock_WriteFully(natsSockCtx *ctx, const char *data, int len);
 
+// Writes the 'count' segments of 'iov', in order, using a single gather
+// write when possible. Like natsSock_WriteFully(), does not return until
+// all bytes have been written, unless the socket is closed or an error
+// occurs. The content of 'iov' is modified to account for partial writes.
+// This must not be used when an external event loop is used.
+natsStatus
+natsSock_WriteFullyV(natsSockCtx *ctx, natsIOVec *iov, int count);
+
+#if defined(NATS_HAS_TLS)
+// Switches the established TLS session of this context to memory BIOs, so
+// that natsSock_Read() and natsSock_Write() perform the socket I/O without
+// holding the lock that protects the SSL object. This must not be used
+// when an external event loop is used.
+natsStatus
+natsSock_UseTLSMemoryBIOs(natsSockCtx *ctx, SSL *ssl);
+#endif
+
 natsStatus
 natsSock_Flush(natsSock fd);
 
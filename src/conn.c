@@ -213,6 +213,23 @@ _destroyRespMuxer(respMuxer *mux)
     // The muxer is an embedded structure in `natsConnection`, so don't free `mux`.
 }
 
+// Invokes the release callback of all data referenced by an outbound
+// buffer with the given status, and clears the list.
+static void
+_releaseWriteRefs(natsConnection *nc, natsWriteRefs *refs, natsStatus s)
+{
+    int i;
+
+    for (i=0; i<refs->count; i++)
+    {
+        natsWriteRef *ref = &(refs->list[i]);
+
+        (*(ref->cb))(nc, (const void*) ref->data, ref->dataLen, s, ref->closure);
+    }
+    refs->count = 0;
+    refs->bytes = 0;
+}
+
 static void
 _freeConn(natsConnection *nc)
 {
@@ -222,19 +239,31 @@ _freeConn(natsConnection *nc)
     natsTimer_Destroy(nc->ptmr);
     natsBuf_Destroy(nc->pending);
     natsBuf_Destroy(nc->scratch);
+    _releaseWriteRefs(nc, &(nc->wrefs), NATS_CONNECTION_CLOSED);
+    NATS_FREE(nc->wrefs.list);
+    NATS_FREE(nc->wrefs.iov);
+    NATS_FREE(nc->wrefsOut.list);
+    NATS_FREE(nc->wrefsOut.iov);
     natsBuf_Destroy(nc->bw);
+    natsBuf_Destroy(nc->bwOut);
     natsSrvPool_Destroy(nc->srvPool);
     _clearServerInfo(&(nc->info));
     natsCondition_Destroy(nc->flusherCond);
+    natsCondition_Destroy(nc->flushingCond);
+    natsMutex_Destroy(nc->writeMu);
     natsCondition_Destroy(nc->pongs.cond);
     natsParser_Destroy(nc->ps);
     natsThread_Destroy(nc->readLoopThread);
     natsThread_Destroy(nc->flusherThread);
     natsHash_Destroy(nc->subs);
+    natsMsgPool_Release(nc->msgPool);
+    natsReadChunkPool_Release(nc->readChunks);
     natsOptions_Destroy(nc->opts);
     if (nc->sockCtx.ssl != NULL)
         SSL_free(nc->sockCtx.ssl);
     natsMutex_Destroy(nc->sockCtx.sslMu);
+    natsMutex_Destroy(nc->sockCtx.tlsSendMu);
+    NATS_FREE(nc->sockCtx.tlsOut);
     NATS_FREE(nc->el.buffer);
     _destroyRespMuxer(&nc->respMux);
     natsCondition_Destroy(nc->reconnectCond);
@@ -309,16 +338,100 @@ natsConn_unlockAndRelease(natsConnection *nc)
         _freeConn(nc);
 }
 
-natsStatus
-natsConn_bufferFlush(natsConnection *nc)
+// Builds, in `refs->iov`, the list of segments made of the content
+// of `buf` interleaved with the referenced user data.
+static natsStatus
+_buildWriteRefsIOVec(natsWriteRefs *refs, natsBuffer *buf, int *count)
+{
+    char    *data = natsBuf_Data(buf);
+    int     prev  = 0;
+    int     n     = 0;
+    int     need  = (2 * refs->count) + 1;
+    int     i;
+
+    if (refs->iovCap < need)
+    {
+        natsIOVec *iov = (natsIOVec*) NATS_REALLOC(refs->iov, need * sizeof(natsIOVec));
+        if (iov == NULL)
+            return nats_setDefaultError(NATS_NO_MEMORY);
+
+        refs->iov    = iov;
+        refs->iovCap = need;
+    }
+    for (i=0; i<refs->count; i++)
+    {
+        natsWriteRef *ref = &(refs->list[i]);
+
+        if (ref->pos > prev)
+        {
+            natsIOVec_Base(&(refs->iov[n])) = data + prev;
+            natsIOVec_Len(&(refs->iov[n]))  = ref->pos - prev;
+            n++;
+            prev = ref->pos;
+        }
+        natsIOVec_Base(&(refs->iov[n])) = (char*) ref->data;
+        natsIOVec_Len(&(refs->iov[n]))  = ref->dataLen;
+        n++;
+    }
+    if (natsBuf_Len(buf) > prev)
+    {
+        natsIOVec_Base(&(refs->iov[n])) = data + prev;
+        natsIOVec_Len(&(refs->iov[n]))  = natsBuf_Len(buf) - prev;
+        n++;
+    }
+    *count = n;
+
+    return NATS_OK;
+}
+
+// Factor of the IO buffer size up to which the outbound buffer may grow while
+// the flusher thread writes. Past it, natsConn_bufferWrite() waits for the
+// flusher's write to complete, holding the lock.
+#define _FLUSHING_MAX_BUF_FACTOR_   (2)
+
+// While the flusher thread writes, the outbound buffer is not written in
+// place, so this is where publishers get throttled: they wait, before adding
+// a message, that the flusher is done if the buffer is already full.
+// Lock held on entry, released while waiting.
+void
+natsConn_waitForBufferSpace(natsConnection *nc)
+{
+    while (nc->flushing && (natsBuf_Len(nc->bw) >= nc->opts->ioBufSize))
+        natsCondition_Wait(nc->flushingCond, nc->mu);
+}
+
+static natsStatus
+_bufferFlush(natsConnection *nc)
 {
     natsStatus  s      = NATS_OK;
     int         bufLen = natsBuf_Len(nc->bw);
+    int         count  = 0;
+    int         i;
 
-    if (bufLen == 0)
+    if ((bufLen == 0) && (nc->wrefs.count == 0))
         return NATS_OK;
 
-    if (nc->usePending)
+    if (nc->wrefs.count > 0)
+    {
+        s = _buildWriteRefsIOVec(&(nc->wrefs), nc->bw, &count);
+        if (s != NATS_OK)
+        {
+            // Do not reset the buffer, the caller may try again.
+            return NATS_UPDATE_ERR_STACK(s);
+        }
+        if (nc->usePending)
+        {
+            for (i=0; (s == NATS_OK) && (i<count); i++)
+                s = natsBuf_Append(nc->pending,
+                                   (const char*) natsIOVec_Base(&(nc->wrefs.iov[i])),
+                                   (int) natsIOVec_Len(&(nc->wrefs.iov[i])));
+        }
+        else
+        {
+            s = natsSock_WriteFullyV(&(nc->sockCtx), nc->wrefs.iov, count);
+        }
+    }
+    else if (nc->usePending)
     {
         s = natsBuf_Append(nc->pending, natsBuf_Data(nc->bw), bufLen);
     }
@@ -342,6 +455,27 @@ natsConn_bufferFlush(natsConnection *nc)
 
     natsBuf_Reset(nc->bw);
 
+    // Regardless of the outcome, the referenced data is no longer needed.
+    if (nc->wrefs.count > 0)
+        _releaseWriteRefs(nc, &(nc->wrefs), s);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// What the flusher thread took from the buffer needs to reach the socket
+// first, so wait for it to be done writing. The lock is released while
+// waiting, so that publishers are not blocked behind that write.
+// Lock held on entry, released while waiting.
+natsStatus
+natsConn_bufferFlush(natsConnection *nc)
+{
+    natsStatus  s;
+
+    while (nc->flushing)
+        natsCondition_Wait(nc->flushingCond, nc->mu);
+
+    s = _bufferFlush(nc);
+
     return NATS_UPDATE_ERR_STACK(s);
 }
 
@@ -382,11 +516,33 @@ natsConn_bufferWrite(natsConnection *nc, const char *buffer, int len)
         return NATS_UPDATE_ERR_STACK(s);
     }
 
+    // Data written in place would go ahead of what the flusher thread is
+    // currently writing, so buffer it instead. The lock can't be released
+    // here since this may be only part of a protocol message, so past the
+    // limit, wait (with the lock) for the flusher's write to complete and
+    // then write the buffer in place, instead of growing it without bound.
+    if (nc->flushing)
+    {
+        if (natsBuf_Len(nc->bw) + len <= _FLUSHING_MAX_BUF_FACTOR_ * nc->opts->ioBufSize)
+        {
+            s = natsBuf_Append(nc->bw, buffer, len);
+
+            return NATS_UPDATE_ERR_STACK(s);
+        }
+        natsMutex_Lock(nc->writeMu);
+        natsMutex_Unlock(nc->writeMu);
+
+        s = _bufferFlush(nc);
+        if (s != NATS_OK)
+            return NATS_UPDATE_ERR_STACK(s);
+    }
+
     // If we have more data that can fit..
     while ((s == NATS_OK) && (len > natsBuf_Available(nc->bw)))
     {
-        // If there is nothing in the buffer...
-        if (natsBuf_Len(nc->bw) == 0)
+        // If there is nothing in the buffer (nor referenced data
+        // that needs to go out first)...
+        if ((natsBuf_Len(nc->bw) == 0) && (nc->wrefs.count == 0))
         {
             // Do a single socket write to avoid a copy
             s = natsSock_WriteFully(&(nc->sockCtx), buffer + offset, len);
@@ -402,9 +558,10 @@ natsConn_bufferWrite(natsConnection *nc, const char *buffer, int len)
         // Append that much bytes
         s = natsBuf_Append(nc->bw, buffer + offset, avail);
 
-        // Flush the buffer
+        // Flush the buffer. The flusher thread may still be marked as
+        // flushing, but it is done writing.
         if (s == NATS_OK)
-            s = natsConn_bufferFlush(nc);
+            s = _bufferFlush(nc);
 
         // If success, then decrement what's left to send and update the
         // offset.
@@ -422,6 +579,50 @@ natsConn_bufferWrite(natsConnection *nc, const char *buffer, int len)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+// Queues a reference to 'data' so that it is written after what is
+// currently in the buffer, without being copied. The callback 'cb' is
+// invoked when the data is no longer referenced.
+// If the data can't be referenced (when reconnecting or when using an
+// external event loop), it is copied and the callback invoked right away.
+natsStatus
+natsConn_bufferWriteRef(natsConnection *nc, const char *data, int dataLen,
+                        natsPublishReleaseHandler cb, void *closure)
+{
+    natsStatus  s = NATS_OK;
+
+    if ((dataLen <= 0) || nc->usePending || nc->sockCtx.useEventLoop)
+    {
+        s = natsConn_bufferWrite(nc, data, dataLen);
+        if (s == NATS_OK)
+            (*cb)(nc, (const void*) data, dataLen, NATS_OK, closure);
+
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+
+    if (nc->wrefs.count == nc->wrefs.cap)
+    {
+        int             newCap = (nc->wrefs.cap == 0 ? 8 : 2 * nc->wrefs.cap);
+        natsWriteRef    *list  = NULL;
+
+        list = (natsWriteRef*) NATS_REALLOC(nc->wrefs.list, newCap * sizeof(natsWriteRef));
+        if (list == NULL)
+            return nats_setDefaultError(NATS_NO_MEMORY);
+
+        nc->wrefs.list = list;
+        nc->wrefs.cap  = newCap;
+    }
+
+    nc->wrefs.list[nc->wrefs.count].pos     = natsBuf_Len(nc->bw);
+    nc->wrefs.list[nc->wrefs.count].data    = data;
+    nc->wrefs.list[nc->wrefs.count].dataLen = dataLen;
+    nc->wrefs.list[nc->wrefs.count].cb      = cb;
+    nc->wrefs.list[nc->wrefs.count].closure = closure;
+    nc->wrefs.count++;
+    nc->wrefs.bytes += dataLen;
+
+    return NATS_OK;
+}
+
 natsStatus
 natsConn_bufferWriteString(natsConnection *nc, const char *string)
 {
@@ -467,6 +668,8 @@ _createConn(natsConnection *nc)
         else
             natsBuf_Reset(nc->bw);
 
+        _releaseWriteRefs(nc, &(nc->wrefs), NATS_CONNECTION_DISCONNECTED);
+
         if (s == NATS_OK)
             s = ls;
     }
@@ -743,6 +946,12 @@ _makeTLSConn(natsConnection *nc)
     else
     {
         SSL_set_ex_data(ssl, 0, (void*) nc);
+#if defined(SSL_OP_ENABLE_KTLS)
+        // This needs to be set before the handshake. OpenSSL will then
+        // try to configure the socket for kTLS once keys are negotiated.
+        if (nc->opts->tlsKernelOffload)
+            SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+#endif
     }
     if (s == NATS_OK)
     {
@@ -832,18 +1041,44 @@ DO_HANDSHAKE:
             }
         }
     }
+    if (s == NATS_OK)
+    {
+#if defined(SSL_OP_ENABLE_KTLS)
+        nc->sockCtx.ktlsSend = BIO_get_ktls_send(SSL_get_wbio(ssl));
+        nc->sockCtx.ktlsRecv = BIO_get_ktls_recv(SSL_get_rbio(ssl));
+#else
+        nc->sockCtx.ktlsSend = false;
+        nc->sockCtx.ktlsRecv = false;
+#endif
+
+        // Memory BIOs require the library to drive the socket, and kTLS,
+        // when engaged, works on the socket BIO and takes precedence.
+        if (nc->opts->tlsMemoryBIO
+            && (nc->opts->evLoop == NULL) && !nc->el.libIO
+            && !nc->sockCtx.ktlsSend && !nc->sockCtx.ktlsRecv)
+        {
+            s = natsSock_UseTLSMemoryBIOs(&(nc->sockCtx), ssl);
+        }
+    }
     // Make sure that if nc-errStr was set in _collectSSLErr but
     // the overall handshake is ok, then we clear the error
     if (s == NATS_OK)
     {
         nc->errStr[0] = '\0';
         nc->sockCtx.ssl = ssl;
+        nc->stats.tlsHandshakes++;
+        if (nc->sockCtx.ktlsSend)
+            nc->stats.tlsSendOffloads++;
+        if (nc->sockCtx.ktlsRecv)
+            nc->stats.tlsRecvOffloads++;
         if (useLock)
             nc->opts->sslCtx->firstHandshake = false;
     }
     else if (ssl != NULL)
     {
         SSL_free(ssl);
+        nc->sockCtx.ktlsSend = false;
+        nc->sockCtx.ktlsRecv = false;
     }
     if (useLock)
         natsMutex_Unlock(nc->opts->sslCtx->lock);
@@ -1714,7 +1949,9 @@ natsConn_initRespMuxer(natsConnection *nc)
         mux->map        = map;
         mux->jsCtxs     = jsCtxs;
         natsMutex_Lock(nc->subsMu);
+        natsConn_subsWriteBegin(nc);
         mux->sid        = sid;
+        natsConn_subsWriteEnd(nc);
         natsMutex_Unlock(nc->subsMu);
         mux->init       = true;
     }
@@ -1766,7 +2003,10 @@ _clearSSL(natsConnection *nc)
         return;
 
     SSL_free(nc->sockCtx.ssl);
-    nc->sockCtx.ssl = NULL;
+    nc->sockCtx.ssl       = NULL;
+    nc->sockCtx.ktlsSend  = false;
+    nc->sockCtx.ktlsRecv  = false;
+    nc->sockCtx.tlsMemBIO = false;
 }
 
 // Try to reconnect using the option parameters.
@@ -1942,6 +2182,7 @@ _doReconnect(void *arg)
             // may go back to sleep and release the lock
             nc->usePending = true;
             natsBuf_Reset(nc->bw);
+            _releaseWriteRefs(nc, &(nc->wrefs), NATS_CONNECTION_DISCONNECTED);
 
             // We need to cleanup some things if the connection was SSL.
             _clearSSL(nc);
@@ -2038,13 +2279,25 @@ natsConn_flushOrKickFlusher(natsConnection *nc)
 {
     natsStatus s = NATS_OK;
 
-    if (nc->opts->sendAsap)
+    // Referenced data is not accounted for in the buffer size, so flush
+    // in place when it would have filled the buffer.
+    if (nc->opts->sendAsap
+        || ((nc->wrefs.count > 0)
+            && ((natsBuf_Len(nc->bw) + nc->wrefs.bytes) >= nc->opts->ioBufSize)))
     {
         s = natsConn_bufferFlush(nc);
     }
+    else if (nc->el.libIO)
+    {
+        // No flusher thread: once attached, the I/O thread writes the buffer
+        // when the socket is writable, coalescing what is buffered until then.
+        if ((nc->bw != NULL) && (nc->sockCtx.useEventLoop || nc->usePending))
+            s = natsConn_bufferFlush(nc);
+    }
     else if (nc->bw != NULL)
     {
         nc->flusherKicks++;
+        nc->flusherWrites++;
         if (!(nc->flusherSignaled))
         {
             nc->flusherSignaled = true;
@@ -2241,7 +2494,7 @@ _processConnInit(natsConnection *nc)
         // If we are reconnecting, buffer will have already been allocated
         if ((s == NATS_OK) && (nc->el.buffer == NULL))
         {
-            nc->el.buffer = (char*) malloc(nc->opts->ioBufSize);
+            nc->el.buffer = (char*) NATS_MALLOC(nc->opts->ioBufSize);
             if (nc->el.buffer == NULL)
                 s = nats_setDefaultError(NATS_NO_MEMORY);
         }
@@ -2263,6 +2516,9 @@ _processConnInit(natsConnection *nc)
             {
                 nc->el.attached = true;
                 nc->el.retained = true;
+                // The parser may be in use with data of the previous socket,
+                // so it is reset by the next read event instead of here.
+                nc->el.resetParser = (nc->ps != NULL);
             }
             else
             {
@@ -2514,26 +2770,112 @@ _processOpError(natsConnection *nc, natsStatus s, bool initialConnect)
     return false;
 }
 
+// Replaces the read loop buffer with one of 'size' bytes, which is a
+// read chunk if zero-copy messages are enabled.
+static natsStatus
+_resetReadBuffer(natsConnection *nc, char **buffer, natsReadChunk **chunk, int size)
+{
+    natsStatus s = NATS_OK;
+
+    if (nc->readChunks != NULL)
+    {
+        natsReadChunk_Release(*chunk);
+        *chunk  = NULL;
+        *buffer = NULL;
+        s = natsReadChunkPool_Get(nc->readChunks, size, chunk);
+        if (s == NATS_OK)
+            *buffer = natsReadChunk_Data(*chunk);
+    }
+    else
+    {
+        NATS_FREE(*buffer);
+        *buffer = NATS_MALLOC(size);
+        if (*buffer == NULL)
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    if (s == NATS_OK)
+        nats_atomicStoreInt(&(nc->readBufSize), size);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Returns the size the read buffer should have after a read of 'n' bytes.
+// The buffer grows when reads fill it and shrinks, to no less than four
+// times the largest of the last reads, when they all used less than a
+// quarter of it.
+int
+natsConn_adaptReadBufSize(natsConnection *nc, int bufSize, int n, int *lowReads, int *maxRead)
+{
+    int minSize = nc->opts->ioBufMinSize;
+    int maxSize = nc->opts->ioBufMaxSize;
+
+    if (n >= bufSize)
+    {
+        *lowReads = 0;
+        *maxRead  = 0;
+        return ((bufSize <= maxSize / 2) ? bufSize * 2 : maxSize);
+    }
+    if (n > bufSize / 4)
+    {
+        *lowReads = 0;
+        *maxRead  = 0;
+        return bufSize;
+    }
+    if (n > *maxRead)
+        *maxRead = n;
+    if (++(*lowReads) < READ_BUF_SHRINK_AFTER)
+        return bufSize;
+
+    // Halve only while the halved buffer still holds four of those reads.
+    while ((bufSize / 2 >= minSize) && (*maxRead <= bufSize / 8))
+        bufSize /= 2;
+
+    *lowReads = 0;
+    *maxRead  = 0;
+
+    return bufSize;
+}
+
 static void
 _readLoop(void  *arg)
 {
-    natsStatus  s = NATS_OK;
-    char        *buffer;
-    int         n;
-    int         bufSize;
+    natsStatus      s         = NATS_OK;
+    char            *buffer   = NULL;
+    natsReadChunk   *chunk    = NULL;
+    bool            adaptive  = false;
+    bool            batching  = false;
+    bool            waitFirst = false;
+    int             lowReads  = 0;
+    int             maxRead   = 0;
+    int             n;
+    int             bufSize;
+    int             newSize;
 
     natsConnection *nc = (natsConnection*) arg;
 
     natsConn_Lock(nc);
 
-    bufSize = nc->opts->ioBufSize;
-    buffer = NATS_MALLOC(bufSize);
-    if (buffer == NULL)
-        s = nats_setDefaultError(NATS_NO_MEMORY);
+    bufSize  = nc->opts->ioBufSize;
+    adaptive = (nc->opts->ioBufMaxSize > 0);
+    if (adaptive)
+    {
+        if (bufSize < nc->opts->ioBufMinSize)
+            bufSize = nc->opts->ioBufMinSize;
+        else if (bufSize > nc->opts->ioBufMaxSize)
+            bufSize = nc->opts->ioBufMaxSize;
+    }
+    // A blocking socket already waits in recv(), and with TLS, data may be
+    // buffered by the SSL layer, so we can't wait for the socket first.
+    batching = (nc->opts->readBatching
+                && (nc->opts->writeDeadline > 0)
+                && (nc->sockCtx.ssl == NULL));
+    newSize  = bufSize;
+
+    s = _resetReadBuffer(nc, &buffer, &chunk, bufSize);
 
     natsDeadline_Clear(&(nc->sockCtx.readDeadline));
 
-    if (nc->ps == NULL)
+    if ((s == NATS_OK) && (nc->ps == NULL))
         s = natsParser_Create(&(nc->ps));
 
     while ((s == NATS_OK)
@@ -2542,13 +2884,39 @@ _readLoop(void  *arg)
     {
         natsConn_Unlock(nc);
 
+        // If messages point into the chunk, don't overwrite it: read
+        // into another one.
+        if ((newSize != bufSize)
+            || ((chunk != NULL) && natsReadChunk_IsShared(chunk)))
+        {
+            bufSize = newSize;
+            s = _resetReadBuffer(nc, &buffer, &chunk, bufSize);
+        }
+
         n = 0;
 
-        s = natsSock_Read(&(nc->sockCtx), buffer, bufSize, &n);
+        // In batching mode, this wait replaces the one natsSock_Read() would
+        // do after a recv() that returns EAGAIN: it does not add a system call
+        // but avoids that recv().
+        if ((s == NATS_OK) && waitFirst)
+        {
+            nats_atomicAdd64(&(nc->sockCtx.readWaits), 1);
+            s = natsSock_WaitReady(WAIT_FOR_READ, &(nc->sockCtx));
+        }
+        IFOK(s, natsSock_Read(&(nc->sockCtx), buffer, bufSize, &n));
         if ((s == NATS_IO_ERROR) && (NATS_SOCK_GET_ERROR == NATS_SOCK_WOULD_BLOCK))
             s = NATS_OK;
         if ((s == NATS_OK) && (n > 0))
+        {
+            nc->ps->chunk    = chunk;
+            nc->ps->chunkLen = n;
             s = natsParser_Parse(nc, buffer, n);
+            nc->ps->chunk    = NULL;
+
+            if (adaptive)
+                newSize = natsConn_adaptReadBufSize(nc, bufSize, n, &lowReads, &maxRead);
+        }
+        waitFirst = (batching && (n < bufSize));
 
         if (s != NATS_OK)
             _processOpError(nc, s, false);
@@ -2556,7 +2924,18 @@ _readLoop(void  *arg)
         natsConn_Lock(nc);
     }
 
-    NATS_FREE(buffer);
+    if (nc->readChunks != NULL)
+        natsReadChunk_Release(chunk);
+    else
+        NATS_FREE(buffer);
+
+    // The flusher thread may still be writing to the socket (it has been
+    // shutdown, so that won't be long).
+    if (nc->flushing)
+    {
+        natsMutex_Lock(nc->writeMu);
+        natsMutex_Unlock(nc->writeMu);
+    }
 
     natsSock_Close(nc->sockCtx.fd);
     nc->sockCtx.fd       = NATS_SOCK_INVALID;
@@ -2573,17 +2952,138 @@ _readLoop(void  *arg)
     natsConn_unlockAndRelease(nc);
 }
 
+// Swaps the outbound buffer (and the data it references) with an empty one
+// and writes it without holding the lock, so that publishers can keep on
+// buffering meanwhile instead of waiting for the socket write to complete.
+// Lock held on entry and on return.
+static natsStatus
+_flusherWrite(natsConnection *nc)
+{
+    natsStatus      s     = NATS_OK;
+    natsBuffer      *buf  = nc->bw;
+    natsWriteRefs   refs  = nc->wrefs;
+    natsSockCtx     ctx;
+    int             count = 0;
+
+    // Nothing is actually written from here in these cases.
+    if (nc->sockCtx.useEventLoop || nc->usePending)
+        return natsConn_bufferFlush(nc);
+
+    if ((nc->bwOut == NULL)
+        && (natsBuf_Create(&(nc->bwOut), nc->opts->ioBufSize) != NATS_OK))
+    {
+        nats_clearLastError();
+        return natsConn_bufferFlush(nc);
+    }
+
+    nc->bw       = nc->bwOut;
+    nc->bwOut    = NULL;
+    nc->wrefs    = nc->wrefsOut;
+    nc->flushing = true;
+
+    // Write with a copy of the socket context: the write deadline of the
+    // connection's one is reset by publishers.
+    ctx = nc->sockCtx;
+
+    natsMutex_Lock(nc->writeMu);
+    natsConn_Unlock(nc);
+
+    if (refs.count > 0)
+    {
+        s = _buildWriteRefsIOVec(&refs, buf, &count);
+        IFOK(s, natsSock_WriteFullyV(&ctx, refs.iov, count));
+    }
+    else
+    {
+        s = natsSock_WriteFully(&ctx, natsBuf_Data(buf), natsBuf_Len(buf));
+    }
+    natsBuf_Reset(buf);
+
+    natsMutex_Unlock(nc->writeMu);
+
+    // Regardless of the outcome, the referenced data is no longer needed.
+    if (refs.count > 0)
+        _releaseWriteRefs(nc, &refs, s);
+
+    natsConn_Lock(nc);
+
+    // The socket is shutdown on a write deadline timeout.
+    if (!ctx.fdActive)
+        nc->sockCtx.fdActive = false;
+
+    nc->bwOut    = buf;
+    nc->wrefsOut = refs;
+    nc->flushing = false;
+    natsCondition_Broadcast(nc->flushingCond);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Period (in nanoseconds) over which the write rate is measured when the
+// flusher's wait is adapted to it.
+#define _FLUSHER_RATE_PERIOD_   (100 * 1000000)
+
+// Updates the flusher's accumulation wait from the write rate measured over
+// the last period. Flushing on every write is within the target rate when
+// writes are slower than that. Otherwise, a flush every `w + 1/rate` (the
+// wait, plus the time for the next write to come) gives the target rate
+// for `w = 1/target - 1/rate`, capped by the maximum flusher wait.
+// `idleStart` is when the flusher started to wait for a write (0 if it did
+// not have to) and `idleWrites` the count of writes at that time.
+// Lock held on entry.
+static void
+_adaptFlusherWindow(natsConnection *nc, int64_t idleStart, int64_t idleWrites)
+{
+    int64_t now     = nats_NowMonotonicInNanoSeconds();
+    int64_t elapsed = now - nc->flusherPeriodStart;
+    int64_t target  = nc->opts->flusherTargetRate;
+    int64_t window  = 0;
+    double  rate    = 0.0;
+
+    if (elapsed < _FLUSHER_RATE_PERIOD_)
+        return;
+
+    // After a wait of a whole period, the writes counted before that wait
+    // no longer reflect the rate.
+    if ((idleStart > 0) && ((now - idleStart) >= _FLUSHER_RATE_PERIOD_))
+        rate = ((double) (nc->flusherWrites - idleWrites) * 1E9) / (double) (now - idleStart);
+    else
+        rate = ((double) nc->flusherWrites * 1E9) / (double) elapsed;
+
+    if (rate > (double) target)
+    {
+        window = (int64_t) ((1E6 / (double) target) - (1E6 / rate));
+        if (window > nc->opts->flusherWait)
+            window = nc->opts->flusherWait;
+    }
+
+    nc->flusherWrites       = 0;
+    nc->flusherPeriodStart  = now;
+    nc->flusherWindow       = window;
+    nc->stats.flusherWindow = window;
+}
+
 static void
 _flusher(void *arg)
 {
     natsConnection  *nc  = (natsConnection*) arg;
     natsStatus      s;
     int64_t         kicks = 0;
+    int64_t         idleStart;
+    int64_t         idleWrites;
 
     while (true)
     {
         natsConn_Lock(nc);
 
+        idleStart  = 0;
+        idleWrites = 0;
+        if (!(nc->flusherSignaled) && (nc->opts->flusherTargetRate > 0))
+        {
+            idleStart  = nats_NowMonotonicInNanoSeconds();
+            idleWrites = nc->flusherWrites;
+        }
+
         while (!(nc->flusherSignaled) && !(nc->flusherStop))
             natsCondition_Wait(nc->flusherCond, nc->mu);
 
@@ -2593,13 +3093,22 @@ _flusher(void *arg)
             break;
         }
 
-        // Give a chance to accumulate more requests, but only when it is
-        // likely that more data is coming: writes are still coming after
+        // When adapted to the write rate, the wait depends only on the
+        // measured rate.
+        if (nc->opts->flusherTargetRate > 0)
+        {
+            _adaptFlusherWindow(nc, idleStart, idleWrites);
+            if (nc->flusherWindow > 0)
+                natsCondition_TimedWaitMicros(nc->flusherCond, nc->mu,
+                                              nc->flusherWindow);
+        }
+        // Otherwise, give a chance to accumulate more requests, but only when
+        // it is likely that more data is coming: writes are still coming after
         // we woke up, and writes are frequent (a flush occurred within the
         // last accumulation window).
         // For a lone pending write - sparse traffic or a synchronous
         // request/reply - flush immediately instead.
-        if ((nc->opts->flusherWait > 0))
+        else if ((nc->opts->flusherWait > 0))
         {
             kicks = nc->flusherKicks;
             natsConn_Unlock(nc);
@@ -2627,10 +3136,17 @@ _flusher(void *arg)
 
         if (nc->sockCtx.fdActive && (natsBuf_Len(nc->bw) > 0))
         {
+            int64_t bytes = natsBuf_Len(nc->bw) + nc->wrefs.bytes;
+
             SET_WRITE_DEADLINE(nc);
-            s = natsConn_bufferFlush(nc);
+            s = _flusherWrite(nc);
             if ((s != NATS_OK) && (nc->err == NATS_OK))
                 nc->err = s;
+            if (s == NATS_OK)
+            {
+                nc->stats.flushes++;
+                nc->stats.flushedBytes += (uint64_t) bytes;
+            }
             nc->flusherLastFlush = nats_NowMonotonicInNanoSeconds();
         }
 
@@ -2724,6 +3240,11 @@ _spinUpSocketWatchers(natsConnection *nc)
     nc->flusherLastFlush = 0;
     nc->flusherKicks     = 0;
 
+    nc->flusherWrites       = 0;
+    nc->flusherPeriodStart  = nats_NowMonotonicInNanoSeconds();
+    nc->flusherWindow       = 0;
+    nc->stats.flusherWindow = 0;
+
     if (nc->opts->evLoop == NULL)
     {
         // Let's not rely on the created threads acquiring lock that would make it
@@ -2735,8 +3256,9 @@ _spinUpSocketWatchers(natsConnection *nc)
             _release(nc);
     }
 
-    // Don't start flusher thread if connection was created with SendAsap option.
-    if ((s == NATS_OK) && !(nc->opts->sendAsap))
+    // Don't start flusher thread if connection was created with SendAsap option,
+    // or if the writes are done by an I/O thread of the library.
+    if ((s == NATS_OK) && !(nc->opts->sendAsap) && !(nc->el.libIO))
     {
         _retain(nc);
 
@@ -2782,10 +3304,13 @@ _removeAllSubscriptions(natsConnection *nc)
     {
         natsSubscription *sub = (natsSubscription*) p;
 
+        natsConn_subsWriteBegin(nc);
         (void) natsHashIter_RemoveCurrent(&iter);
+        natsConn_subsWriteEnd(nc);
 
         natsSub_close(sub, true);
 
+        natsConn_waitForSubsReaders(nc);
         natsSub_release(sub);
     }
     natsHashIter_Done(&iter);
@@ -2898,6 +3423,10 @@ _close(natsConnection *nc, natsConnStatus status, bool fromPublicClose, bool doC
         sockWasActive = true;
     }
 
+    // The outbound buffer will not be flushed anymore, so release the
+    // user data it still references.
+    _releaseWriteRefs(nc, &(nc->wrefs), NATS_CONNECTION_CLOSED);
+
     // Perform appropriate callback if needed for a disconnect.
     // Do not invoke if we were disconnected and failed to reconnect (since
     // it has already been invoked in doReconnect).
@@ -2948,13 +3477,93 @@ _createMsg(natsMsg **newMsg, natsConnection *nc, char *buf, int bufLen, int hdrL
         replyLen = natsBuf_Len(nc->ps->ma.reply);
     }
 
-    s = natsMsg_createWithPadding(newMsg,
+    if ((nc->ps->chunk != NULL) && (nc->opts->payloadPaddingSize <= 0))
+        s = natsMsg_createFromChunk(newMsg, nc->msgPool,
+                       nc->ps->chunk, nc->ps->chunkLen,
+                       (const char*) natsBuf_Data(nc->ps->ma.subject), subjLen,
+                       (const char*) reply, replyLen,
+                       (const char*) buf, bufLen, hdrLen);
+    else if (nc->msgPool != NULL)
+        s = natsMsg_createFromPool(newMsg, nc->msgPool,
+                       (const char*) natsBuf_Data(nc->ps->ma.subject), subjLen,
+                       (const char*) reply, replyLen,
+                       (const char*) buf, bufLen, nc->opts->payloadPaddingSize, hdrLen);
+    else
+        s = natsMsg_createWithPadding(newMsg,
                        (const char*) natsBuf_Data(nc->ps->ma.subject), subjLen,
                        (const char*) reply, replyLen,
                        (const char*) buf, bufLen, nc->opts->payloadPaddingSize, hdrLen);
     return s;
 }
 
+// Looks up the subscription for this `sid` without the `subsMu` lock, so
+// that subscription changes don't stall the read loop. If `filter` is NULL,
+// or no message filter is set, the subscription is returned retained and
+// locked, as with nats_lockRetainSubAndDispatcher(), unless `msg` could be
+// queued without the lock for a subscription in lock-free mode, in which case
+// `queued` is set to true and NULL is returned. Otherwise, it is not retained
+// and the lookup must be done again after invoking the filter.
+static natsSubscription*
+_lockRetainSubBySID(natsConnection *nc, int64_t sid, natsMsgFilter *filter,
+                    void **filterClosure, natsMsg *msg, bool *queued, bool *resp)
+{
+    natsSubscription    *sub = NULL;
+    natsHashEntry       *bkts;
+    int                 mask;
+    int                 seq;
+
+    for (;;)
+    {
+        // Being counted as a reader before reading the sequence guarantees
+        // that a writer that removes something from the hash after this
+        // point waits for us to be done before freeing it.
+        nats_atomicAddInt(&(nc->subsReaders), 1);
+        seq = nats_atomicLoadInt(&(nc->subsSeq));
+        if ((seq & 1) == 0)
+        {
+            bkts = nc->subs->bkts;
+            mask = nc->subs->mask;
+            nats_atomicFence();
+            // Probe only with an array and mask that go together.
+            if (nats_atomicLoadInt(&(nc->subsSeq)) == seq)
+            {
+                if (filter != NULL)
+                {
+                    *filter        = nc->filter;
+                    *filterClosure = nc->filterClosure;
+                }
+                *resp = (sid == nc->respMux.sid);
+                if (!(*resp))
+                    sub = (natsSubscription*) natsHash_GetConcurrent(bkts, mask, sid);
+
+                nats_atomicFence();
+                if (nats_atomicLoadInt(&(nc->subsSeq)) == seq)
+                {
+                    if ((sub != NULL) && ((filter == NULL) || (*filter == NULL)))
+                    {
+                        // Being counted as a reader, we are guaranteed that
+                        // the subscription is not freed while queuing.
+                        if (natsSub_enqueueLockFree(sub, msg))
+                        {
+                            *queued = true;
+                            sub = NULL;
+                        }
+                        else
+                            nats_lockRetainSubAndDispatcher(sub);
+                    }
+
+                    nats_atomicAddInt(&(nc->subsReaders), -1);
+                    return sub;
+                }
+                sub = NULL;
+            }
+        }
+        // A writer is (or was) modifying the hash, try again.
+        nats_atomicAddInt(&(nc->subsReaders), -1);
+        natsThread_Yield();
+    }
+}
+
 natsStatus
 natsConn_processMsg(natsConnection *nc, char *buf, int bufLen)
 {
@@ -2971,6 +3580,8 @@ natsConn_processMsg(natsConnection *nc, char *buf, int bufLen)
     int              jct     = 0;
     natsMsgFilter    mf      = NULL;
     void             *mfc    = NULL;
+    bool             resp    = false;
+    bool             queued  = false;
 
     // Do this outside of locks, even if we end-up having to destroy
     // it because we have reached the maxPendingMsgs count or other
@@ -2982,43 +3593,32 @@ natsConn_processMsg(natsConnection *nc, char *buf, int bufLen)
     // more and more prevalent, it makes sense to count them both toward
     // the subscription's pending limit. So use bufLen for accounting.
 
-    natsMutex_Lock(nc->subsMu);
+    // These stats are only updated here, by the read loop.
+    nats_atomicAdd64(&(nc->stats.inMsgs), 1);
+    nats_atomicAdd64(&(nc->stats.inBytes), (uint64_t) bufLen);
 
-    nc->stats.inMsgs  += 1;
-    nc->stats.inBytes += (uint64_t) bufLen;
-
-    if ((mf = nc->filter) != NULL)
+    sid = nc->ps->ma.sid;
+    sub = _lockRetainSubBySID(nc, sid, &mf, &mfc, msg, &queued, &resp);
+    if (mf != NULL)
     {
-        mfc = nc->filterClosure;
-        natsMutex_Unlock(nc->subsMu);
-
         (*mf)(nc, &msg, mfc);
         if (msg == NULL)
             return NATS_OK;
 
-        natsMutex_Lock(nc->subsMu);
+        sub = _lockRetainSubBySID(nc, sid, NULL, NULL, msg, &queued, &resp);
     }
-
-    sid = nc->ps->ma.sid;
-    if (sid == nc->respMux.sid)
+    if (queued)
+        return NATS_OK;
+    if (resp)
     {
-        natsMutex_Unlock(nc->subsMu);
         _respHandler(nc, msg);
         return NATS_OK;
     }
-    sub = natsHash_Get(nc->subs, sid);
     if (sub == NULL)
     {
-        natsMutex_Unlock(nc->subsMu);
         natsMsg_Destroy(msg);
         return NATS_OK;
     }
-    // We need to retain the subscription since as soon as we release the
-    // nc->subsMu lock, the subscription could be destroyed and we would
-    // reference freed memory.
-    nats_lockRetainSubAndDispatcher(sub);
-
-    natsMutex_Unlock(nc->subsMu);
 
     if (sub->closed || sub->drainSkip)
     {
@@ -3303,13 +3903,48 @@ natsConn_processPong(natsConnection *nc)
     natsConn_Unlock(nc);
 }
 
+// Changes to `nc->subs` (or to the other fields that the read loop looks
+// at in _lockRetainSubBySID()), made under the `subsMu` lock, must be
+// enclosed by these two calls. They make the sequence odd for the duration
+// of the change so that a concurrent lookup knows to try again.
+void
+natsConn_subsWriteBegin(natsConnection *nc)
+{
+    nats_atomicStoreInt(&(nc->subsSeq), nc->subsSeq + 1);
+    nats_atomicFence();
+}
+
+void
+natsConn_subsWriteEnd(natsConnection *nc)
+{
+    nats_atomicFence();
+    nats_atomicStoreInt(&(nc->subsSeq), nc->subsSeq + 1);
+}
+
+// Waits for lookups in progress to be done. After that, nothing that has
+// been removed from `nc->subs` can still be referenced by the read loop.
+void
+natsConn_waitForSubsReaders(natsConnection *nc)
+{
+    while (nats_atomicLoadInt(&(nc->subsReaders)) > 0)
+        natsThread_Yield();
+}
+
+static void
+_subsResized(void *closure)
+{
+    natsConn_waitForSubsReaders((natsConnection*) closure);
+}
+
 natsStatus
 natsConn_addSubcription(natsConnection *nc, natsSubscription *sub)
 {
     natsStatus          s       = NATS_OK;
     void                *oldSub = NULL;
 
+    natsConn_subsWriteBegin(nc);
     s = natsHash_Set(nc->subs, sub->sid, (void*) sub, &oldSub);
+    natsConn_subsWriteEnd(nc);
     if (s == NATS_OK)
     {
         assert(oldSub == NULL);
@@ -3326,7 +3961,9 @@ natsConn_removeSubscription(natsConnection *nc, natsSubscription *removedSub)
 
     natsMutex_Lock(nc->subsMu);
 
+    natsConn_subsWriteBegin(nc);
     sub = natsHash_Remove(nc->subs, removedSub->sid);
+    natsConn_subsWriteEnd(nc);
 
     // Note that the sub may have already been removed, so 'sub == NULL'
     // is not an error.
@@ -3341,9 +3978,13 @@ natsConn_removeSubscription(natsConnection *nc, natsSubscription *removedSub)
 
     natsMutex_Unlock(nc->subsMu);
 
-    // If we really removed the subscription, then release it.
+    // If we really removed the subscription, then release it, but not
+    // before the read loop is done with a lookup that may have found it.
     if (sub != NULL)
+    {
+        natsConn_waitForSubsReaders(nc);
         natsSub_release(sub);
+    }
 }
 
 static bool
@@ -3369,7 +4010,7 @@ natsStatus
 natsConn_subscribeImpl(natsSubscription **newSub,
                        natsConnection *nc, bool lock, const char *subj, const char *queue,
                        int64_t timeout, natsMsgHandler cb, void *cbClosure,
-                       bool preventUseOfLibDlvPool, jsSub *jsi)
+                       natsMsgBatchHandler batchCb, bool preventUseOfLibDlvPool, jsSub *jsi)
 {
     natsStatus          s    = NATS_OK;
     natsSubscription    *sub = NULL;
@@ -3403,7 +4044,7 @@ natsConn_subscribeImpl(natsSubscription **newSub,
     }
 
     _retain(nc);
-    s = natsSub_create(&sub, nc, subj, queue, timeout, cb, cbClosure, preventUseOfLibDlvPool, jsi);
+    s = natsSub_create(&sub, nc, subj, queue, timeout, cb, cbClosure, batchCb, preventUseOfLibDlvPool, jsi);
     if (s == NATS_OK)
     {
         natsMutex_Lock(nc->subsMu);
@@ -3605,7 +4246,10 @@ natsConn_create(natsConnection **newConn, natsOptions *options)
     if (s == NATS_OK)
         s = natsHash_Create(&(nc->subs), 8);
     if (s == NATS_OK)
+    {
+        natsHash_SetResizeCb(nc->subs, _subsResized, (void*) nc);
         s = natsSock_Init(&nc->sockCtx);
+    }
     if (s == NATS_OK)
     {
         s = natsBuf_Create(&(nc->scratch), DEFAULT_SCRATCH_SIZE);
@@ -3614,12 +4258,27 @@ natsConn_create(natsConnection **newConn, natsOptions *options)
     }
     if (s == NATS_OK)
         s = natsCondition_Create(&(nc->flusherCond));
+    if (s == NATS_OK)
+        s = natsCondition_Create(&(nc->flushingCond));
+    if (s == NATS_OK)
+        s = natsMutex_Create(&(nc->writeMu));
     if (s == NATS_OK)
         s = natsCondition_Create(&(nc->pongs.cond));
     if (s == NATS_OK)
         s = natsCondition_Create(&(nc->reconnectCond));
     if (s == NATS_OK)
         s = natsCondition_Create(&(nc->drainCond));
+    if ((s == NATS_OK) && nc->opts->useMsgPool)
+        s = natsMsgPool_Create(&(nc->msgPool), nc->opts->msgPoolMaxBytes);
+    if ((s == NATS_OK) && nc->opts->zeroCopyMsgs)
+        s = natsReadChunkPool_Create(&(nc->readChunks));
+    if (s == NATS_OK)
+        nc->readBufSize = nc->opts->ioBufSize;
+    if ((s == NATS_OK) && (nc->opts->evLoop == NULL))
+    {
+        nc->el.libIO = (nats_useIOUringThread(nc->opts)
+                        || nats_useIOPoolThread(nc->opts));
+    }
 
     if (s == NATS_OK)
     {
@@ -4311,7 +4970,7 @@ natsConnection_Buffered(natsConnection *nc)
     natsConn_Lock(nc);
 
     if ((nc->status != NATS_CONN_STATUS_CLOSED) && (nc->bw != NULL))
-        buffered = natsBuf_Len(nc->bw);
+        buffered = natsBuf_Len(nc->bw) + (int) nc->wrefs.bytes;
 
     natsConn_Unlock(nc);
 
@@ -4343,12 +5002,22 @@ natsConnection_GetStats(natsConnection *nc, natsStatistics *stats)
     if ((nc == NULL) || (stats == NULL))
         return nats_setDefaultError(NATS_INVALID_ARG);
 
-    // Stats are updated either under connection's mu or subsMu mutexes.
+    // Stats are updated either under connection's mu or subsMu mutexes,
+    // except for inbound ones that are updated atomically by the read loop.
     // Lock both to safely get them.
     natsConn_Lock(nc);
     natsMutex_Lock(nc->subsMu);
 
     memcpy(stats, &(nc->stats), sizeof(natsStatistics));
+    stats->inMsgs  = nats_atomicLoad64(&(nc->stats.inMsgs));
+    stats->inBytes = nats_atomicLoad64(&(nc->stats.inBytes));
+    stats->readCalls   = nats_atomicLoad64(&(nc->sockCtx.readCalls));
+    stats->readBytes   = nats_atomicLoad64(&(nc->sockCtx.readBytes));
+    stats->readWaits   = nats_atomicLoad64(&(nc->sockCtx.readWaits));
+    stats->readBufSize = nats_atomicLoadInt(&(nc->readBufSize));
+    if (nc->msgPool != NULL)
+        natsMsgPool_GetStats(nc->msgPool, &(stats->msgPoolHits),
+                             &(stats->msgPoolMisses), &(stats->msgPoolRetained));
 
     natsMutex_Unlock(nc->subsMu);
     natsConn_Unlock(nc);
@@ -4565,6 +5234,14 @@ natsConnection_Destroy(natsConnection *nc)
         natsConn_destroy(nc, true);
 }
 
+static void
+_resetEvLoopParser(natsConnection *nc)
+{
+    natsParser_Destroy(nc->ps);
+    nc->ps = NULL;
+    nc->el.resetParser = false;
+}
+
 void
 natsConnection_ProcessReadEvent(natsConnection *nc)
 {
@@ -4581,6 +5258,9 @@ natsConnection_ProcessReadEvent(natsConnection *nc)
         return;
     }
 
+    if (nc->el.resetParser)
+        _resetEvLoopParser(nc);
+
     if (nc->ps == NULL)
     {
         s = natsParser_Create(&(nc->ps));
@@ -4612,6 +5292,36 @@ natsConnection_ProcessReadEvent(natsConnection *nc)
         _processOpError(nc, s, false);
 }
 
+void
+natsConn_processReadData(natsConnection *nc, natsSock fd, char *buf, int n, natsStatus s)
+{
+    natsConn_Lock(nc);
+
+    // The data may be from the socket of a previous connect.
+    if (!(nc->el.attached) || (nc->sockCtx.fd != fd))
+    {
+        natsConn_Unlock(nc);
+        return;
+    }
+
+    if ((s == NATS_OK) && nc->el.resetParser)
+        _resetEvLoopParser(nc);
+    if ((s == NATS_OK) && (nc->ps == NULL))
+        s = natsParser_Create(&(nc->ps));
+
+    natsConn_Unlock(nc);
+
+    if (s == NATS_OK)
+    {
+        nats_atomicAdd64(&(nc->sockCtx.readCalls), 1);
+        nats_atomicAdd64(&(nc->sockCtx.readBytes), n);
+
+        s = natsParser_Parse(nc, buf, n);
+    }
+    if (s != NATS_OK)
+        _processOpError(nc, s, false);
+}
+
 void
 natsConnection_ProcessWriteEvent(natsConnection *nc)
 {
@@ -4951,8 +5661,10 @@ void
 natsConn_setFilterWithClosure(natsConnection *nc, natsMsgFilter f, void* closure)
 {
     natsMutex_Lock(nc->subsMu);
+    natsConn_subsWriteBegin(nc);
     nc->filter        = f;
     nc->filterClosure = closure;
+    natsConn_subsWriteEnd(nc);
     natsMutex_Unlock(nc->subsMu);
 }
 
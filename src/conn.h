@@ -18,6 +18,10 @@
 
 #define RESP_INFO_POOL_MAX_SIZE (10)
 
+// Number of consecutive reads using less than a quarter of the read
+// buffer after which it is shrunk, when its size is adaptive.
+#define READ_BUF_SHRINK_AFTER   (16)
+
 #ifdef DEV_MODE
 // For type safety
 
@@ -54,9 +58,16 @@ natsConn_release(natsConnection *nc);
 natsStatus
 natsConn_bufferWrite(natsConnection *nc, const char *buffer, int len);
 
+natsStatus
+natsConn_bufferWriteRef(natsConnection *nc, const char *data, int dataLen,
+                        natsPublishReleaseHandler cb, void *closure);
+
 natsStatus
 natsConn_bufferFlush(natsConnection *nc);
 
+void
+natsConn_waitForBufferSpace(natsConnection *nc);
+
 bool
 natsConn_isClosed(natsConnection *nc);
 
@@ -69,6 +80,11 @@ natsConn_flushOrKickFlusher(natsConnection *nc);
 natsStatus
 natsConn_processMsg(natsConnection *nc, char *buf, int bufLen);
 
+// Used by the library's I/O threads that read from the socket `fd` themselves:
+// parses the `n` bytes in `buf`, or processes the read error `s`.
+void
+natsConn_processReadData(natsConnection *nc, natsSock fd, char *buf, int n, natsStatus s);
+
 void
 natsConn_processOK(natsConnection *nc);
 
@@ -81,13 +97,13 @@ natsConn_processPing(natsConnection *nc);
 void
 natsConn_processPong(natsConnection *nc);
 
-#define natsConn_subscribeNoPool(sub, nc, subj, cb, closure)                            natsConn_subscribeImpl((sub), (nc), true, (subj), NULL, 0, (cb), (closure), true, NULL)
-#define natsConn_subscribeNoPoolNoLock(sub, nc, subj, cb, closure)                      natsConn_subscribeImpl((sub), (nc), false, (subj), NULL, 0, (cb), (closure), true, NULL)
+#define natsConn_subscribeNoPool(sub, nc, subj, cb, closure)                            natsConn_subscribeImpl((sub), (nc), true, (subj), NULL, 0, (cb), (closure), NULL, true, NULL)
+#define natsConn_subscribeNoPoolNoLock(sub, nc, subj, cb, closure)                      natsConn_subscribeImpl((sub), (nc), false, (subj), NULL, 0, (cb), (closure), NULL, true, NULL)
 #define natsConn_subscribeSyncNoPool(sub, nc, subj)                                     natsConn_subscribeNoPool((sub), (nc), (subj), NULL, NULL)
-#define natsConn_subscribeWithTimeout(sub, nc, subj, timeout, cb, closure)              natsConn_subscribeImpl((sub), (nc), true, (subj), NULL, (timeout), (cb), (closure), false, NULL)
+#define natsConn_subscribeWithTimeout(sub, nc, subj, timeout, cb, closure)              natsConn_subscribeImpl((sub), (nc), true, (subj), NULL, (timeout), (cb), (closure), NULL, false, NULL)
 #define natsConn_subscribe(sub, nc, subj, cb, closure)                                  natsConn_subscribeWithTimeout((sub), (nc), (subj), 0, (cb), (closure))
 #define natsConn_subscribeSync(sub, nc, subj)                                           natsConn_subscribe((sub), (nc), (subj), NULL, NULL)
-#define natsConn_queueSubscribeWithTimeout(sub, nc, subj, queue, timeout, cb, closure)  natsConn_subscribeImpl((sub), (nc), true, (subj), (queue), (timeout), (cb), (closure), false, NULL)
+#define natsConn_queueSubscribeWithTimeout(sub, nc, subj, queue, timeout, cb, closure)  natsConn_subscribeImpl((sub), (nc), true, (subj), (queue), (timeout), (cb), (closure), NULL, false, NULL)
 #define natsConn_queueSubscribe(sub, nc, subj, queue, cb, closure)                      natsConn_queueSubscribeWithTimeout((sub), (nc), (subj), (queue), 0, (cb), (closure))
 #define natsConn_queueSubscribeSync(sub, nc, subj, queue)                               natsConn_queueSubscribe((sub), (nc), (subj), (queue), NULL, NULL)
 
@@ -95,7 +111,7 @@ natsStatus
 natsConn_subscribeImpl(natsSubscription **newSub,
                        natsConnection *nc, bool lock, const char *subj, const char *queue,
                        int64_t timeout, natsMsgHandler cb, void *cbClosure,
-                       bool preventUseOfLibDlvPool, jsSub *jsi);
+                       natsMsgBatchHandler batchCb, bool preventUseOfLibDlvPool, jsSub *jsi);
 
 natsStatus
 natsConn_unsubscribe(natsConnection *nc, natsSubscription *sub, int max, bool drainMode, int64_t timeout);
@@ -118,6 +134,15 @@ natsConn_jsDispatcherDrained(natsConnection *nc);
 void
 natsConn_removeSubscription(natsConnection *nc, natsSubscription *sub);
 
+void
+natsConn_subsWriteBegin(natsConnection *nc);
+
+void
+natsConn_subsWriteEnd(natsConnection *nc);
+
+void
+natsConn_waitForSubsReaders(natsConnection *nc);
+
 void
 natsConn_processAsyncINFO(natsConnection *nc, char *buf, int len);
 
@@ -175,6 +200,9 @@ natsConn_srvVersionAtLeast(natsConnection *nc, int major, int minor, int update)
 void
 natsConn_defaultErrHandler(natsConnection *nc, natsSubscription *sub, natsStatus err, void *closure);
 
+int
+natsConn_adaptReadBufSize(natsConnection *nc, int bufSize, int n, int *lowReads, int *maxRead);
+
 void
 natsConn_close(natsConnection *nc);
 
@@ -17,11 +17,182 @@
 #include <stdio.h>
 
 #include "mem.h"
+#include "opts.h"
 #include "conn.h"
 #include "sub.h"
 #include "js.h"
 #include "glib/glib.h"
 
+natsStatus
+nats_initLockFreeQueue(natsDispatchQueue *q)
+{
+    natsStatus s = natsMsg_create(&q->stub, NULL, 0, NULL, 0, NULL, 0, -1);
+
+    if (s == NATS_OK)
+    {
+        q->stub->next   = NULL;
+        q->head         = q->stub;
+        q->tail         = q->stub;
+        q->lockFree     = true;
+    }
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Can be invoked concurrently by any number of producers.
+static inline void
+_lockFreePush(natsDispatchQueue *q, natsMsg *msg)
+{
+    natsMsg *prev;
+
+    msg->next = NULL;
+    prev = (natsMsg*) nats_atomicExchangePtr(&q->tail, msg);
+    // Between the exchange and this store, the consumer can't go past
+    // 'prev' and will report the queue as busy.
+    nats_atomicStorePtr(&prev->next, msg);
+}
+
+// Must be invoked by the single consumer. Returns NULL if the queue is empty,
+// or if a producer is in the middle of a push, in which case 'busy' is set
+// to true and the consumer should retry shortly.
+static natsMsg*
+_lockFreePop(natsDispatchQueue *q, bool *busy)
+{
+    natsMsg *head = q->head;
+    natsMsg *next = (natsMsg*) nats_atomicLoadPtr(&head->next);
+
+    *busy = false;
+
+    if (head == q->stub)
+    {
+        if (next == NULL)
+        {
+            *busy = ((natsMsg*) nats_atomicLoadPtr(&q->tail) != head);
+            return NULL;
+        }
+        q->head = next;
+        head    = next;
+        next    = (natsMsg*) nats_atomicLoadPtr(&head->next);
+    }
+    if (next != NULL)
+    {
+        q->head = next;
+        head->next = NULL;
+        return head;
+    }
+    if ((natsMsg*) nats_atomicLoadPtr(&q->tail) != head)
+    {
+        *busy = true;
+        return NULL;
+    }
+    // 'head' is the last message, put the stub back behind it so that
+    // it can be removed.
+    _lockFreePush(q, q->stub);
+    next = (natsMsg*) nats_atomicLoadPtr(&head->next);
+    if (next != NULL)
+    {
+        q->head = next;
+        head->next = NULL;
+        return head;
+    }
+    *busy = true;
+    return NULL;
+}
+
+// Must be invoked by the single consumer.
+static inline bool
+_lockFreeNotEmpty(natsDispatchQueue *q)
+{
+    return ((q->head != q->stub) || ((natsMsg*) nats_atomicLoadPtr(&q->tail) != q->stub));
+}
+
+// Returns true if the lock-free queue is not empty, checking a second time
+// after yielding once if it is. This avoids parking the consumer, and having
+// producers signal it, when messages arrive at a steady pace, without
+// spinning when the subscription is idle. Must be invoked by the single
+// consumer.
+static bool
+_lockFreeWait(natsDispatchQueue *q)
+{
+    if (_lockFreeNotEmpty(q))
+        return true;
+
+    natsThread_Yield();
+    return _lockFreeNotEmpty(q);
+}
+
+// Adds a message to the lock-free queue and wakes up the consumer if it is
+// parked. To be sure that the signal is not lost, it is sent under the lock,
+// which the consumer holds from its last check of the queue until it waits.
+static inline void
+_lockFreeEnqueue(natsSubscription *sub, natsDispatchQueue *q, natsMsg *msg, bool locked)
+{
+    _lockFreePush(q, msg);
+
+    // The consumer sets 'parked' before checking the queue a last time,
+    // so either it sees this message, or we see that it is parked.
+    if (nats_atomicLoadInt(&q->parked))
+    {
+        if (!locked)
+            natsSub_Lock(sub);
+        natsCondition_Signal(sub->ownDispatcher.cond);
+        if (!locked)
+            natsSub_Unlock(sub);
+    }
+}
+
+// Accounts for a user message about to be added to a lock-free queue, unless
+// this would exceed the subscription's pending limits. May be invoked without
+// the lock.
+static bool
+_lockFreeReserve(natsSubscription *sub, natsDispatchQueue *q, int len)
+{
+    int newMsgs     = nats_atomicAddInt(&q->msgs, 1);
+    int newBytes    = nats_atomicAddInt(&q->bytes, len);
+    int msgsLimit   = nats_atomicLoadInt(&sub->msgsLimit);
+    int bytesLimit  = nats_atomicLoadInt(&sub->bytesLimit);
+
+    if (((msgsLimit > 0) && (newMsgs > msgsLimit)) ||
+        ((bytesLimit > 0) && (newBytes > bytesLimit)))
+    {
+        nats_atomicAddInt(&q->msgs, -1);
+        nats_atomicAddInt(&q->bytes, -len);
+        return false;
+    }
+    if (newMsgs > nats_atomicLoadInt(&sub->msgsMax))
+        nats_atomicStoreInt(&sub->msgsMax, newMsgs);
+    if (newBytes > nats_atomicLoadInt(&sub->bytesMax))
+        nats_atomicStoreInt(&sub->bytesMax, newBytes);
+
+    return true;
+}
+
+// Queues a user message without holding any lock. Must be invoked by the
+// read loop, which guarantees that the subscription is not freed meanwhile.
+// Returns false if the message needs to go through the locked path instead,
+// that is, if the queue is not lock-free (or no longer), or if the message
+// would exceed the pending limits, so that the slow consumer condition is
+// handled there.
+bool
+natsSub_enqueueLockFree(natsSubscription *sub, natsMsg *msg)
+{
+    natsDispatchQueue   *q = &sub->ownDispatcher.queue;
+
+    // lockFree is set at sub creation time and never changes.
+    if (!q->lockFree || nats_atomicLoadInt(&q->locked))
+        return false;
+
+    if (!_lockFreeReserve(sub, q, natsMsg_dataAndHdrLen(msg)))
+        return false;
+
+    // Only set by the read loop for asynchronous subscriptions.
+    if (sub->slowConsumer)
+        sub->slowConsumer = false;
+
+    msg->sub = sub;
+    _lockFreeEnqueue(sub, q, msg, false);
+    return true;
+}
+
 // sub and dispatcher locks must be held.
 void
 natsSub_enqueueMessage(natsSubscription *sub, natsMsg *msg)
@@ -29,6 +200,14 @@ natsSub_enqueueMessage(natsSubscription *sub, natsMsg *msg)
     bool                signal  = false;
     natsDispatchQueue   *q      = &sub->dispatcher->queue;
 
+    if (q->lockFree)
+    {
+        nats_atomicAddInt(&q->msgs, 1);
+        nats_atomicAddInt(&q->bytes, natsMsg_dataAndHdrLen(msg));
+        _lockFreeEnqueue(sub, q, msg, true);
+        return;
+    }
+
     if (q->head == NULL)
     {
         signal = true;
@@ -53,22 +232,33 @@ natsSub_enqueueUserMessage(natsSubscription *sub, natsMsg *msg)
 {
     natsDispatchQueue   *toQ        = &sub->dispatcher->queue;
     natsDispatchQueue   *statsQ     = &sub->ownDispatcher.queue;
-    int                 newMsgs     = statsQ->msgs + 1;
-    int                 newBytes    = statsQ->bytes + natsMsg_dataAndHdrLen(msg);
+    int                 newMsgs     = 0;
+    int                 newBytes    = 0;
 
     msg->sub = sub;
 
-    if (((sub->msgsLimit > 0) && (newMsgs > sub->msgsLimit)) ||
-        ((sub->bytesLimit > 0) && (newBytes > sub->bytesLimit)))
+    if (statsQ->lockFree)
     {
-        return NATS_SLOW_CONSUMER;
+        if (!_lockFreeReserve(sub, statsQ, natsMsg_dataAndHdrLen(msg)))
+            return NATS_SLOW_CONSUMER;
     }
-    sub->slowConsumer = false;
+    else
+    {
+        newMsgs     = statsQ->msgs + 1;
+        newBytes    = statsQ->bytes + natsMsg_dataAndHdrLen(msg);
 
-    if (newMsgs > sub->msgsMax)
-        sub->msgsMax = newMsgs;
-    if (newBytes > sub->bytesMax)
-        sub->bytesMax = newBytes;
+        if (((sub->msgsLimit > 0) && (newMsgs > sub->msgsLimit)) ||
+            ((sub->bytesLimit > 0) && (newBytes > sub->bytesLimit)))
+        {
+            return NATS_SLOW_CONSUMER;
+        }
+
+        if (newMsgs > sub->msgsMax)
+            sub->msgsMax = newMsgs;
+        if (newBytes > sub->bytesMax)
+            sub->bytesMax = newBytes;
+    }
+    sub->slowConsumer = false;
 
     if (sub->jsi != NULL)
     {
@@ -88,6 +278,13 @@ natsSub_enqueueUserMessage(natsSubscription *sub, natsMsg *msg)
         }
     }
 
+    // Already accounted for above.
+    if (toQ->lockFree)
+    {
+        _lockFreeEnqueue(sub, toQ, msg, true);
+        return NATS_OK;
+    }
+
     // Update the subscription stats if separate, the queue stats will be
     // updated below.
     if (toQ != statsQ)
@@ -100,6 +297,35 @@ natsSub_enqueueUserMessage(natsSubscription *sub, natsMsg *msg)
     return NATS_OK;
 }
 
+// Accounts for a user message removed from the subscription's queue. In
+// lock-free mode, the counters are updated atomically and this does not
+// require the lock.
+static inline void
+_dequeuedMsg(natsSubscription *sub, natsMsg *msg)
+{
+    natsDispatchQueue *q = &sub->ownDispatcher.queue;
+
+    if (q->lockFree)
+    {
+        nats_atomicAddInt(&q->msgs, -1);
+        nats_atomicAddInt(&q->bytes, -natsMsg_dataAndHdrLen(msg));
+        return;
+    }
+    q->msgs--;
+    q->bytes -= natsMsg_dataAndHdrLen(msg);
+}
+
+// Increments the number of delivered messages, atomically in lock-free mode
+// where it is also updated without the lock.
+static inline void
+_addDelivered(natsSubscription *sub)
+{
+    if (sub->ownDispatcher.queue.lockFree)
+        nats_atomicAdd64(&sub->delivered, 1);
+    else
+        sub->delivered++;
+}
+
 // Sub/dispatch locks must be held.
 static inline void
 _removeHeadMsg(natsDispatcher *d, natsMsg *msg)
@@ -149,10 +375,7 @@ _preProcessUserMessage(
     // Is this a real message? If so, account for having processed it.
     bool isRealMessage = (msg->subject[0] != '\0');
     if (isRealMessage)
-    {
-        sub->ownDispatcher.queue.msgs--;
-        sub->ownDispatcher.queue.bytes -= natsMsg_dataAndHdrLen(msg);
-    }
+        _dequeuedMsg(sub, msg);
 
     // Fetch-specific handling of synthetic and header-only messages
     if ((jsi != NULL) && (fetch != NULL))
@@ -162,6 +385,9 @@ _preProcessUserMessage(
         natsStatus s = _updateFetchPinID(fetch, fetchStatus, msg);
         if (s != NATS_OK)
             return s;
+
+        if (fetch->opts.Consume)
+            fetchStatus = js_checkConsumeStatus(sub, fetch, msg, fetchStatus, *userMsg);
     }
 
     // Is it another kind of synthetic message?
@@ -203,11 +429,19 @@ _preProcessUserMessage(
 
         if (!*overLimit)
         {
-            sub->delivered++;
+            _addDelivered(sub);
             if (fetch)
             {
                 fetch->deliveredMsgs++;
                 fetch->deliveredBytes += natsMsg_dataAndHdrLen(msg);
+                if (fetch->opts.Consume)
+                {
+                    if (fetch->pendingMsgs > 0)
+                        fetch->pendingMsgs--;
+                    fetch->pendingBytes -= natsMsg_dataAndHdrLen(msg);
+                    if (fetch->pendingBytes < 0)
+                        fetch->pendingBytes = 0;
+                }
             }
         }
 
@@ -217,11 +451,150 @@ _preProcessUserMessage(
     return fetchStatus;
 }
 
+// Sends a new pull request if needed, and if that fails, delivers whatever
+// is already received. No lock must be held.
+static inline void
+_fetchMore(natsSubscription *sub, jsFetch *fetch)
+{
+    fetch->status = js_maybeFetchMore(sub, fetch);
+    if (fetch->status != NATS_OK)
+        natsSubscription_Drain(sub);
+}
+
+// Accounts for the delivery of a message removed with others from the queue.
+// Sub/dispatch locks must be held.
+static inline void
+_accountBatchedMsg(natsSubscription *sub, natsMsg *msg)
+{
+    _dequeuedMsg(sub, msg);
+    _addDelivered(sub);
+}
+
+// Removes up to `max` more messages from the queue of a subscription that has
+// nothing to check between messages, that is, without a delivery limit nor
+// JetStream processing. Only user messages are queued for such a subscription.
+// Sub lock must be held.
+static int
+_removeOwnBatch(natsSubscription *sub, natsMsg **msgs, int max)
+{
+    natsDispatchQueue   *q      = &sub->ownDispatcher.queue;
+    natsMsg             *msg    = NULL;
+    bool                busy    = false;
+    int                 n       = 0;
+
+    while (n < max)
+    {
+        if (q->lockFree)
+            msg = _lockFreePop(q, &busy);
+        else if ((msg = q->head) != NULL)
+            _removeHeadMsg(&sub->ownDispatcher, msg);
+
+        if (msg == NULL)
+            break;
+
+        _accountBatchedMsg(sub, msg);
+        msgs[n++] = msg;
+    }
+    return n;
+}
+
+// Removes up to `max` messages from a lock-free queue without holding the
+// lock, unless the subscription's state requires it. Each delivery is counted
+// before checking the state, while natsSub_setMax() changes the state before
+// looking at the delivered count, so that one of them always sees the other.
+static int
+_removeLockFreeBatch(natsSubscription *sub, natsMsg **msgs, int max)
+{
+    natsDispatchQueue   *q      = &sub->ownDispatcher.queue;
+    natsMsg             *msg    = NULL;
+    bool                busy    = false;
+    int                 n       = 0;
+
+    while (n < max)
+    {
+        nats_atomicAdd64(&sub->delivered, 1);
+        nats_atomicFence();
+
+        msg = NULL;
+        if (!nats_atomicLoadInt(&q->locked))
+            msg = _lockFreePop(q, &busy);
+
+        if (msg == NULL)
+        {
+            nats_atomicAdd64(&sub->delivered, -1);
+            break;
+        }
+        _dequeuedMsg(sub, msg);
+        msgs[n++] = msg;
+    }
+    return n;
+}
+
+// Removes up to `max` more messages from the head of a shared dispatcher's
+// queue, stopping at the first one that needs more than accounting before
+// being delivered: synthetic messages, or messages for subscriptions that are
+// closed, have a delivery limit, a timeout or JetStream processing. Since the
+// batch size is a connection option, it also stops at the first message of a
+// subscription that belongs to a connection other than `nc`.
+// Dispatcher lock must be held.
+static int
+_removePoolBatch(natsDispatcher *d, natsConnection *nc, natsMsg **msgs, int max)
+{
+    natsMsg             *msg    = NULL;
+    natsSubscription    *sub    = NULL;
+    int                 n       = 0;
+
+    while ((n < max) && ((msg = d->queue.head) != NULL))
+    {
+        sub = msg->sub;
+        if ((sub == NULL) || (sub->conn != nc) || (msg->subject[0] == '\0') || sub->closed
+            || (sub->jsi != NULL) || (sub->max > 0) || (sub->timeout != 0))
+        {
+            break;
+        }
+        _removeHeadMsg(d, msg);
+        _accountBatchedMsg(sub, msg);
+        msgs[n++] = msg;
+    }
+    return n;
+}
+
+// Invokes the callbacks for messages removed together from the queue.
+// Consecutive messages of a subscription created with a batch handler are
+// passed to it in a single call. No lock must be held.
+static void
+_deliverMsgs(natsMsg **msgs, int count)
+{
+    natsSubscription    *sub    = NULL;
+    int                 i       = 0;
+    int                 n       = 0;
+
+    while (i < count)
+    {
+        sub = msgs[i]->sub;
+        n   = 1;
+        // These are set at sub creation time and never change.
+        if (sub->batchCb != NULL)
+        {
+            while ((i + n < count) && (msgs[i + n]->sub == sub))
+                n++;
+            (*sub->batchCb)(sub->conn, sub, &msgs[i], n, sub->msgCbClosure);
+        }
+        else
+        {
+            (*sub->msgCb)(sub->conn, sub, msgs[i], sub->msgCbClosure);
+        }
+        i += n;
+    }
+}
+
 // Thread main function for a thread pool of dispatchers.
 void
 nats_dispatchThreadPool(void *arg)
 {
-    natsDispatcher *d = (natsDispatcher *)arg;
+    natsDispatcher  *d      = (natsDispatcher *)arg;
+    natsMsg         *msgs[NATS_OPTS_MAX_DISPATCH_BATCH_SIZE];
+    int             count   = 0;
 
     nats_lockDispatcher(d);
 
@@ -366,6 +739,15 @@ nats_dispatchThreadPool(void *arg)
             // heartbeat condition when the timer fires.
             jsi->active = true;
             natsMsg_Destroy(msg);
+
+            // In consume mode, this may have terminated a pull request, or
+            // heartbeats have been missed, so more may need to be requested.
+            if (fetch->opts.Consume && !draining)
+            {
+                nats_unlockDispatcher(d);
+                _fetchMore(sub, fetch);
+                nats_lockDispatcher(d);
+            }
             continue;
         }
 
@@ -400,22 +782,25 @@ nats_dispatchThreadPool(void *arg)
         if (lastMessageInFetch)
             fetch->status = fetchStatus;
 
+        // If there is nothing to do between this message and the next ones,
+        // remove them now too (opts are immutable once connected).
+        msgs[0] = msg;
+        count   = 1;
+        if (!overLimit && (jsi == NULL) && (sub->max == 0) && (sub->timeout == 0)
+            && (nc->opts->dispatchBatchSize > 1))
+        {
+            count += _removePoolBatch(d, nc, &msgs[1], nc->opts->dispatchBatchSize - 1);
+        }
+
         nats_unlockDispatcher(d);
 
         if (!overLimit)
-            (*messageCB)(nc, sub, msg, messageClosure);
+            _deliverMsgs(msgs, count);
         else
             natsMsg_Destroy(msg);
 
         if ((fetch != NULL) && !lastMessageInFetch && !draining)
-        {
-            fetch->status = js_maybeFetchMore(sub, fetch);
-            // If we failed to request more during a fetch, deliver whatever is
-            // already received.
-            if (fetch->status != NATS_OK)
-                natsSubscription_Drain(sub);
-        }
-
+            _fetchMore(sub, fetch);
 
         if (fcReply != NULL)
         {
@@ -485,6 +870,13 @@ nats_dispatchThreadOwn(void *arg)
     natsConn_Lock(nc);
     natsConn_Unlock(nc);
 
+    // Set at sub creation time and never changes.
+    natsDispatchQueue   *q                  = &sub->ownDispatcher.queue;
+    bool                lockFree            = q->lockFree;
+    int                 batchSize           = nc->opts->dispatchBatchSize;
+    natsMsg             *msgs[NATS_OPTS_MAX_DISPATCH_BATCH_SIZE];
+    int                 count               = 0;
+
     while (true)
     {
         natsStatus  s                   = NATS_OK;
@@ -494,15 +886,56 @@ nats_dispatchThreadOwn(void *arg)
         bool        lastMessageInSub    = false;
         bool        lastMessageInFetch  = false;
 
+        // In lock-free mode, as long as the subscription's state does not
+        // change, messages are removed and delivered without the lock, which
+        // is then needed only to park when there is nothing to deliver.
+        if (lockFree && !nats_atomicLoadInt(&q->locked) && _lockFreeWait(q)
+            && ((count = _removeLockFreeBatch(sub, msgs, batchSize)) > 0))
+        {
+            _deliverMsgs(msgs, count);
+            continue;
+        }
+
         natsSub_Lock(sub);
         int64_t timeout = sub->timeout;
 
-        while (((msg = sub->ownDispatcher.queue.head) == NULL) && !(sub->closed) && !(sub->draining) && (s != NATS_TIMEOUT))
+        if (lockFree)
         {
-            if (timeout != 0)
-                s = natsCondition_TimedWait(sub->ownDispatcher.cond, sub->mu, timeout);
-            else
-                natsCondition_Wait(sub->ownDispatcher.cond, sub->mu);
+            // As with the locked queue, messages are removed first, so that
+            // the ones still queued are delivered when draining.
+            while (msg == NULL)
+            {
+                bool busy = false;
+
+                nats_atomicStoreInt(&q->parked, 1);
+                msg = _lockFreePop(q, &busy);
+                if ((msg == NULL) && busy)
+                {
+                    natsSub_Unlock(sub);
+                    natsThread_Yield();
+                    natsSub_Lock(sub);
+                }
+                else if ((msg == NULL) && ((sub->closed) || (sub->draining) || (s == NATS_TIMEOUT)))
+                {
+                    nats_atomicStoreInt(&q->parked, 0);
+                    break;
+                }
+                else if ((msg == NULL) && (timeout != 0))
+                    s = natsCondition_TimedWait(sub->ownDispatcher.cond, sub->mu, timeout);
+                else if (msg == NULL)
+                    natsCondition_Wait(sub->ownDispatcher.cond, sub->mu);
+                nats_atomicStoreInt(&q->parked, 0);
+            }
+        }
+        else
+        {
+            while (((msg = sub->ownDispatcher.queue.head) == NULL) && !(sub->closed) && !(sub->draining) && (s != NATS_TIMEOUT))
+            {
+                if (timeout != 0)
+                    s = natsCondition_TimedWait(sub->ownDispatcher.cond, sub->mu, timeout);
+                else
+                    natsCondition_Wait(sub->ownDispatcher.cond, sub->mu);
+            }
         }
 
         bool draining = sub->draining;
@@ -515,6 +948,10 @@ nats_dispatchThreadOwn(void *arg)
         if (sub->closed)
         {
             natsSub_Unlock(sub);
+            // Already removed from the lock-free queue, so would not be
+            // destroyed with the rest of the queue.
+            if (lockFree)
+                natsMsg_Destroy(msg);
             break;
         }
 
@@ -533,7 +970,8 @@ nats_dispatchThreadOwn(void *arg)
             continue;
         }
 
-        _removeHeadMsg(&sub->ownDispatcher, msg);
+        if (!lockFree)
+            _removeHeadMsg(&sub->ownDispatcher, msg);
 
         char *fcReply = NULL;
         natsStatus fetchStatus = _preProcessUserMessage(
@@ -559,27 +997,32 @@ nats_dispatchThreadOwn(void *arg)
             jsi->active = true;
             natsSub_Unlock(sub);
             natsMsg_Destroy(msg);
+
+            // See comment in nats_dispatchThreadPool.
+            if (fetch->opts.Consume && !draining)
+                _fetchMore(sub, fetch);
             continue;
         }
 
         if (lastMessageInFetch)
             fetch->status = fetchStatus;
 
+        // If there is nothing to do between this message and the next ones,
+        // remove them now too.
+        msgs[0] = msg;
+        count   = 1;
+        if (!overLimit && (batchSize > 1) && (jsi == NULL) && (sub->max == 0))
+            count += _removeOwnBatch(sub, &msgs[1], batchSize - 1);
+
         natsSub_Unlock(sub);
 
         if (!overLimit)
-            (*messageCB)(nc, sub, msg, messageClosure);
+            _deliverMsgs(msgs, count);
         else
             natsMsg_Destroy(msg);
 
         if ((fetch != NULL) && !lastMessageInFetch && !draining)
-        {
-            fetch->status = js_maybeFetchMore(sub, fetch);
-            // If we failed to request more during a fetch, deliver whatever is
-            // already received.
-            if (fetch->status != NATS_OK)
-                natsSubscription_Drain(sub);
-        }
+            _fetchMore(sub, fetch);
 
         if (fcReply != NULL)
         {
@@ -20,6 +20,22 @@ typedef struct __natsDispatchQueue_s
     natsMsg *tail;
     int msgs;
     int bytes;
+
+    // In lock-free mode, head and tail form a multi-producer/single-consumer
+    // queue: producers append with an atomic exchange of the tail, and the
+    // consumer removes from the head without holding the lock. The stub is a
+    // placeholder node that keeps the list from ever being empty. Producers
+    // signal the condition variable only if the consumer is parked. msgs and
+    // bytes are then updated atomically, so that the read loop can check
+    // the pending limits without the lock.
+    bool lockFree;
+    natsMsg *stub;
+    int parked;
+
+    // Set (for good) in lock-free mode when messages need to be queued and
+    // processed under the lock: for JetStream subscriptions, and once the
+    // subscription is closed, draining or has a maximum of messages.
+    int locked;
 } natsDispatchQueue;
 
 typedef struct __natsDispatcher_s
@@ -44,10 +60,28 @@ static inline void nats_destroyQueuedMessages(natsDispatchQueue *queue)
     for (natsMsg *msg = queue->head; msg != NULL; msg = next)
     {
         next = msg->next;
-        natsMsg_Destroy(msg);
+        if (msg != queue->stub)
+            natsMsg_Destroy(msg);
     }
+    natsMsg_free(queue->stub);
+    queue->stub = NULL;
 }
 
+natsStatus nats_initLockFreeQueue(natsDispatchQueue *queue);
+
+// Makes producers and consumer of a lock-free queue use the lock from now on.
+// Sub/dispatch locks must be held.
+static inline void nats_lockQueue(natsDispatchQueue *queue)
+{
+    if (queue->lockFree && !queue->locked)
+    {
+        nats_atomicStoreInt(&queue->locked, 1);
+        nats_atomicFence();
+    }
+}
+
+bool natsSub_enqueueLockFree(natsSubscription *sub, natsMsg *msg);
+
 void natsSub_enqueueMessage(natsSubscription *sub, natsMsg *msg);
 natsStatus natsSub_enqueueUserMessage(natsSubscription *sub, natsMsg *msg);
 
@@ -28,6 +28,12 @@ natsLib* nats_lib(void)
     return &gLib;
 }
 
+bool
+nats_wasLibOpened(void)
+{
+    return gLib.wasOpenedOnce || gLib.initializing;
+}
+
 void
 nats_threadStartedHandler(void)
 {
@@ -104,6 +110,8 @@ _freeLib(void)
     bool callFinalCleanup = false;
 
     nats_freeTimers(&gLib);
+    nats_freeIOUrings(&gLib);
+    nats_freeIOPool(&gLib);
     nats_freeAsyncCbs(&gLib);
     nats_freeGC(&gLib);
 
@@ -174,8 +182,9 @@ _libTearDown(void)
     nats_waitForDispatcherPoolShutdown(&gLib.messageDispatchers);
     nats_waitForDispatcherPoolShutdown(&gLib.replyDispatchers);
 
-    if (gLib.timers.thread != NULL)
-        natsThread_Join(gLib.timers.thread);
+    nats_joinTimers(&gLib);
+    nats_joinIOUrings(&gLib);
+    nats_joinIOPool(&gLib);
 
     if (gLib.asyncCbs.thread != NULL)
         natsThread_Join(gLib.asyncCbs.thread);
@@ -230,15 +239,11 @@ nats_openLib(natsClientConfig *config)
         s = natsCrypto_Init();
 
     if (s == NATS_OK)
-        s = natsMutex_Create(&(gLib.timers.lock));
-    if (s == NATS_OK)
-        s = natsCondition_Create(&(gLib.timers.cond));
-    if (s == NATS_OK)
-    {
-        s = natsThread_Create(&(gLib.timers.thread), nats_timerThreadf, &gLib);
-        if (s == NATS_OK)
-            gLib.refs++;
-    }
+        s = nats_initTimers(&gLib, config->TimerThreads);
+    if ((s == NATS_OK) && (config->IOUringThreads > 0))
+        s = nats_initIOUrings(&gLib, config->IOUringThreads);
+    if ((s == NATS_OK) && (config->IOThreadPoolSize > 0))
+        s = nats_initIOPool(&gLib, config->IOThreadPoolSize);
 
     if (s == NATS_OK)
         s = natsMutex_Create(&(gLib.asyncCbs.lock));
@@ -278,7 +283,9 @@ nats_openLib(natsClientConfig *config)
         if (s != NATS_OK)
         {
             gLib.initAborted = true;
-            gLib.timers.shutdown = true;
+            nats_shutdownTimers(&gLib, false);
+            nats_shutdownIOUrings(&gLib);
+            nats_shutdownIOPool(&gLib);
             gLib.asyncCbs.shutdown = true;
             gLib.gc.shutdown = true;
         }
@@ -337,10 +344,9 @@ nats_closeLib(bool wait, int64_t timeout)
 
     gLib.closed = true;
 
-    natsMutex_Lock(gLib.timers.lock);
-    gLib.timers.shutdown = true;
-    natsCondition_Signal(gLib.timers.cond);
-    natsMutex_Unlock(gLib.timers.lock);
+    nats_shutdownTimers(&gLib, true);
+    nats_shutdownIOUrings(&gLib);
+    nats_shutdownIOPool(&gLib);
 
     natsMutex_Lock(gLib.asyncCbs.lock);
     gLib.asyncCbs.shutdown = true;
@@ -50,6 +50,17 @@ int nats_getTimersCount(void);
 // timer thread is invoking a timer's callback.
 int nats_getTimersCountInList(void);
 
+// If the library has io_uring I/O threads, sets the event loop and callbacks
+// of the given (connection's own) options to one of them and returns true.
+bool nats_useIOUringThread(natsOptions *opts);
+
+// Same as nats_useIOUringThread(), but for the threads of the epoll based
+// I/O pool.
+bool nats_useIOPoolThread(natsOptions *opts);
+
+// Returns true if the library is being, or has ever been, opened.
+bool nats_wasLibOpened(void);
+
 // Invoked when a library thread is started.
 void nats_threadStartedHandler(void);
 
@@ -0,0 +1,502 @@
+// Copyright 2026 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "glibp.h"
+
+#if defined(__linux__)
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+// The threads of the I/O pool plug into connections as an event loop (see
+// natsEvLoop_Attach and friends), each polling its sockets with epoll and
+// invoking natsConnection_ProcessReadEvent() and ProcessWriteEvent().
+//
+// Events returned by a wait may be for a socket removed meanwhile, so the
+// sockets and connections removed from a thread are only freed once it is
+// done with the events it got.
+
+#define IOPOOL_MAX_EVENTS   (64)
+
+typedef struct __natsIOPoolConn natsIOPoolConn;
+
+typedef struct __natsIOPoolSock
+{
+    natsIOPoolConn          *conn;
+    natsSock                fd;
+    bool                    closing;
+    struct __natsIOPoolSock *next;
+
+} natsIOPoolSock;
+
+struct __natsIOPoolConn
+{
+    natsIOPoolThread        *thread;
+    natsConnection          *nc;
+    natsIOPoolSock          *sock;
+    struct __natsIOPoolConn *next;
+};
+
+struct __natsIOPoolThread
+{
+    natsMutex       *mu;
+    natsThread      *thread;
+    int             epfd;
+    int             wakeFd;
+    bool            wakePending;
+
+    // Removed sockets and detached connections, to be freed.
+    natsIOPoolSock  *closedSocks;
+    natsIOPoolConn  *detachedConns;
+
+    bool            shutdown;
+    bool            stopped;
+};
+
+static void
+_freeThread(natsIOPoolThread *t)
+{
+    if (t == NULL)
+        return;
+
+    if (t->epfd >= 0)
+        close(t->epfd);
+    if (t->wakeFd >= 0)
+        close(t->wakeFd);
+    natsThread_Destroy(t->thread);
+    natsMutex_Destroy(t->mu);
+    NATS_FREE(t);
+}
+
+static natsStatus
+_createThread(natsIOPoolThread **newThread)
+{
+    natsStatus          s = NATS_OK;
+    natsIOPoolThread    *t;
+    struct epoll_event  ev;
+
+    t = (natsIOPoolThread*) NATS_CALLOC(1, sizeof(natsIOPoolThread));
+    if (t == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    t->epfd   = epoll_create1(EPOLL_CLOEXEC);
+    t->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((t->epfd < 0) || (t->wakeFd < 0))
+        s = nats_setError(NATS_SYS_ERROR, "I/O pool thread setup error: %d", errno);
+
+    if (s == NATS_OK)
+    {
+        memset(&ev, 0, sizeof(ev));
+        ev.events   = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, t->wakeFd, &ev) != 0)
+            s = nats_setError(NATS_SYS_ERROR, "epoll_ctl error: %d", errno);
+    }
+    if (s == NATS_OK)
+        s = natsMutex_Create(&(t->mu));
+
+    if (s == NATS_OK)
+        *newThread = t;
+    else
+        _freeThread(t);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Lock held on entry.
+static void
+_wakeUp(natsIOPoolThread *t)
+{
+    uint64_t one = 1;
+
+    if (t->wakePending)
+        return;
+
+    t->wakePending = true;
+    if (write(t->wakeFd, &one, sizeof(one)) < 0)
+        t->wakePending = false;
+}
+
+// Frees the removed sockets and detached connections, and returns the list
+// of connections to notify (outside of the lock) that they are detached.
+// Lock held on entry.
+static natsIOPoolConn*
+_sweep(natsIOPoolThread *t)
+{
+    natsIOPoolSock  *sock;
+    natsIOPoolConn  *conns;
+
+    while ((sock = t->closedSocks) != NULL)
+    {
+        t->closedSocks = sock->next;
+        NATS_FREE(sock);
+    }
+
+    conns = t->detachedConns;
+    t->detachedConns = NULL;
+
+    return conns;
+}
+
+static void
+_notifyDetached(natsIOPoolConn *conns)
+{
+    natsIOPoolConn  *conn;
+    natsConnection  *nc;
+
+    while ((conn = conns) != NULL)
+    {
+        conns = conn->next;
+        nc    = conn->nc;
+
+        NATS_FREE(conn);
+        natsConnection_ProcessDetachedEvent(nc);
+    }
+}
+
+void
+nats_ioPoolThreadf(void *arg)
+{
+    natsLib             *lib = nats_lib();
+    natsIOPoolThread    *t   = (natsIOPoolThread*) arg;
+    struct epoll_event  events[IOPOOL_MAX_EVENTS];
+    natsIOPoolSock      *sock;
+    natsIOPoolConn      *detached;
+    natsConnection      *nc;
+    uint64_t            count;
+    bool                stop;
+    int                 n, i;
+
+    WAIT_LIB_INITIALIZED(lib);
+
+    for (;;)
+    {
+        n = epoll_wait(t->epfd, events, IOPOOL_MAX_EVENTS, -1);
+        if ((n < 0) && (errno != EINTR))
+            nats_Sleep(1);
+
+        for (i=0; i<n; i++)
+        {
+            if ((sock = (natsIOPoolSock*) events[i].data.ptr) == NULL)
+            {
+                natsMutex_Lock(t->mu);
+                t->wakePending = false;
+                if (read(t->wakeFd, &count, sizeof(count)) < 0)
+                    count = 0;
+                natsMutex_Unlock(t->mu);
+                continue;
+            }
+
+            natsMutex_Lock(t->mu);
+            nc = (sock->closing ? NULL : sock->conn->nc);
+            natsMutex_Unlock(t->mu);
+
+            if (nc == NULL)
+                continue;
+
+            // Errors are reported by the read itself.
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                natsConnection_ProcessReadEvent(nc);
+            if (events[i].events & EPOLLOUT)
+                natsConnection_ProcessWriteEvent(nc);
+        }
+
+        natsMutex_Lock(t->mu);
+        detached = _sweep(t);
+        if ((stop = t->shutdown))
+            t->stopped = true;
+        natsMutex_Unlock(t->mu);
+
+        _notifyDetached(detached);
+
+        if (stop)
+            break;
+    }
+
+    natsLib_Release();
+}
+
+static natsStatus
+_ioPoolCtl(natsIOPoolSock *sock, int op, bool write)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = EPOLLIN | (write ? EPOLLOUT : 0);
+    ev.data.ptr = (void*) sock;
+
+    if (epoll_ctl(sock->conn->thread->epfd, op, sock->fd, &ev) != 0)
+        return nats_setError(NATS_SYS_ERROR, "epoll_ctl error: %d", errno);
+
+    return NATS_OK;
+}
+
+static natsStatus
+_ioPoolAttach(void **userData, void *loop, natsConnection *nc, natsSock socket)
+{
+    natsStatus          s     = NATS_OK;
+    natsIOPoolThread    *t    = (natsIOPoolThread*) loop;
+    natsIOPoolConn      *conn = (natsIOPoolConn*) *userData;
+    natsIOPoolSock      *sock;
+
+    sock = (natsIOPoolSock*) NATS_CALLOC(1, sizeof(natsIOPoolSock));
+    if (sock == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    sock->fd = socket;
+
+    natsMutex_Lock(t->mu);
+
+    if (t->stopped)
+        s = nats_setError(NATS_ILLEGAL_STATE, "%s", "I/O pool thread is stopped");
+
+    if ((s == NATS_OK) && (conn == NULL))
+    {
+        conn = (natsIOPoolConn*) NATS_CALLOC(1, sizeof(natsIOPoolConn));
+        if (conn == NULL)
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+        else
+        {
+            conn->thread = t;
+            conn->nc     = nc;
+            *userData    = (void*) conn;
+        }
+    }
+    if (s == NATS_OK)
+    {
+        sock->conn = conn;
+        s = _ioPoolCtl(sock, EPOLL_CTL_ADD, false);
+    }
+    if (s == NATS_OK)
+        conn->sock = sock;
+
+    natsMutex_Unlock(t->mu);
+
+    if (s != NATS_OK)
+        NATS_FREE(sock);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+static natsStatus
+_ioPoolRead(void *userData, bool add)
+{
+    natsIOPoolConn      *conn = (natsIOPoolConn*) userData;
+    natsIOPoolThread    *t    = conn->thread;
+    natsIOPoolSock      *sock;
+
+    // Reads are polled as long as the socket is attached, removing the read
+    // means that the socket needs to be closed.
+    if (add)
+        return NATS_OK;
+
+    natsMutex_Lock(t->mu);
+    if ((sock = conn->sock) != NULL)
+    {
+        conn->sock    = NULL;
+        sock->closing = true;
+
+        (void) epoll_ctl(t->epfd, EPOLL_CTL_DEL, sock->fd, NULL);
+        natsConnection_ProcessCloseEvent(&(sock->fd));
+
+        if (t->stopped)
+        {
+            NATS_FREE(sock);
+        }
+        else
+        {
+            sock->next     = t->closedSocks;
+            t->closedSocks = sock;
+        }
+    }
+    natsMutex_Unlock(t->mu);
+
+    return NATS_OK;
+}
+
+static natsStatus
+_ioPoolWrite(void *userData, bool add)
+{
+    natsStatus          s     = NATS_OK;
+    natsIOPoolConn      *conn = (natsIOPoolConn*) userData;
+    natsIOPoolThread    *t    = conn->thread;
+
+    natsMutex_Lock(t->mu);
+    if (conn->sock != NULL)
+        s = _ioPoolCtl(conn->sock, EPOLL_CTL_MOD, add);
+    natsMutex_Unlock(t->mu);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+static natsStatus
+_ioPoolDetach(void *userData)
+{
+    natsIOPoolConn      *conn = (natsIOPoolConn*) userData;
+    natsIOPoolThread    *t    = conn->thread;
+    bool                now   = false;
+
+    (void) _ioPoolRead(userData, false);
+
+    natsMutex_Lock(t->mu);
+    if (t->stopped)
+    {
+        now = true;
+    }
+    else
+    {
+        conn->next       = t->detachedConns;
+        t->detachedConns = conn;
+        _wakeUp(t);
+    }
+    natsMutex_Unlock(t->mu);
+
+    if (now)
+    {
+        conn->next = NULL;
+        _notifyDetached(conn);
+    }
+
+    return NATS_OK;
+}
+
+natsStatus
+nats_initIOPool(natsLib *lib, int size)
+{
+    natsStatus          s = NATS_OK;
+    natsIOPoolThread    *t = NULL;
+    int                 i;
+
+    lib->ioPool = (natsIOPoolThread**) NATS_CALLOC(size, sizeof(natsIOPoolThread*));
+    if (lib->ioPool == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    for (i=0; (s == NATS_OK) && (i<size); i++)
+    {
+        s = _createThread(&t);
+        if (s != NATS_OK)
+            break;
+
+        lib->ioPool[lib->ioPoolSize++] = t;
+
+        s = natsThread_Create(&(t->thread), nats_ioPoolThreadf, t);
+        if (s == NATS_OK)
+            lib->refs++;
+    }
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+void
+nats_shutdownIOPool(natsLib *lib)
+{
+    natsIOPoolThread    *t;
+    int                 i;
+
+    for (i=0; i<lib->ioPoolSize; i++)
+    {
+        t = lib->ioPool[i];
+
+        natsMutex_Lock(t->mu);
+        t->shutdown = true;
+        if (t->thread == NULL)
+            t->stopped = true;
+        else
+            _wakeUp(t);
+        natsMutex_Unlock(t->mu);
+    }
+}
+
+void
+nats_joinIOPool(natsLib *lib)
+{
+    int i;
+
+    for (i=0; i<lib->ioPoolSize; i++)
+    {
+        if (lib->ioPool[i]->thread != NULL)
+            natsThread_Join(lib->ioPool[i]->thread);
+    }
+}
+
+void
+nats_freeIOPool(natsLib *lib)
+{
+    int i;
+
+    for (i=0; i<lib->ioPoolSize; i++)
+        _freeThread(lib->ioPool[i]);
+
+    NATS_FREE(lib->ioPool);
+}
+
+bool
+nats_useIOPoolThread(natsOptions *opts)
+{
+    natsLib             *lib = nats_lib();
+    natsIOPoolThread    *t   = NULL;
+
+    natsMutex_Lock(lib->lock);
+    if ((lib->ioPoolSize > 0) && !(lib->closed))
+    {
+        t = lib->ioPool[lib->nextIOPoolThread];
+        lib->nextIOPoolThread = (lib->nextIOPoolThread + 1) % lib->ioPoolSize;
+    }
+    natsMutex_Unlock(lib->lock);
+
+    if (t == NULL)
+        return false;
+
+    opts->evLoop        = (void*) t;
+    opts->evCbs.attach  = _ioPoolAttach;
+    opts->evCbs.read    = _ioPoolRead;
+    opts->evCbs.write   = _ioPoolWrite;
+    opts->evCbs.detach  = _ioPoolDetach;
+
+    return true;
+}
+
+#else
+
+natsStatus
+nats_initIOPool(natsLib *lib, int size)
+{
+    return NATS_OK;
+}
+
+void
+nats_shutdownIOPool(natsLib *lib)
+{
+}
+
+void
+nats_joinIOPool(natsLib *lib)
+{
+}
+
+void
+nats_freeIOPool(natsLib *lib)
+{
+}
+
+void
+nats_ioPoolThreadf(void *arg)
+{
+}
+
+bool
+nats_useIOPoolThread(natsOptions *opts)
+{
+    return false;
+}
+
+#endif // __linux__
@@ -0,0 +1,948 @@
+// Copyright 2026 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "glibp.h"
+
+#if defined(__linux__) && defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+#  if defined(IORING_RECV_MULTISHOT)
+#   define NATS_HAS_IO_URING
+#  endif
+# endif
+#endif
+
+#if defined(NATS_HAS_IO_URING)
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+
+#include "../conn.h"
+#include "../comsock.h"
+
+// The I/O threads plug into connections as an event loop (see natsEvLoop_Attach
+// and friends). Plain sockets are read with a multishot receive into buffers
+// provided to the kernel, whose data is handed to natsConn_processReadData().
+// Secure sockets (and all of them if the kernel does not support multishot
+// receives) are polled, and read by natsConnection_ProcessReadEvent(). Writes
+// are always done by natsConnection_ProcessWriteEvent() when the socket is
+// reported writable.
+//
+// The kernel cancels the operations submitted by a thread when it exits, so
+// they are only submitted by the I/O thread: other threads queue them and
+// wake it up through an eventfd.
+
+#define IOURING_SQ_ENTRIES  (1024)
+#define IOURING_CQ_ENTRIES  (4096)
+
+// Buffers provided to the kernel for the multishot receives, shared by all
+// sockets of a thread. The count must be a power of 2.
+#define IOURING_BUF_COUNT   (64)
+#define IOURING_BUF_SIZE    (32 * 1024)
+#define IOURING_BUF_GROUP   (0)
+
+// The low bits of the user data of an operation is its kind, the rest is the
+// socket it is for. The user data of cancels is 0, their completion being
+// ignored.
+#define IOURING_OP_RECV     (1)
+#define IOURING_OP_POLLIN   (2)
+#define IOURING_OP_POLLOUT  (3)
+#define IOURING_OP_WAKE     (4)
+#define IOURING_OP_MASK     ((uint64_t) 7)
+
+typedef struct __natsIOUringConn natsIOUringConn;
+
+// A connection gets a new socket on each (re)connect. The previous one is
+// closed only when the kernel is done with the operations referencing it.
+typedef struct __natsIOUringSock
+{
+    natsIOUringConn *conn;
+    natsSock        fd;
+    bool            pollMode;
+    bool            readArmed;
+    bool            writeArmed;
+    bool            wantWrite;
+    bool            failed;
+    bool            closing;
+    // Operations in the ring, plus callbacks in progress.
+    int             pending;
+
+} natsIOUringSock;
+
+struct __natsIOUringConn
+{
+    natsIOUring     *ring;
+    natsConnection  *nc;
+    natsIOUringSock *sock;
+    int             socks;
+    bool            detached;
+};
+
+struct __natsIOUring
+{
+    natsMutex               *mu;
+    natsThread              *thread;
+    int                     fd;
+    int                     wakeFd;
+    bool                    wakePending;
+
+    void                    *rings;
+    size_t                  ringsSize;
+    struct io_uring_sqe     *sqes;
+    size_t                  sqesSize;
+    unsigned                *sqHead;
+    unsigned                *sqTail;
+    unsigned                *sqArray;
+    unsigned                sqMask;
+    unsigned                sqEntries;
+    unsigned                *cqHead;
+    unsigned                *cqTail;
+    unsigned                cqMask;
+    struct io_uring_cqe     *cqes;
+
+    struct io_uring_buf_ring *bufRing;
+    char                    *bufs;
+    unsigned short          bufTail;
+    bool                    multishot;
+
+    // Number of sockets closing, but not closed yet.
+    int                     closing;
+    bool                    shutdown;
+    bool                    stopped;
+};
+
+static int
+_ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int) syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static uint32_t
+_pollMask(uint32_t events)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    events = (events << 16) | (events >> 16);
+#endif
+    return events;
+}
+
+static void
+_provideBuffer(natsIOUring *r, int bid)
+{
+    struct io_uring_buf *buf;
+
+    buf = &(r->bufRing->bufs[r->bufTail & (IOURING_BUF_COUNT - 1)]);
+    buf->addr = (uint64_t) (uintptr_t) (r->bufs + ((size_t) bid * IOURING_BUF_SIZE));
+    buf->len  = IOURING_BUF_SIZE;
+    buf->bid  = (unsigned short) bid;
+
+    r->bufTail++;
+    __atomic_store_n(&(r->bufRing->tail), r->bufTail, __ATOMIC_RELEASE);
+}
+
+// Registers the buffers used by multishot receives. On failure, sockets will
+// simply be polled.
+static void
+_setupBuffers(natsIOUring *r)
+{
+    struct io_uring_buf_reg reg;
+    void                    *mem = NULL;
+    int                     i;
+
+    if (posix_memalign(&mem, 4096, IOURING_BUF_COUNT * sizeof(struct io_uring_buf)) != 0)
+        return;
+
+    memset(mem, 0, IOURING_BUF_COUNT * sizeof(struct io_uring_buf));
+
+    r->bufs = (char*) NATS_MALLOC((size_t) IOURING_BUF_COUNT * IOURING_BUF_SIZE);
+    if (r->bufs != NULL)
+    {
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr    = (uint64_t) (uintptr_t) mem;
+        reg.ring_entries = IOURING_BUF_COUNT;
+        reg.bgid         = IOURING_BUF_GROUP;
+
+        if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        {
+            NATS_FREE(r->bufs);
+            r->bufs = NULL;
+        }
+    }
+    if (r->bufs == NULL)
+    {
+        free(mem);
+        return;
+    }
+
+    r->bufRing = (struct io_uring_buf_ring*) mem;
+    for (i=0; i<IOURING_BUF_COUNT; i++)
+        _provideBuffer(r, i);
+
+    r->multishot = true;
+}
+
+static void
+_freeRing(natsIOUring *r)
+{
+    if (r == NULL)
+        return;
+
+    if (r->fd >= 0)
+        close(r->fd);
+    if (r->wakeFd >= 0)
+        close(r->wakeFd);
+    if (r->sqes != NULL)
+        munmap(r->sqes, r->sqesSize);
+    if (r->rings != NULL)
+        munmap(r->rings, r->ringsSize);
+    // The kernel is done with the buffers only once the ring is closed.
+    free(r->bufRing);
+    NATS_FREE(r->bufs);
+    natsThread_Destroy(r->thread);
+    natsMutex_Destroy(r->mu);
+    NATS_FREE(r);
+}
+
+static natsStatus
+_createRing(natsIOUring **newRing)
+{
+    natsStatus              s = NATS_OK;
+    natsIOUring             *r;
+    struct io_uring_params  p;
+    size_t                  cqSize;
+    char                    *base;
+    void                    *mem;
+
+    r = (natsIOUring*) NATS_CALLOC(1, sizeof(natsIOUring));
+    if (r == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    r->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    memset(&p, 0, sizeof(p));
+    p.flags      = IORING_SETUP_CQSIZE;
+    p.cq_entries = IOURING_CQ_ENTRIES;
+
+    r->fd = (int) syscall(__NR_io_uring_setup, IOURING_SQ_ENTRIES, &p);
+    if (r->wakeFd < 0)
+        s = nats_setError(NATS_SYS_ERROR, "eventfd error: %d", errno);
+    else if (r->fd < 0)
+        s = nats_setError(NATS_SYS_ERROR, "io_uring_setup error: %d", errno);
+    else if (!(p.features & IORING_FEAT_SINGLE_MMAP))
+        s = nats_setError(NATS_SYS_ERROR, "%s", "io_uring single mmap not supported");
+
+    if (s == NATS_OK)
+    {
+        r->ringsSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqSize       = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        if (cqSize > r->ringsSize)
+            r->ringsSize = cqSize;
+
+        mem = mmap(NULL, r->ringsSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+        if (mem == MAP_FAILED)
+            s = nats_setError(NATS_SYS_ERROR, "io_uring rings mmap error: %d", errno);
+        else
+            r->rings = mem;
+    }
+    if (s == NATS_OK)
+    {
+        r->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+
+        mem = mmap(NULL, r->sqesSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+        if (mem == MAP_FAILED)
+            s = nats_setError(NATS_SYS_ERROR, "io_uring sqes mmap error: %d", errno);
+        else
+            r->sqes = (struct io_uring_sqe*) mem;
+    }
+    if (s == NATS_OK)
+    {
+        base = (char*) r->rings;
+
+        r->sqHead    = (unsigned*) (base + p.sq_off.head);
+        r->sqTail    = (unsigned*) (base + p.sq_off.tail);
+        r->sqArray   = (unsigned*) (base + p.sq_off.array);
+        r->sqMask    = *((unsigned*) (base + p.sq_off.ring_mask));
+        r->sqEntries = *((unsigned*) (base + p.sq_off.ring_entries));
+        r->cqHead    = (unsigned*) (base + p.cq_off.head);
+        r->cqTail    = (unsigned*) (base + p.cq_off.tail);
+        r->cqMask    = *((unsigned*) (base + p.cq_off.ring_mask));
+        r->cqes      = (struct io_uring_cqe*) (base + p.cq_off.cqes);
+
+        s = natsMutex_Create(&(r->mu));
+    }
+    if (s == NATS_OK)
+    {
+        _setupBuffers(r);
+        *newRing = r;
+    }
+    else
+    {
+        _freeRing(r);
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+static void
+_submitQueued(natsIOUring *r, unsigned minComplete, unsigned flags)
+{
+    unsigned toSubmit = __atomic_load_n(r->sqTail, __ATOMIC_ACQUIRE)
+                        - __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE);
+
+    if ((_ioUringEnter(r->fd, toSubmit, minComplete, flags) < 0)
+        && (errno != EINTR) && (errno != EBUSY) && (errno != EAGAIN))
+    {
+        nats_Sleep(1);
+    }
+}
+
+// Returns a zeroed submission entry, or NULL if the queue is full.
+// Lock held on entry.
+static struct io_uring_sqe*
+_getSQE(natsIOUring *r)
+{
+    struct io_uring_sqe *sqe;
+    unsigned            tail = *(r->sqTail);
+    unsigned            idx  = tail & r->sqMask;
+
+    if ((tail - __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE)) >= r->sqEntries)
+    {
+        if (!natsThread_IsCurrent(r->thread))
+            return NULL;
+
+        _submitQueued(r, 0, 0);
+        if ((tail - __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE)) >= r->sqEntries)
+            return NULL;
+    }
+
+    sqe = &(r->sqes[idx]);
+    memset(sqe, 0, sizeof(*sqe));
+    r->sqArray[idx] = idx;
+
+    return sqe;
+}
+
+// Lock held on entry.
+static void
+_wakeUp(natsIOUring *r)
+{
+    uint64_t one = 1;
+
+    if (r->wakePending)
+        return;
+
+    r->wakePending = true;
+    if (write(r->wakeFd, &one, sizeof(one)) < 0)
+        r->wakePending = false;
+}
+
+// Publishes the entry returned by _getSQE(), the I/O thread submits it.
+// Lock held on entry.
+static void
+_submit(natsIOUring *r)
+{
+    __atomic_store_n(r->sqTail, *(r->sqTail) + 1, __ATOMIC_RELEASE);
+
+    if (!natsThread_IsCurrent(r->thread))
+        _wakeUp(r);
+}
+
+static natsStatus
+_queueFull(void)
+{
+    return nats_setError(NATS_SYS_ERROR, "%s", "io_uring submission queue is full");
+}
+
+// Lock held on entry.
+static natsStatus
+_armRead(natsIOUring *r, natsIOUringSock *sock)
+{
+    struct io_uring_sqe *sqe = _getSQE(r);
+
+    if (sqe == NULL)
+        return _queueFull();
+
+    sqe->fd = sock->fd;
+    if (sock->pollMode)
+    {
+        sqe->opcode        = IORING_OP_POLL_ADD;
+        sqe->len           = IORING_POLL_ADD_MULTI;
+        sqe->poll32_events = _pollMask(POLLIN);
+        sqe->user_data     = (uint64_t) (uintptr_t) sock | IOURING_OP_POLLIN;
+    }
+    else
+    {
+        sqe->opcode    = IORING_OP_RECV;
+        sqe->ioprio    = IORING_RECV_MULTISHOT;
+        sqe->flags     = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = IOURING_BUF_GROUP;
+        sqe->user_data = (uint64_t) (uintptr_t) sock | IOURING_OP_RECV;
+    }
+    _submit(r);
+
+    sock->readArmed = true;
+    sock->pending++;
+
+    return NATS_OK;
+}
+
+// Lock held on entry.
+static void
+_armWake(natsIOUring *r)
+{
+    struct io_uring_sqe *sqe = _getSQE(r);
+
+    if (sqe == NULL)
+        return;
+
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = r->wakeFd;
+    sqe->len           = IORING_POLL_ADD_MULTI;
+    sqe->poll32_events = _pollMask(POLLIN);
+    sqe->user_data     = IOURING_OP_WAKE;
+
+    _submit(r);
+}
+
+// Lock held on entry.
+static natsStatus
+_armWrite(natsIOUring *r, natsIOUringSock *sock)
+{
+    struct io_uring_sqe *sqe = _getSQE(r);
+
+    if (sqe == NULL)
+        return _queueFull();
+
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = sock->fd;
+    sqe->poll32_events = _pollMask(POLLOUT);
+    sqe->user_data     = (uint64_t) (uintptr_t) sock | IOURING_OP_POLLOUT;
+    _submit(r);
+
+    sock->writeArmed = true;
+    sock->pending++;
+
+    return NATS_OK;
+}
+
+// Lock held on entry.
+static void
+_cancel(natsIOUring *r, uint64_t target)
+{
+    struct io_uring_sqe *sqe = _getSQE(r);
+
+    if (sqe == NULL)
+        return;
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd     = -1;
+    sqe->addr   = target;
+    _submit(r);
+}
+
+// Closes and frees the socket if it is closing and the kernel is done with
+// it. If this was the last socket of a detached connection, the connection
+// is freed and returned so that the caller notifies the library (outside of
+// the lock).
+// Lock held on entry.
+static natsConnection*
+_releaseSock(natsIOUring *r, natsIOUringSock *sock)
+{
+    natsIOUringConn *conn = sock->conn;
+    natsConnection  *nc   = NULL;
+
+    if (!(sock->closing) || (sock->pending > 0))
+        return NULL;
+
+    natsConnection_ProcessCloseEvent(&(sock->fd));
+    NATS_FREE(sock);
+
+    r->closing--;
+    if ((--(conn->socks) == 0) && conn->detached)
+    {
+        nc = conn->nc;
+        NATS_FREE(conn);
+    }
+    return nc;
+}
+
+// Lock held on entry.
+static natsConnection*
+_closeSock(natsIOUring *r, natsIOUringSock *sock)
+{
+    uint64_t ud = (uint64_t) (uintptr_t) sock;
+
+    sock->closing   = true;
+    sock->wantWrite = false;
+    sock->conn->sock = NULL;
+    r->closing++;
+
+    // Completes the pending operations even if a cancel can't be submitted.
+    natsSock_Shutdown(sock->fd);
+
+    if (r->stopped)
+    {
+        // Nobody will reap the completions, the ring being closed when the
+        // library is freed.
+        sock->pending = 0;
+    }
+    else
+    {
+        if (sock->readArmed)
+            _cancel(r, ud | (sock->pollMode ? IOURING_OP_POLLIN : IOURING_OP_RECV));
+        if (sock->writeArmed)
+            _cancel(r, ud | IOURING_OP_POLLOUT);
+    }
+
+    return _releaseSock(r, sock);
+}
+
+static void
+_processCompletion(natsIOUring *r, uint64_t ud, int res, unsigned flags)
+{
+    natsIOUringSock *sock   = (natsIOUringSock*) (uintptr_t) (ud & ~IOURING_OP_MASK);
+    int             op      = (int) (ud & IOURING_OP_MASK);
+    bool            more    = ((flags & IORING_CQE_F_MORE) != 0);
+    int             bid     = -1;
+    int             call    = 0;
+    natsStatus      err     = NATS_OK;
+    natsStatus      s;
+    natsConnection  *nc;
+    natsSock        fd;
+
+    if (ud == 0)
+        return;
+
+    if (ud == IOURING_OP_WAKE)
+    {
+        uint64_t count;
+
+        natsMutex_Lock(r->mu);
+        r->wakePending = false;
+        if (read(r->wakeFd, &count, sizeof(count)) < 0)
+            count = 0;
+        if (!more)
+            _armWake(r);
+        natsMutex_Unlock(r->mu);
+        return;
+    }
+
+    natsMutex_Lock(r->mu);
+
+    nc = sock->conn->nc;
+    fd = sock->fd;
+
+    if (flags & IORING_CQE_F_BUFFER)
+        bid = (int) (flags >> IORING_CQE_BUFFER_SHIFT);
+
+    if (op == IOURING_OP_POLLOUT)
+    {
+        sock->writeArmed = false;
+        sock->pending--;
+    }
+    else if (!more)
+    {
+        sock->readArmed = false;
+        sock->pending--;
+    }
+
+    if (!(sock->closing) && !(sock->failed))
+    {
+        if (op == IOURING_OP_RECV)
+        {
+            if (res > 0)
+                call = op;
+            else if (res == 0)
+                err = NATS_CONNECTION_CLOSED;
+            else if ((res == -EINVAL) && !more)
+            {
+                // Multishot receive not supported by the kernel.
+                r->multishot  = false;
+                sock->pollMode = true;
+            }
+            else if ((res != -ENOBUFS) && (res != -ECANCELED))
+                err = NATS_IO_ERROR;
+        }
+        else if (op == IOURING_OP_POLLIN)
+        {
+            // Errors are reported by the read itself.
+            if (res != -ECANCELED)
+                call = op;
+        }
+        else if (sock->wantWrite && (res != -ECANCELED))
+        {
+            call = op;
+        }
+    }
+
+    for (;;)
+    {
+        if (err != NATS_OK)
+        {
+            sock->failed = true;
+            call = IOURING_OP_RECV;
+            res  = 0;
+        }
+        if (call != 0)
+        {
+            sock->pending++;
+            natsMutex_Unlock(r->mu);
+
+            if (call == IOURING_OP_RECV)
+            {
+                natsConn_processReadData(nc, fd,
+                                         (err == NATS_OK ? r->bufs + ((size_t) bid * IOURING_BUF_SIZE) : NULL),
+                                         res, err);
+            }
+            else if (call == IOURING_OP_POLLIN)
+                natsConnection_ProcessReadEvent(nc);
+            else
+                natsConnection_ProcessWriteEvent(nc);
+
+            natsMutex_Lock(r->mu);
+            sock->pending--;
+            call = 0;
+        }
+        if (bid >= 0)
+        {
+            _provideBuffer(r, bid);
+            bid = -1;
+        }
+        if (sock->closing || sock->failed)
+            break;
+
+        // Re-arm what has completed.
+        s = NATS_OK;
+        if (!(sock->readArmed))
+            s = _armRead(r, sock);
+        if ((s == NATS_OK) && sock->wantWrite && !(sock->writeArmed))
+            s = _armWrite(r, sock);
+        if (s == NATS_OK)
+            break;
+
+        err = NATS_IO_ERROR;
+    }
+
+    nc = _releaseSock(r, sock);
+
+    natsMutex_Unlock(r->mu);
+
+    if (nc != NULL)
+        natsConnection_ProcessDetachedEvent(nc);
+}
+
+void
+nats_ioUringThreadf(void *arg)
+{
+    natsLib             *lib = nats_lib();
+    natsIOUring         *r   = (natsIOUring*) arg;
+    struct io_uring_cqe *cqe;
+    unsigned            head, tail;
+    uint64_t            ud;
+    unsigned            flags;
+    int                 res;
+
+    WAIT_LIB_INITIALIZED(lib);
+
+    natsMutex_Lock(r->mu);
+    _armWake(r);
+    natsMutex_Unlock(r->mu);
+
+    for (;;)
+    {
+        natsMutex_Lock(r->mu);
+        // Keep going until the sockets being closed are done with.
+        if (r->shutdown && (r->closing == 0))
+        {
+            r->stopped = true;
+            natsMutex_Unlock(r->mu);
+            break;
+        }
+        natsMutex_Unlock(r->mu);
+
+        // Entries queued by other threads while we wait come with a wake up.
+        _submitQueued(r, 1, IORING_ENTER_GETEVENTS);
+
+        head = *(r->cqHead);
+        tail = __atomic_load_n(r->cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail)
+        {
+            cqe   = &(r->cqes[head & r->cqMask]);
+            ud    = cqe->user_data;
+            res   = cqe->res;
+            flags = cqe->flags;
+
+            __atomic_store_n(r->cqHead, ++head, __ATOMIC_RELEASE);
+
+            _processCompletion(r, ud, res, flags);
+        }
+    }
+
+    natsLib_Release();
+}
+
+static natsStatus
+_ioUringAttach(void **userData, void *loop, natsConnection *nc, natsSock socket)
+{
+    natsStatus      s     = NATS_OK;
+    natsIOUring     *r    = (natsIOUring*) loop;
+    natsIOUringConn *conn = (natsIOUringConn*) *userData;
+    natsIOUringSock *sock;
+
+    sock = (natsIOUringSock*) NATS_CALLOC(1, sizeof(natsIOUringSock));
+    if (sock == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    sock->fd       = socket;
+    sock->pollMode = !(r->multishot);
+#if defined(NATS_HAS_TLS)
+    if (nc->sockCtx.ssl != NULL)
+        sock->pollMode = true;
+#endif
+
+    natsMutex_Lock(r->mu);
+
+    if (r->stopped)
+        s = nats_setError(NATS_ILLEGAL_STATE, "%s", "I/O thread is stopped");
+
+    if ((s == NATS_OK) && (conn == NULL))
+    {
+        conn = (natsIOUringConn*) NATS_CALLOC(1, sizeof(natsIOUringConn));
+        if (conn == NULL)
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+        else
+        {
+            conn->ring = r;
+            conn->nc   = nc;
+            *userData  = (void*) conn;
+        }
+    }
+    if (s == NATS_OK)
+    {
+        sock->conn = conn;
+        s = _armRead(r, sock);
+    }
+    if (s == NATS_OK)
+    {
+        conn->sock = sock;
+        conn->socks++;
+    }
+
+    natsMutex_Unlock(r->mu);
+
+    if (s != NATS_OK)
+        NATS_FREE(sock);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+static natsStatus
+_ioUringRead(void *userData, bool add)
+{
+    natsIOUringConn *conn = (natsIOUringConn*) userData;
+    natsIOUring     *r    = conn->ring;
+
+    // Reads are done as long as the socket is attached, removing the read
+    // means that the socket needs to be closed.
+    if (add)
+        return NATS_OK;
+
+    natsMutex_Lock(r->mu);
+    if (conn->sock != NULL)
+        (void) _closeSock(r, conn->sock);
+    natsMutex_Unlock(r->mu);
+
+    return NATS_OK;
+}
+
+static natsStatus
+_ioUringWrite(void *userData, bool add)
+{
+    natsStatus      s     = NATS_OK;
+    natsIOUringConn *conn = (natsIOUringConn*) userData;
+    natsIOUring     *r    = conn->ring;
+    natsIOUringSock *sock;
+
+    natsMutex_Lock(r->mu);
+    if ((sock = conn->sock) != NULL)
+    {
+        sock->wantWrite = add;
+        if (add && !(sock->writeArmed) && !(sock->failed) && !(r->stopped))
+            s = _armWrite(r, sock);
+    }
+    natsMutex_Unlock(r->mu);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+static natsStatus
+_ioUringDetach(void *userData)
+{
+    natsIOUringConn *conn = (natsIOUringConn*) userData;
+    natsIOUring     *r    = conn->ring;
+    natsConnection  *nc   = NULL;
+
+    natsMutex_Lock(r->mu);
+    conn->detached = true;
+    if (conn->sock != NULL)
+        nc = _closeSock(r, conn->sock);
+    else if (conn->socks == 0)
+    {
+        nc = conn->nc;
+        NATS_FREE(conn);
+    }
+    natsMutex_Unlock(r->mu);
+
+    if (nc != NULL)
+        natsConnection_ProcessDetachedEvent(nc);
+
+    return NATS_OK;
+}
+
+natsStatus
+nats_initIOUrings(natsLib *lib, int count)
+{
+    natsStatus  s = NATS_OK;
+    natsIOUring *r = NULL;
+    int         i;
+
+    lib->ioUrings = (natsIOUring**) NATS_CALLOC(count, sizeof(natsIOUring*));
+    if (lib->ioUrings == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    for (i=0; (s == NATS_OK) && (i<count); i++)
+    {
+        if (_createRing(&r) != NATS_OK)
+        {
+            // Not available or not permitted, connections will use their
+            // own threads if no ring could be created.
+            nats_clearLastError();
+            break;
+        }
+        lib->ioUrings[lib->numIOUrings++] = r;
+
+        s = natsThread_Create(&(r->thread), nats_ioUringThreadf, r);
+        if (s == NATS_OK)
+            lib->refs++;
+    }
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+void
+nats_shutdownIOUrings(natsLib *lib)
+{
+    natsIOUring *r;
+    int         i;
+
+    for (i=0; i<lib->numIOUrings; i++)
+    {
+        r = lib->ioUrings[i];
+
+        natsMutex_Lock(r->mu);
+        r->shutdown = true;
+        if (r->thread == NULL)
+            r->stopped = true;
+        else
+            _wakeUp(r);
+        natsMutex_Unlock(r->mu);
+    }
+}
+
+void
+nats_joinIOUrings(natsLib *lib)
+{
+    int i;
+
+    for (i=0; i<lib->numIOUrings; i++)
+    {
+        if (lib->ioUrings[i]->thread != NULL)
+            natsThread_Join(lib->ioUrings[i]->thread);
+    }
+}
+
+void
+nats_freeIOUrings(natsLib *lib)
+{
+    int i;
+
+    for (i=0; i<lib->numIOUrings; i++)
+        _freeRing(lib->ioUrings[i]);
+
+    NATS_FREE(lib->ioUrings);
+}
+
+bool
+nats_useIOUringThread(natsOptions *opts)
+{
+    natsLib     *lib = nats_lib();
+    natsIOUring *r   = NULL;
+
+    natsMutex_Lock(lib->lock);
+    if ((lib->numIOUrings > 0) && !(lib->closed))
+    {
+        r = lib->ioUrings[lib->nextIOUring];
+        lib->nextIOUring = (lib->nextIOUring + 1) % lib->numIOUrings;
+    }
+    natsMutex_Unlock(lib->lock);
+
+    if (r == NULL)
+        return false;
+
+    opts->evLoop        = (void*) r;
+    opts->evCbs.attach  = _ioUringAttach;
+    opts->evCbs.read    = _ioUringRead;
+    opts->evCbs.write   = _ioUringWrite;
+    opts->evCbs.detach  = _ioUringDetach;
+
+    return true;
+}
+
+#else
+
+natsStatus
+nats_initIOUrings(natsLib *lib, int count)
+{
+    return NATS_OK;
+}
+
+void
+nats_shutdownIOUrings(natsLib *lib)
+{
+}
+
+void
+nats_joinIOUrings(natsLib *lib)
+{
+}
+
+void
+nats_freeIOUrings(natsLib *lib)
+{
+}
+
+void
+nats_ioUringThreadf(void *arg)
+{
+}
+
+bool
+nats_useIOUringThread(natsOptions *opts)
+{
+    return false;
+}
+
+#endif // NATS_HAS_IO_URING
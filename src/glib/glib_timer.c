@@ -13,109 +13,345 @@
 
 #include "glibp.h"
 
+natsStatus
+nats_initTimers(natsLib *lib, int numShards)
+{
+    natsStatus      s = NATS_OK;
+    natsLibTimers   *timers;
+    int             i;
+
+    if (numShards <= 0)
+        numShards = 1;
+
+    lib->timerShards = (natsLibTimers*) NATS_CALLOC(numShards, sizeof(natsLibTimers));
+    if (lib->timerShards == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    lib->numTimerShards = numShards;
+
+    for (i=0; (s == NATS_OK) && (i<numShards); i++)
+    {
+        timers      = &(lib->timerShards[i]);
+        timers->now = nats_Now();
+
+        s = natsMutex_Create(&(timers->lock));
+        if (s == NATS_OK)
+            s = natsCondition_Create(&(timers->cond));
+        if (s == NATS_OK)
+        {
+            s = natsThread_Create(&(timers->thread), nats_timerThreadf, timers);
+            if (s == NATS_OK)
+                lib->refs++;
+        }
+    }
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+void
+nats_shutdownTimers(natsLib *lib, bool lock)
+{
+    natsLibTimers   *timers;
+    int             i;
+
+    for (i=0; i<lib->numTimerShards; i++)
+    {
+        timers = &(lib->timerShards[i]);
+        if (lock)
+            natsMutex_Lock(timers->lock);
+        timers->shutdown = true;
+        if (lock)
+        {
+            natsCondition_Signal(timers->cond);
+            natsMutex_Unlock(timers->lock);
+        }
+    }
+}
+
+void
+nats_joinTimers(natsLib *lib)
+{
+    int i;
+
+    for (i=0; i<lib->numTimerShards; i++)
+    {
+        if (lib->timerShards[i].thread != NULL)
+            natsThread_Join(lib->timerShards[i].thread);
+    }
+}
+
 void nats_freeTimers(natsLib *lib)
 {
-    natsLibTimers *timers = &(lib->timers);
+    natsLibTimers   *timers;
+    int             i;
+
+    for (i=0; i<lib->numTimerShards; i++)
+    {
+        timers = &(lib->timerShards[i]);
+
+        natsThread_Destroy(timers->thread);
+        natsCondition_Destroy(timers->cond);
+        natsMutex_Destroy(timers->lock);
+    }
+    NATS_FREE(lib->timerShards);
+}
+
+// Returns the shard a timer belongs to. Timers with the same closure, such
+// as the ones of a connection, are in the same shard.
+static natsLibTimers*
+_timerShard(natsLib *lib, natsTimer *t)
+{
+    uint64_t h = (uint64_t) (uintptr_t) t->closure;
+
+    if (lib->numTimerShards == 1)
+        return &(lib->timerShards[0]);
+
+    h ^= (h >> 33);
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= (h >> 33);
+
+    return &(lib->timerShards[h % (uint64_t) lib->numTimerShards]);
+}
+
+#define WHEEL_BITS      NATS_TIMER_WHEEL_BITS
+#define WHEEL_SLOTS     NATS_TIMER_WHEEL_SLOTS
+#define WHEEL_LEVELS    NATS_TIMER_WHEEL_LEVELS
+#define WHEEL_WORDS     (WHEEL_SLOTS / 64)
+
+// Timers further in the future than this are placed at the end of the last
+// level, and moved again when the wheel gets there.
+#define WHEEL_RANGE     ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+// Mask of the ticks within a slot of the given level.
+#define WHEEL_MASK(l)   (((int64_t) 1 << (WHEEL_BITS * (l))) - 1)
+
+static inline natsTimer**
+_timerListHead(natsLibTimers *timers, natsTimer *t)
+{
+    if (t->wheelLevel < 0)
+        return &(timers->firing);
 
-    natsThread_Destroy(timers->thread);
-    natsCondition_Destroy(timers->cond);
-    natsMutex_Destroy(timers->lock);
+    return &(timers->wheel[t->wheelLevel][t->wheelSlot]);
 }
 
+// Returns the first non empty slot of the level, starting at `from`,
+// or -1 if there is none.
+static int
+_nextUsedSlot(natsLibTimers *timers, int level, int from)
+{
+    uint64_t    bits;
+    int         w;
+    int         i;
+
+    for (w = (from / 64); w < WHEEL_WORDS; w++)
+    {
+        bits = timers->used[level][w];
+        if (w == (from / 64))
+            bits &= (~((uint64_t) 0)) << (from % 64);
+        if (bits == 0)
+            continue;
+        for (i = 0; (bits & 1) == 0; i++)
+            bits >>= 1;
+        return (w * 64) + i;
+    }
+    return -1;
+}
+
+// Timers lock must be held.
 static void
-_insertTimer(natsTimer *t)
+_insertTimer(natsLibTimers *timers, natsTimer *t)
 {
-    natsLibTimers   *timers = &(nats_lib()->timers);
-    natsTimer       *tail   = timers->tail;
-    natsTimer       *cur    = NULL;
-    natsTimer       *prev   = NULL;
+    int64_t         exp     = t->absoluteTime;
+    int             level   = 0;
+    natsTimer       **head;
+
+    // A timer that is already due fires with the next tick.
+    if (exp < timers->now)
+        exp = timers->now;
+    else if ((exp - timers->now) >= WHEEL_RANGE)
+        exp = timers->now + WHEEL_RANGE - 1;
+
+    // Use the first level whose range covers the timer.
+    while ((level < WHEEL_LEVELS - 1) && ((exp - timers->now) > WHEEL_MASK(level + 1)))
+        level++;
+
+    t->wheelLevel   = level;
+    t->wheelSlot    = (int) ((exp >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+
+    head = _timerListHead(timers, t);
+    t->prev = NULL;
+    t->next = *head;
+    if (*head != NULL)
+        (*head)->prev = t;
+    *head = t;
+
+    timers->used[level][t->wheelSlot / 64] |= ((uint64_t) 1 << (t->wheelSlot % 64));
+}
+
+// Timers lock must be held.
+static void
+_unlinkTimer(natsLibTimers *timers, natsTimer *t)
+{
+    natsTimer **head = _timerListHead(timers, t);
+
+    if (t->prev != NULL)
+        t->prev->next = t->next;
+    else
+        *head = t->next;
+    if (t->next != NULL)
+        t->next->prev = t->prev;
+
+    if ((*head == NULL) && (t->wheelLevel >= 0))
+        timers->used[t->wheelLevel][t->wheelSlot / 64] &= ~((uint64_t) 1 << (t->wheelSlot % 64));
+
+    t->prev = NULL;
+    t->next = NULL;
+}
 
-    // Can we insert as the last in the list?
-    if ((tail != NULL) && (tail->absoluteTime <= t->absoluteTime))
+// Returns the time at which the wheel needs to be processed next, that is,
+// when it reaches a non empty slot, or -1 if there is no timer in the wheel.
+// For levels above 0, this is the start of the slot, when its timers need to
+// be moved to lower levels.
+static int64_t
+_nextWheelTime(natsLibTimers *timers)
+{
+    int64_t next = -1;
+    int64_t t;
+    int64_t base;
+    int     shift;
+    int     cur;
+    int     from;
+    int     slot;
+    int     level;
+
+    for (level = 0; level < WHEEL_LEVELS; level++)
     {
-        t->prev = tail;
-        t->next = NULL;
-        // If there was a previous tail, then link to `t`.
-        if (tail != NULL)
-            tail->next = t;
-        else
+        shift   = WHEEL_BITS * level;
+        base    = timers->now & ~WHEEL_MASK(level + 1);
+        cur     = (int) ((timers->now >> shift) & (WHEEL_SLOTS - 1));
+
+        // If we are past the start of the current slot, it has already been
+        // processed and its timers are for the next round.
+        from = cur + ((timers->now & WHEEL_MASK(level)) != 0 ? 1 : 0);
+        slot = (from < WHEEL_SLOTS ? _nextUsedSlot(timers, level, from) : -1);
+        if (slot < 0)
         {
-            // There was no tail, so no head either.
-            timers->head = t;
+            slot = _nextUsedSlot(timers, level, 0);
+            if (slot < 0)
+                continue;
+            base += WHEEL_MASK(level + 1) + 1;
         }
-        // This is the new tail.
-        timers->tail = t;
-        // We are done
-        return;
+        t = base + ((int64_t) slot << shift);
+        if ((next < 0) || (t < next))
+            next = t;
     }
+    return next;
+}
+
+// Moves the timers of the current slot of the given level to lower levels.
+// Timers lock must be held.
+static void
+_cascadeTimers(natsLibTimers *timers, int level)
+{
+    int         slot    = (int) ((timers->now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+    natsTimer   *t      = timers->wheel[level][slot];
+    natsTimer   *next;
+
+    timers->wheel[level][slot] = NULL;
+    timers->used[level][slot / 64] &= ~((uint64_t) 1 << (slot % 64));
 
-    // Find the spot. Start at the beginning.
-    cur = timers->head;
-    while ((cur != NULL) && (cur->absoluteTime <= t->absoluteTime))
+    for (; t != NULL; t = next)
     {
-        prev = cur;
-        cur  = cur->next;
+        next = t->next;
+        _insertTimer(timers, t);
     }
+}
+
+// Processes the wheel up to `now`, stopping at the first slot of level 0 that
+// contains timers, which are moved to the `firing` list. Returns the time at
+// which the wheel needs to be processed next, or -1 if there is no timer.
+// Timers lock must be held.
+static int64_t
+_advanceWheel(natsLibTimers *timers, int64_t now)
+{
+    int64_t     next;
+    int         level;
+    int         slot;
+    natsTimer   *t;
 
-    if (cur != NULL)
+    while (((next = _nextWheelTime(timers)) >= 0) && (next <= now))
     {
-        t->prev = prev;
-        t->next = cur;
-        cur->prev = t;
+        timers->now = next;
+        for (level = WHEEL_LEVELS - 1; level > 0; level--)
+        {
+            if ((next & WHEEL_MASK(level)) == 0)
+                _cascadeTimers(timers, level);
+        }
+        timers->now = next + 1;
 
-        if (prev != NULL)
-            prev->next = t;
+        slot = (int) (next & (WHEEL_SLOTS - 1));
+        if ((t = timers->wheel[0][slot]) != NULL)
+        {
+            timers->firing      = t;
+            timers->wheel[0][slot] = NULL;
+            timers->used[0][slot / 64] &= ~((uint64_t) 1 << (slot % 64));
+            for (; t != NULL; t = t->next)
+                t->wheelLevel = -1;
+
+            return next;
+        }
     }
-    else if (prev != NULL)
+    // Nothing is due until `next`, so the wheel can be moved to `now`.
+    if (now > timers->now)
+        timers->now = now;
+
+    return next;
+}
+
+// Returns the first timer of the `firing` list or of the wheel, or NULL if
+// there is none. Timers lock must be held.
+static natsTimer*
+_firstTimer(natsLibTimers *timers)
+{
+    int level;
+    int slot;
+
+    if (timers->firing != NULL)
+        return timers->firing;
+
+    for (level = 0; level < WHEEL_LEVELS; level++)
     {
-        prev->next = t;
-        t->prev = prev;
-        t->next = NULL;
+        if ((slot = _nextUsedSlot(timers, level, 0)) >= 0)
+            return timers->wheel[level][slot];
     }
-
-    if (prev == NULL)
-        timers->head = t;
-    if (t->next == NULL)
-        timers->tail = t;
+    return NULL;
 }
 
 // Locks must be held before entering this function
 static inline void
-_removeTimer(natsLib *lib, natsTimer *t)
+_removeTimer(natsLibTimers *timers, natsTimer *t)
 {
     // Switch flag
     t->stopped = true;
 
     // It the timer was in the callback, it has already been removed from the
-    // list, so skip that.
+    // wheel, so skip that.
     if (!(t->inCallback))
-    {
-        if (t->prev != NULL)
-            t->prev->next = t->next;
-        if (t->next != NULL)
-            t->next->prev = t->prev;
-        else
-        {
-            // The timer had no "next", so it was the tail. Move back the tail.
-            lib->timers.tail = t->prev;
-        }
-        // If we removed the first, move the head.
-        if (t == lib->timers.head)
-            lib->timers.head = t->next;
-
-        t->prev = NULL;
-        t->next = NULL;
-    }
+        _unlinkTimer(timers, t);
 
-    // Decrease the global count of timers
-    lib->timers.count--;
+    // Decrease the shard's count of timers
+    timers->count--;
 }
 
 void
 nats_resetTimer(natsTimer *t, int64_t newInterval)
 {
-    natsLib       *lib    = nats_lib();
-    natsLibTimers *timers = &(lib->timers);
+    natsLibTimers *timers;
+
+    // The shard is selected the first time the timer is set and never
+    // changes after that.
+    if (t->shard == NULL)
+        t->shard = _timerShard(nats_lib(), t);
+    timers = t->shard;
 
     natsMutex_Lock(timers->lock);
     natsMutex_Lock(t->mu);
@@ -123,7 +359,7 @@ nats_resetTimer(natsTimer *t, int64_t newInterval)
     // If timer is active, we need first to remove it. This call does the
     // right thing if the timer is in the callback.
     if (!(t->stopped))
-        _removeTimer(lib, t);
+        _removeTimer(timers, t);
 
     // Bump the timer's global count (it as decreased in the _removeTimers call
     timers->count++;
@@ -140,7 +376,7 @@ nats_resetTimer(natsTimer *t, int64_t newInterval)
     if (!(t->inCallback))
     {
         t->absoluteTime = nats_setTargetTime(t->interval);
-        _insertTimer(t);
+        _insertTimer(timers, t);
     }
 
     natsMutex_Unlock(t->mu);
@@ -156,8 +392,7 @@ nats_resetTimer(natsTimer *t, int64_t newInterval)
 void
 nats_stopTimer(natsTimer *t)
 {
-    natsLib         *lib    = nats_lib();
-    natsLibTimers   *timers = &(lib->timers);
+    natsLibTimers   *timers = t->shard;
     bool            doCb    = false;
 
     natsMutex_Lock(timers->lock);
@@ -172,7 +407,7 @@ nats_stopTimer(natsTimer *t)
         return;
     }
 
-    _removeTimer(lib, t);
+    _removeTimer(timers, t);
 
     doCb = (!(t->inCallback) && (t->stopCb != NULL));
 
@@ -192,14 +427,19 @@ nats_stopTimer(natsTimer *t)
 int
 nats_getTimersCount(void)
 {
-    natsLib     *lib  = nats_lib();
-    int         count = 0;
+    natsLib         *lib  = nats_lib();
+    natsLibTimers   *timers;
+    int             count = 0;
+    int             i;
 
-    natsMutex_Lock(lib->timers.lock);
-
-    count = lib->timers.count;
+    for (i=0; i<lib->numTimerShards; i++)
+    {
+        timers = &(lib->timerShards[i]);
 
-    natsMutex_Unlock(lib->timers.lock);
+        natsMutex_Lock(timers->lock);
+        count += timers->count;
+        natsMutex_Unlock(timers->lock);
+    }
 
     return count;
 }
@@ -207,28 +447,42 @@ nats_getTimersCount(void)
 int
 nats_getTimersCountInList(void)
 {
-    natsLib     *lib  = nats_lib();
-    int         count = 0;
-    natsTimer   *t;
+    natsLib         *lib  = nats_lib();
+    natsLibTimers   *timers;
+    int             count = 0;
+    natsTimer       *t;
+    int             level;
+    int             slot;
+    int             i;
+
+    for (i=0; i<lib->numTimerShards; i++)
+    {
+        timers = &(lib->timerShards[i]);
 
-    natsMutex_Lock(lib->timers.lock);
+        natsMutex_Lock(timers->lock);
 
-    t = lib->timers.head;
-    while (t != NULL)
-    {
-        count++;
-        t = t->next;
-    }
+        for (t = timers->firing; t != NULL; t = t->next)
+            count++;
 
-    natsMutex_Unlock(lib->timers.lock);
+        for (level = 0; level < WHEEL_LEVELS; level++)
+        {
+            for (slot = 0; slot < WHEEL_SLOTS; slot++)
+            {
+                for (t = timers->wheel[level][slot]; t != NULL; t = t->next)
+                    count++;
+            }
+        }
+
+        natsMutex_Unlock(timers->lock);
+    }
 
     return count;
 }
 
 void nats_timerThreadf(void *arg)
 {
-    natsLib         *lib    = (natsLib *)arg;
-    natsLibTimers   *timers = &lib->timers;
+    natsLib         *lib    = nats_lib();
+    natsLibTimers   *timers = (natsLibTimers *)arg;
     natsTimer       *t      = NULL;
     natsStatus      s       = NATS_OK;
     bool            doStopCb;
@@ -240,48 +494,37 @@ void nats_timerThreadf(void *arg)
 
     while (!(timers->shutdown))
     {
-        // Take the first timer that needs to fire.
-        t = timers->head;
+        // Take the next timer that needs to fire, if any.
+        if ((t = timers->firing) == NULL)
+        {
+            target = _advanceWheel(timers, nats_Now());
+            t = timers->firing;
+        }
 
         if (t == NULL)
         {
             // No timer, fire in an hour...
-            target = nats_setTargetTime(3600 * 1000);
-        }
-        else
-        {
-            target = t->absoluteTime;
-        }
-
-        timers->changed = false;
+            if (target < 0)
+                target = nats_setTargetTime(3600 * 1000);
 
-        s = NATS_OK;
+            timers->changed = false;
 
-        while (!(timers->shutdown)
-               && (s != NATS_TIMEOUT)
-               && !(timers->changed))
-        {
-            s = natsCondition_AbsoluteTimedWait(timers->cond, timers->lock,
-                                                target);
-        }
+            s = NATS_OK;
 
-        if (timers->shutdown)
-            break;
-
-        if ((t == NULL) || timers->changed)
+            while (!(timers->shutdown)
+                   && (s != NATS_TIMEOUT)
+                   && !(timers->changed))
+            {
+                s = natsCondition_AbsoluteTimedWait(timers->cond, timers->lock,
+                                                    target);
+            }
             continue;
+        }
 
         natsMutex_Lock(t->mu);
 
         // Remove timer from the list:
-        timers->head = t->next;
-        if (t->next != NULL)
-            t->next->prev = NULL;
-        else
-            timers->tail = NULL;
-
-        t->prev = NULL;
-        t->next = NULL;
+        _unlinkTimer(timers, t);
 
         t->inCallback = true;
 
@@ -304,15 +547,15 @@ void nats_timerThreadf(void *arg)
         // the window the locks were released.
         doStopCb = (t->stopped && (t->stopCb != NULL));
 
-        // If not stopped, we need to put it back in our list
-        if (!doStopCb)
+        // If not stopped, we need to put it back in the wheel
+        if (!(t->stopped))
         {
             // Reset our view of what is the time this timer should fire
             // because:
             // 1- the callback may have taken longer than it should
             // 2- the user may have called Reset() with a new interval
             t->absoluteTime = nats_setTargetTime(t->interval);
-            _insertTimer(t);
+            _insertTimer(timers, t);
         }
 
         natsMutex_Unlock(t->mu);
@@ -328,9 +571,9 @@ void nats_timerThreadf(void *arg)
         natsMutex_Lock(timers->lock);
     }
 
-    // Process the timers that were left in the list (not stopped) when the
+    // Process the timers that were left in the wheel (not stopped) when the
     // library is shutdown.
-    while ((t = timers->head) != NULL)
+    while ((t = _firstTimer(timers)) != NULL)
     {
         natsMutex_Lock(t->mu);
 
@@ -342,7 +585,7 @@ void nats_timerThreadf(void *arg)
         doStopCb = (t->stopCb != NULL);
 
         // Remove the timer from the list.
-        _removeTimer(lib, t);
+        _removeTimer(timers, t);
 
         natsMutex_Unlock(t->mu);
         natsMutex_Unlock(timers->lock);
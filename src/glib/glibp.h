@@ -41,13 +41,24 @@ typedef struct natsTLError
 
 } natsTLError;
 
+// Timers are kept in a hierarchical timing wheel. Each slot of level 0 covers
+// one millisecond, each slot of level N covers all the slots of level N-1.
+#define NATS_TIMER_WHEEL_BITS   (8)
+#define NATS_TIMER_WHEEL_SLOTS  (1 << NATS_TIMER_WHEEL_BITS)
+#define NATS_TIMER_WHEEL_LEVELS (4)
+
 typedef struct __natsLibTimers
 {
     natsMutex *lock;
     natsCondition *cond;
     natsThread *thread;
-    natsTimer *head;
-    natsTimer *tail;
+    // Unsorted list of timers for each slot, and bitmap of non empty slots.
+    natsTimer *wheel[NATS_TIMER_WHEEL_LEVELS][NATS_TIMER_WHEEL_SLOTS];
+    uint64_t used[NATS_TIMER_WHEEL_LEVELS][NATS_TIMER_WHEEL_SLOTS / 64];
+    // Timers removed from the wheel, whose callbacks are about to be invoked.
+    natsTimer *firing;
+    // Time (in ms) of the first tick of the wheel not yet processed.
+    int64_t now;
     int count;
     bool changed;
     bool shutdown;
@@ -76,6 +87,12 @@ typedef struct __natsGCList
 
 } natsGCList;
 
+// Opaque, see glib_iouring.c
+typedef struct __natsIOUring natsIOUring;
+
+// Opaque, see glib_iopool.c
+typedef struct __natsIOPoolThread natsIOPoolThread;
+
 struct __natsDispatcherPool
 {
     natsMutex *lock;
@@ -108,9 +125,25 @@ typedef struct __natsLib
     natsDispatcherPool messageDispatchers;
     natsDispatcherPool replyDispatchers;
 
-    natsLibTimers timers;
+    // Timers are sharded, each shard has its own lock and thread.
+    natsLibTimers *timerShards;
+    int numTimerShards;
     natsLibAsyncCbs asyncCbs;
 
+    // I/O threads (each with its own io_uring) that connections not attached
+    // to an user event loop are spread between. Empty if not configured or
+    // if io_uring is not available.
+    natsIOUring **ioUrings;
+    int numIOUrings;
+    int nextIOUring;
+
+    // epoll based I/O pool, used by connections not attached to an user
+    // event loop nor to an io_uring thread. Empty if not configured or not
+    // available.
+    natsIOPoolThread **ioPool;
+    int ioPoolSize;
+    int nextIOPoolThread;
+
     natsCondition *cond;
 
     natsGCList gc;
@@ -119,8 +152,23 @@ typedef struct __natsLib
 
 natsLib *nats_lib(void);
 
+natsStatus nats_initTimers(natsLib *lib, int numShards);
+void nats_shutdownTimers(natsLib *lib, bool lock);
+void nats_joinTimers(natsLib *lib);
 void nats_freeTimers(natsLib *lib);
-void nats_timerThreadf(void *arg); // arg is &gLib
+void nats_timerThreadf(void *arg); // arg is the timers shard
+
+natsStatus nats_initIOUrings(natsLib *lib, int count);
+void nats_shutdownIOUrings(natsLib *lib);
+void nats_joinIOUrings(natsLib *lib);
+void nats_freeIOUrings(natsLib *lib);
+void nats_ioUringThreadf(void *arg); // arg is the io_uring
+
+natsStatus nats_initIOPool(natsLib *lib, int size);
+void nats_shutdownIOPool(natsLib *lib);
+void nats_joinIOPool(natsLib *lib);
+void nats_freeIOPool(natsLib *lib);
+void nats_ioPoolThreadf(void *arg); // arg is the I/O pool thread
 
 void nats_freeAsyncCbs(natsLib *lib);
 void nats_asyncCbsThreadf(void *arg); // arg is &gLib
@@ -11,6 +11,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+// Allocations made in this file are accounted as hash allocations.
+#define NATS_MEM_CATEGORY   natsAlloc_Hashes
+
 #include "natsp.h"
 
 #include <string.h>
@@ -19,8 +22,6 @@
 #include "mem.h"
 #include "hash.h"
 
-#define _freeEntry(e)   { NATS_FREE(e); (e) = NULL; }
-
 #define _OFF32  (2166136261)
 #define _YP32   (709607)
 
@@ -59,7 +60,7 @@ natsHash_Create(natsHash **newHash, int initialSize)
     hash->mask      = (initialSize - 1);
     hash->numBkts   = initialSize;
     hash->canResize = true;
-    hash->bkts      = (natsHashEntry**) NATS_CALLOC(initialSize, sizeof(natsHashEntry*));
+    hash->bkts      = (natsHashEntry*) NATS_CALLOC(initialSize, sizeof(natsHashEntry));
     if (hash->bkts == NULL)
     {
         NATS_FREE(hash);
@@ -71,39 +72,69 @@ natsHash_Create(natsHash **newHash, int initialSize)
     return NATS_OK;
 }
 
+// Places an entry whose key is known not to be in the table. Entries that
+// are closer to their home slot than the one being placed are displaced
+// further down (Robin Hood), which keeps probe sequences short.
+static void
+_placeEntry(natsHashEntry *bkts, int mask, int64_t key, void *data)
+{
+    natsHashEntry   ne;
+    natsHashEntry   tmp;
+    natsHashEntry   *e;
+    int             index = (int) (key & mask);
+
+    ne.key  = key;
+    ne.data = data;
+    ne.dist = 1;
+
+    for (;;)
+    {
+        e = &(bkts[index]);
+        if (e->dist == 0)
+        {
+            *e = ne;
+            return;
+        }
+        if (e->dist < ne.dist)
+        {
+            tmp = *e;
+            *e  = ne;
+            ne  = tmp;
+        }
+        index = (index + 1) & mask;
+        ne.dist++;
+    }
+}
+
 static natsStatus
 _resize(natsHash *hash, int newSize)
 {
-    natsHashEntry   **bkts    = NULL;
-    int             newMask   = newSize - 1;
-    natsHashEntry   *ne;
+    natsHashEntry   *bkts    = NULL;
+    natsHashEntry   *oldBkts = hash->bkts;
+    int             newMask  = newSize - 1;
     natsHashEntry   *e;
     int             k;
-    int             newIndex;
 
-    bkts = (natsHashEntry**) NATS_CALLOC(newSize, sizeof(natsHashEntry*));
+    bkts = (natsHashEntry*) NATS_CALLOC(newSize, sizeof(natsHashEntry));
     if (bkts == NULL)
         return nats_setDefaultError(NATS_NO_MEMORY);
 
     for (k = 0; k < hash->numBkts; k++)
     {
-        e = hash->bkts[k];
-        while (e != NULL)
-        {
-            ne = e;
-            e  = e->next;
-
-            newIndex = ne->key & newMask;
-            ne->next = bkts[newIndex];
-            bkts[newIndex] = ne;
-        }
+        e = &(hash->bkts[k]);
+        if (e->dist != 0)
+            _placeEntry(bkts, newMask, e->key, e->data);
     }
 
-    NATS_FREE(hash->bkts);
     hash->bkts = bkts;
     hash->mask = newMask;
     hash->numBkts = newSize;
 
+    if (hash->resizeCb != NULL)
+        (*hash->resizeCb)(hash->resizeCbClosure);
+
+    NATS_FREE(oldBkts);
+
     return NATS_OK;
 }
 
@@ -128,59 +159,62 @@ _shrink(natsHash *hash)
     (void) _resize(hash, hash->numBkts / 2);
 }
 
-static natsHashEntry*
-_createEntry(int64_t key, void *data)
+// Returns the slot index of the given key, or -1 if not found.
+static int
+_findSlot(natsHash *hash, int64_t key)
 {
-    natsHashEntry *e = (natsHashEntry*) NATS_MALLOC(sizeof(natsHashEntry));
-
-    if (e == NULL)
-        return NULL;
+    int             index = (int) (key & hash->mask);
+    int32_t         dist  = 1;
+    natsHashEntry   *e;
 
-    e->key  = key;
-    e->data = data;
-    e->next = NULL;
+    for (;;)
+    {
+        e = &(hash->bkts[index]);
+        // An empty slot, or an entry closer to its home than we are from
+        // ours, means that the key can't be further down.
+        if (e->dist < dist)
+            return -1;
+        if (e->key == key)
+            return index;
 
-    return e;
+        index = (index + 1) & hash->mask;
+        dist++;
+    }
 }
 
 natsStatus
 natsHash_Set(natsHash *hash, int64_t key, void *data, void **oldData)
 {
-    natsStatus      s         = NATS_OK;
-    int             index     = (int) (key & hash->mask);
-    natsHashEntry   *newEntry = NULL;
-    natsHashEntry   *e;
+    natsStatus  s     = NATS_OK;
+    int         index = -1;
 
     if (oldData != NULL)
         *oldData = NULL;
 
-    e = (natsHashEntry*) hash->bkts[index];
-    while (e != NULL)
+    index = _findSlot(hash, key);
+    if (index >= 0)
     {
-        if (e->key == key)
-        {
-            // Success, replace data field
-            if (oldData != NULL)
-                *oldData = e->data;
-            e->data  = data;
-            return NATS_OK;
-        }
-
-        e = e->next;
+        // Success, replace data field
+        if (oldData != NULL)
+            *oldData = hash->bkts[index].data;
+        hash->bkts[index].data = data;
+        return NATS_OK;
     }
 
-    // We have a new entry here
-    newEntry = _createEntry(key, data);
-    if (newEntry == NULL)
-        return nats_setDefaultError(NATS_NO_MEMORY);
-
-    newEntry->next = hash->bkts[index];
-    hash->bkts[index] = newEntry;
-    hash->used++;
-
-    // Check for resizing
-    if (hash->canResize && (hash->used > hash->numBkts))
-        s = _grow(hash);
+    // We have a new entry here. Keep the load factor under 7/8, and in
+    // any case at least one empty slot so that probing terminates.
+    if (((int64_t) hash->used + 1) * 8 > (int64_t) hash->numBkts * 7)
+    {
+        if (hash->canResize)
+            s = _grow(hash);
+        else if (hash->used + 1 >= hash->numBkts)
+            s = nats_setDefaultError(NATS_INSUFFICIENT_BUFFER);
+    }
+    if (s == NATS_OK)
+    {
+        _placeEntry(hash->bkts, hash->mask, key, data);
+        hash->used++;
+    }
 
     return NATS_UPDATE_ERR_STACK(s);
 }
@@ -188,20 +222,38 @@ natsHash_Set(natsHash *hash, int64_t key, void *data, void **oldData)
 void*
 natsHash_Get(natsHash *hash, int64_t key)
 {
-    natsHashEntry *e;
+    int index = _findSlot(hash, key);
 
-    e = hash->bkts[key & hash->mask];
-    while (e != NULL)
+    return (index >= 0 ? hash->bkts[index].data : NULL);
+}
+
+void*
+natsHash_GetConcurrent(natsHashEntry *bkts, int mask, int64_t key)
+{
+    int             index = (int) (key & mask);
+    int32_t         dist;
+    natsHashEntry   *e;
+
+    for (dist = 1; dist <= mask + 1; dist++)
     {
+        e = &(bkts[index]);
+        if (e->dist < dist)
+            return NULL;
         if (e->key == key)
             return e->data;
 
-        e = e->next;
+        index = (index + 1) & mask;
     }
-
     return NULL;
 }
 
+void
+natsHash_SetResizeCb(natsHash *hash, natsHashResizeCb cb, void *closure)
+{
+    hash->resizeCb        = cb;
+    hash->resizeCbClosure = closure;
+}
+
 static void
 _maybeShrink(natsHash *hash)
 {
@@ -213,37 +265,41 @@ _maybeShrink(natsHash *hash)
     }
 }
 
-void*
-natsHash_Remove(natsHash *hash, int64_t key)
+// Removes the entry at the given slot and shifts the entries that follow
+// it back by one slot, until reaching an empty slot or an entry that is
+// at its home slot. This avoids the need for tombstones.
+static void*
+_removeAt(natsHash *hash, int index)
 {
-    natsHashEntry *entryRemoved = NULL;
-    void          *dataRemoved  = NULL;
-    natsHashEntry **e;
+    void    *dataRemoved = hash->bkts[index].data;
+    int     next         = (index + 1) & hash->mask;
 
-    e = (natsHashEntry**) &(hash->bkts[key & hash->mask]);
-    while (*e != NULL)
+    while (hash->bkts[next].dist > 1)
     {
-        if ((*e)->key == key)
-        {
-            // Success
-            entryRemoved = *e;
-            dataRemoved  = entryRemoved->data;
+        hash->bkts[index] = hash->bkts[next];
+        hash->bkts[index].dist--;
+        index = next;
+        next  = (next + 1) & hash->mask;
+    }
+    memset(&(hash->bkts[index]), 0, sizeof(natsHashEntry));
 
-            *e = entryRemoved->next;
-            _freeEntry(entryRemoved);
+    hash->used--;
 
-            hash->used--;
+    // Check for resizing
+    _maybeShrink(hash);
 
-            // Check for resizing
-            _maybeShrink(hash);
+    return dataRemoved;
+}
 
-            break;
-        }
+void*
+natsHash_Remove(natsHash *hash, int64_t key)
+{
+    int index = _findSlot(hash, key);
 
-        e = (natsHashEntry**) &((*e)->next);
-    }
+    if (index < 0)
+        return NULL;
 
-    return dataRemoved;
+    return _removeAt(hash, index);
 }
 
 natsStatus
@@ -257,21 +313,15 @@ natsHash_RemoveSingle(natsHash *hash, int64_t *key, void **data)
 
     for (i=0; i<hash->numBkts; i++)
     {
-        e = hash->bkts[i];
-        if (e != NULL)
+        e = &(hash->bkts[i]);
+        if (e->dist != 0)
         {
             if (key != NULL)
                 *key = e->key;
             if (data != NULL)
                 *data = e->data;
-            _freeEntry(e);
-
-            hash->used--;
-            hash->bkts[i] = NULL;
-
-            // Check for resizing
-            _maybeShrink(hash);
 
+            (void) _removeAt(hash, i);
             break;
         }
     }
@@ -281,25 +331,9 @@ natsHash_RemoveSingle(natsHash *hash, int64_t *key, void **data)
 void
 natsHash_Destroy(natsHash *hash)
 {
-    natsHashEntry   *e, *ne;
-    int             i;
-
     if (hash == NULL)
         return;
 
-    for (i = 0; i < hash->numBkts; i++)
-    {
-        e = hash->bkts[i];
-        while (e != NULL)
-        {
-            ne = e->next;
-
-            _freeEntry(e);
-
-            e = ne;
-        }
-    }
-
     NATS_FREE(hash->bkts);
     NATS_FREE(hash);
 }
@@ -307,69 +341,67 @@ natsHash_Destroy(natsHash *hash)
 void
 natsHashIter_Init(natsHashIter *iter, natsHash *hash)
 {
+    int i;
+
     memset(iter, 0, sizeof(natsHashIter));
 
     hash->canResize = false;
     iter->hash      = hash;
-    iter->current   = hash->bkts[0];
-    iter->next      = iter->current;
+    iter->current   = -1;
+
+    // Start right after an empty slot (there is always one). Removals only
+    // shift entries back toward their home slot, and never past an empty
+    // slot, so entries that were not visited yet can't be moved before
+    // the iterator's position.
+    for (i = 0; i < hash->numBkts; i++)
+    {
+        if (hash->bkts[i].dist == 0)
+            break;
+    }
+    iter->start = i;
+    iter->pos   = 1;
 }
 
 bool
 natsHashIter_Next(natsHashIter *iter, int64_t *key, void **value)
 {
-    if ((iter->started) && (iter->next == NULL))
-        return false;
+    natsHash        *hash = iter->hash;
+    natsHashEntry   *e;
+    int             index;
 
-    if (!(iter->started) && (iter->current == NULL))
+    iter->current = -1;
+
+    for (; iter->pos < hash->numBkts; iter->pos++)
     {
-        while ((iter->next == NULL)
-               && (iter->currBkt < (iter->hash->numBkts - 1)))
+        index = (iter->start + iter->pos) & hash->mask;
+        e     = &(hash->bkts[index]);
+        if (e->dist != 0)
         {
-            iter->next = iter->hash->bkts[++(iter->currBkt)];
-        }
+            if (key != NULL)
+                *key = e->key;
+            if (value != NULL)
+                *value = e->data;
 
-        if (iter->next == NULL)
-        {
-            iter->started = true;
-            return false;
+            iter->current = index;
+            iter->pos++;
+            return true;
         }
     }
 
-    iter->started = true;
-
-    iter->current = iter->next;
-    if (iter->current != NULL)
-    {
-        if (key != NULL)
-            *key = iter->current->key;
-        if (value != NULL)
-            *value = iter->current->data;
-
-        iter->next = iter->current->next;
-    }
-
-    while ((iter->next == NULL)
-           && (iter->currBkt < (iter->hash->numBkts - 1)))
-    {
-        iter->next = iter->hash->bkts[++(iter->currBkt)];
-    }
-
-    return true;
+    return false;
 }
 
 natsStatus
 natsHashIter_RemoveCurrent(natsHashIter *iter)
 {
-    int64_t key;
-
-    if (iter->current == NULL)
+    if (iter->current < 0)
         return nats_setDefaultError(NATS_NOT_FOUND);
 
-    key = iter->current->key;
-    iter->current = iter->next;
+    (void) _removeAt(iter->hash, iter->current);
 
-    (void) natsHash_Remove(iter->hash, key);
+    // The next entry, if any, may have been shifted into the current slot.
+    iter->current = -1;
+    iter->pos--;
 
     return NATS_OK;
 }
@@ -380,7 +412,6 @@ natsHashIter_Done(natsHashIter *iter)
     iter->hash->canResize = true;
 }
 
-
 // Jesteress derivative of FNV1A from [http://www.sanmayce.com/Fastest_Hash/]
 uint32_t
 natsStrHash_Hash(const char *data, int dataLen)
@@ -15,33 +15,39 @@
 #ifndef HASH_H_
 #define HASH_H_
 
-struct __natsHashEntry;
-
+// Entries are stored inline in an open-addressing table, using Robin Hood
+// hashing with linear probing.
 typedef struct __natsHashEntry
 {
     int64_t                 key;
     void                    *data;
-    struct __natsHashEntry  *next;
+    // Distance from the entry's home slot plus one, 0 for an empty slot.
+    int32_t                 dist;
 
 } natsHashEntry;
 
+// Invoked by a resize after the new array of entries has been installed
+// and before the old one is freed.
+typedef void (*natsHashResizeCb)(void *closure);
+
 typedef struct __natsHash
 {
-    natsHashEntry   **bkts;
+    natsHashEntry   *bkts;
     int             numBkts;
     int             mask;
     int             used;
     bool            canResize;
+    natsHashResizeCb resizeCb;
+    void            *resizeCbClosure;
 
 } natsHash;
 
 typedef struct __natsHashIter
 {
     natsHash        *hash;
-    natsHashEntry   *current;
-    natsHashEntry   *next;
-    int             currBkt;
-    bool            started;
+    int             start;
+    int             pos;
+    int             current;
 
 } natsHashIter;
 
@@ -90,6 +96,15 @@ natsHash_Set(natsHash *hash, int64_t key, void *data, void **oldData);
 void*
 natsHash_Get(natsHash *hash, int64_t key);
 
+// Lookup in the given array of entries, which may be modified concurrently
+// by another thread. The result is then meaningless and has to be validated
+// by the caller, but the probe never goes beyond the `mask + 1` entries.
+void*
+natsHash_GetConcurrent(natsHashEntry *bkts, int mask, int64_t key);
+
+void
+natsHash_SetResizeCb(natsHash *hash, natsHashResizeCb cb, void *closure);
+
 void*
 natsHash_Remove(natsHash *hash, int64_t key);
 
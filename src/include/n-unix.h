@@ -38,6 +38,8 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <poll.h>
+#include <limits.h>
+#include <sys/uio.h>
 
 typedef pthread_t       natsThread;
 typedef pthread_key_t   natsThreadLocal;
@@ -57,13 +59,39 @@ typedef size_t          natsRecvLen;
 #define NATS_SOCK_ERROR                 (-1)
 #define NATS_SOCK_GET_ERROR             (errno)
 
+typedef struct iovec    natsIOVec;
+
+#define natsIOVec_Base(v)               ((v)->iov_base)
+#define natsIOVec_Len(v)                ((v)->iov_len)
+
+#ifdef IOV_MAX
+#define NATS_IOV_MAX                    (IOV_MAX)
+#else
+#define NATS_IOV_MAX                    (1024)
+#endif
+
 #define __NATS_FUNCTION__ __func__
 
-#define nats_asprintf       asprintf
 #define nats_strcasestr     strcasestr
 #define nats_vsnprintf      vsnprintf
 #define nats_strtok         strtok_r
 
 #define nats_vscprintf(f, a) vsnprintf(NULL, 0, (f), (a))
 
+#define nats_atomicAdd64(p, v)  __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+#define nats_atomicLoad64(p)    __atomic_load_n((p), __ATOMIC_RELAXED)
+
+// Sequentially consistent operations on pointers and ints.
+#define nats_atomicExchangePtr(p, v)    __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define nats_atomicLoadPtr(p)           __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define nats_atomicStorePtr(p, v)       __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define nats_atomicCasPtr(p, o, n)      __sync_bool_compare_and_swap((p), (o), (n))
+#define nats_atomicLoadInt(p)           __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define nats_atomicStoreInt(p, v)       __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define nats_atomicAddInt(p, v)         __atomic_add_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define nats_atomicFence()              __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+int
+nats_asprintf(char **newStr, const char *fmt, ...);
+
 #endif /* N_UNIX_H_ */
@@ -52,6 +52,12 @@ typedef int                 natsRecvLen;
 #define NATS_SOCK_ERROR                 (SOCKET_ERROR)
 #define NATS_SOCK_GET_ERROR             WSAGetLastError()
 
+typedef WSABUF              natsIOVec;
+
+#define natsIOVec_Base(v)               ((v)->buf)
+#define natsIOVec_Len(v)                ((v)->len)
+#define NATS_IOV_MAX                    (1024)
+
 #define __NATS_FUNCTION__ __FUNCTION__
 
 // Windows doesn't have those..
@@ -66,6 +72,19 @@ typedef int                 natsRecvLen;
 
 #define nats_vscprintf _vscprintf
 
+#define nats_atomicAdd64(p, v)  InterlockedExchangeAdd64((volatile LONG64*) (p), (LONG64) (v))
+#define nats_atomicLoad64(p)    ((uint64_t) InterlockedCompareExchange64((volatile LONG64*) (p), 0, 0))
+
+// Sequentially consistent operations on pointers and ints.
+#define nats_atomicExchangePtr(p, v)    InterlockedExchangePointer((PVOID volatile*) (p), (PVOID) (v))
+#define nats_atomicLoadPtr(p)           InterlockedCompareExchangePointer((PVOID volatile*) (p), NULL, NULL)
+#define nats_atomicStorePtr(p, v)       ((void) InterlockedExchangePointer((PVOID volatile*) (p), (PVOID) (v)))
+#define nats_atomicCasPtr(p, o, n)      (InterlockedCompareExchangePointer((PVOID volatile*) (p), (PVOID) (n), (PVOID) (o)) == (PVOID) (o))
+#define nats_atomicLoadInt(p)           ((int) InterlockedCompareExchange((volatile LONG*) (p), 0, 0))
+#define nats_atomicStoreInt(p, v)       ((void) InterlockedExchange((volatile LONG*) (p), (LONG) (v)))
+#define nats_atomicAddInt(p, v)         ((int) (InterlockedExchangeAdd((volatile LONG*) (p), (LONG) (v)) + (v)))
+#define nats_atomicFence()              MemoryBarrier()
+
 int
 nats_asprintf(char **newStr, const char *fmt, ...);
 
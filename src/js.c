@@ -45,6 +45,19 @@ const int64_t    jsOrderedHBInterval     = NATS_SECONDS_TO_NANOS(5);
 
 #define jsDefaultMaxMsgs    (512 * 1024)
 
+// Initial, minimum and maximum (if MaxPending is not set) number of async
+// publishes in flight when AdaptiveMaxPending is set.
+#define JS_ADAPTIVE_INIT_PENDING    (32)
+#define JS_ADAPTIVE_MIN_PENDING     (1)
+#define JS_ADAPTIVE_MAX_PENDING     (65536)
+// Increase of the ack round trip time (in nanoseconds) under which a delay
+// is considered jitter rather than congestion.
+#define JS_ADAPTIVE_MIN_DELAY       (1000000)
+// Period (in nanoseconds) after which the lowest ack round trip time is
+// replaced by the lowest one measured during that period, so that it follows
+// a lasting increase of the base round trip time (route or leader change).
+#define JS_ADAPTIVE_MIN_RTT_PERIOD  NATS_SECONDS_TO_NANOS(10)
+
 #define jsLastConsumerSeqHdr    "Nats-Last-Consumer"
 
 // Forward declarations
@@ -98,6 +111,296 @@ _destroyAsyncReplies(jsAsyncReplies *ar)
     // so don't free `ar`.
 }
 
+// Initial size of the table of pending async published messages. Must be
+// a power of 2.
+#define JS_PENDING_TABLE_INIT_SIZE  (1024)
+
+// Returns the pending entry for the given reply sequence, or NULL if there
+// is none.
+// Lock held on entry.
+static jsPendingPub*
+_getPending(jsCtx *js, uint64_t seq)
+{
+    jsPendingPub *p;
+
+    if (seq < js->pmBase)
+    {
+        if (js->pmOld == NULL)
+            return NULL;
+        return (jsPendingPub*) natsHash_Get(js->pmOld, (int64_t) seq);
+    }
+    if ((seq - js->pmBase) >= (uint64_t) js->pmSize)
+        return NULL;
+
+    p = &(js->pmTable[seq & (uint64_t) (js->pmSize-1)]);
+    return (p->msg != NULL ? p : NULL);
+}
+
+// Inserts the entry in the deadline ordered list.
+// Lock held on entry.
+static void
+_linkPendingDeadline(jsCtx *js, uint64_t seq, jsPendingPub *p)
+{
+    jsPendingPub    *o      = NULL;
+    uint64_t        after   = js->pmdTail;
+
+    // Deadlines are usually increasing, so search from the tail.
+    while (after != 0)
+    {
+        o = _getPending(js, after-1);
+        if (o->deadline <= p->deadline)
+            break;
+        after = o->prev;
+    }
+    p->prev = after;
+    if (after == 0)
+    {
+        p->next = js->pmdHead;
+        js->pmdHead = seq+1;
+    }
+    else
+    {
+        p->next = o->next;
+        o->next = seq+1;
+    }
+    if (p->next == 0)
+        js->pmdTail = seq+1;
+    else
+        _getPending(js, p->next-1)->prev = seq+1;
+}
+
+// Removes the entry, if it has a deadline, from the deadline ordered list.
+// Lock held on entry.
+static void
+_unlinkPendingDeadline(jsCtx *js, jsPendingPub *p)
+{
+    if (p->deadline == 0)
+        return;
+
+    if (p->prev == 0)
+        js->pmdHead = p->next;
+    else
+        _getPending(js, p->prev-1)->next = p->next;
+
+    if (p->next == 0)
+        js->pmdTail = p->prev;
+    else
+        _getPending(js, p->next-1)->prev = p->prev;
+
+    p->prev     = 0;
+    p->next     = 0;
+    p->deadline = 0;
+}
+
+// Doubles the size of the pending table.
+// Lock held on entry.
+static natsStatus
+_growPendingTable(jsCtx *js)
+{
+    jsPendingPub    *table  = NULL;
+    int             size    = (js->pmSize == 0 ? JS_PENDING_TABLE_INIT_SIZE : js->pmSize*2);
+    uint64_t        seq;
+
+    table = (jsPendingPub*) NATS_CALLOC(size, sizeof(jsPendingPub));
+    if (table == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    for (seq=js->pmBase; seq<js->pmBase+(uint64_t)js->pmSize; seq++)
+    {
+        jsPendingPub *p = &(js->pmTable[seq & (uint64_t) (js->pmSize-1)]);
+
+        if (p->msg != NULL)
+            table[seq & (uint64_t) (size-1)] = *p;
+    }
+    NATS_FREE(js->pmTable);
+    js->pmTable = table;
+    js->pmSize  = size;
+
+    return NATS_OK;
+}
+
+// Moves the oldest entry of the pending table, if any, out of the table so
+// that the table can hold a newer sequence.
+// Lock held on entry.
+static natsStatus
+_evictOldestPending(jsCtx *js)
+{
+    natsStatus      s   = NATS_OK;
+    jsPendingPub    *p  = &(js->pmTable[js->pmBase & (uint64_t) (js->pmSize-1)]);
+    jsPendingPub    *o  = NULL;
+
+    if (p->msg != NULL)
+    {
+        if (js->pmOld == NULL)
+            s = natsHash_Create(&(js->pmOld), 16);
+        if (s == NATS_OK)
+        {
+            o = (jsPendingPub*) NATS_MALLOC(sizeof(jsPendingPub));
+            if (o == NULL)
+                s = nats_setDefaultError(NATS_NO_MEMORY);
+        }
+        if (s == NATS_OK)
+        {
+            *o = *p;
+            s = natsHash_Set(js->pmOld, (int64_t) js->pmBase, (void*) o, NULL);
+            if (s != NATS_OK)
+                NATS_FREE(o);
+        }
+        if (s != NATS_OK)
+            return NATS_UPDATE_ERR_STACK(s);
+
+        memset(p, 0, sizeof(jsPendingPub));
+        js->pmInTable--;
+    }
+    js->pmBase++;
+
+    return NATS_OK;
+}
+
+// Removes the pending entry for the given reply sequence and returns its
+// message, or NULL if there was no such entry. If `sentAt` is not NULL, it
+// is set to the time the message was added.
+// Lock held on entry.
+static natsMsg*
+_removePending(jsCtx *js, uint64_t seq, int64_t *sentAt)
+{
+    jsPendingPub    *p      = _getPending(js, seq);
+    natsMsg         *msg    = NULL;
+
+    if (p == NULL)
+        return NULL;
+
+    _unlinkPendingDeadline(js, p);
+    msg = p->msg;
+    if (sentAt != NULL)
+        *sentAt = p->sentAt;
+
+    if (seq < js->pmBase)
+    {
+        natsHash_Remove(js->pmOld, (int64_t) seq);
+        NATS_FREE(p);
+        return msg;
+    }
+
+    p->msg = NULL;
+    js->pmInTable--;
+
+    // Move the start of the table past the acknowledged entries.
+    if (js->pmInTable == 0)
+        js->pmBase = js->asyncReplies.idVal;
+    else
+    {
+        while (js->pmTable[js->pmBase & (uint64_t) (js->pmSize-1)].msg == NULL)
+            js->pmBase++;
+    }
+    return msg;
+}
+
+// Adds the message to the pending table under the given reply sequence,
+// which must be the last one that was assigned. If `mw` is positive, the
+// entry will time out after that many milliseconds.
+// Lock held on entry.
+static natsStatus
+_addPending(jsCtx *js, uint64_t seq, natsMsg *msg, int64_t mw);
+
+// Returns the number of pending entries.
+// Lock held on entry.
+static int
+_pendingCount(jsCtx *js)
+{
+    return js->pmInTable + (js->pmOld == NULL ? 0 : natsHash_Count(js->pmOld));
+}
+
+// A pending entry moved out of the table, with its reply sequence.
+typedef struct __jsOldPending
+{
+    uint64_t    seq;
+    natsMsg     *msg;
+
+} jsOldPending;
+
+static int
+_cmpOldPending(const void *a, const void *b)
+{
+    uint64_t sa = ((const jsOldPending*) a)->seq;
+    uint64_t sb = ((const jsOldPending*) b)->seq;
+
+    return (sa < sb ? -1 : (sa > sb ? 1 : 0));
+}
+
+// Removes all pending entries. If `msgs` is not NULL, it must be big enough
+// to hold _pendingCount() messages, and the messages are stored there
+// instead of being destroyed, in publish order: those that had been moved
+// out of the table, which are the oldest, are sorted by reply sequence.
+// On error, nothing is removed.
+// Lock held on entry.
+static natsStatus
+_removeAllPending(jsCtx *js, natsMsg **msgs)
+{
+    jsOldPending    *old    = NULL;
+    int             numOld  = (js->pmOld == NULL ? 0 : natsHash_Count(js->pmOld));
+    int             i       = 0;
+    int             j;
+    uint64_t        seq;
+
+    if ((msgs != NULL) && (numOld > 1))
+    {
+        old = (jsOldPending*) NATS_MALLOC(numOld * sizeof(jsOldPending));
+        if (old == NULL)
+            return nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    if (numOld > 0)
+    {
+        natsHashIter    iter;
+        int64_t         key = 0;
+        void            *v  = NULL;
+
+        natsHashIter_Init(&iter, js->pmOld);
+        while (natsHashIter_Next(&iter, &key, &v))
+        {
+            jsPendingPub *p = (jsPendingPub*) v;
+
+            if (old != NULL)
+            {
+                old[i].seq   = (uint64_t) key;
+                old[i++].msg = p->msg;
+            }
+            else if (msgs != NULL)
+                msgs[i++] = p->msg;
+            else
+                natsMsg_Destroy(p->msg);
+            natsHashIter_RemoveCurrent(&iter);
+            NATS_FREE(p);
+        }
+        natsHashIter_Done(&iter);
+    }
+    if (old != NULL)
+    {
+        qsort(old, (size_t) i, sizeof(jsOldPending), _cmpOldPending);
+        for (j=0; j<i; j++)
+            msgs[j] = old[j].msg;
+        NATS_FREE(old);
+    }
+    for (seq=js->pmBase; (js->pmInTable > 0) && (seq<js->pmBase+(uint64_t)js->pmSize); seq++)
+    {
+        jsPendingPub *p = &(js->pmTable[seq & (uint64_t) (js->pmSize-1)]);
+
+        if (p->msg == NULL)
+            continue;
+        if (msgs != NULL)
+            msgs[i++] = p->msg;
+        else
+            natsMsg_Destroy(p->msg);
+        memset(p, 0, sizeof(jsPendingPub));
+        js->pmInTable--;
+    }
+    js->pmBase  = js->asyncReplies.idVal;
+    js->pmdHead = 0;
+    js->pmdTail = 0;
+
+    return NATS_OK;
+}
+
 static void
 _freeContext(jsCtx *js)
 {
@@ -105,7 +408,9 @@ _freeContext(jsCtx *js)
     void            *arg    = NULL;
     js_onReleaseCb  cb      = NULL;
 
-    natsStrHash_Destroy(js->pm);
+    _removeAllPending(js, NULL);
+    NATS_FREE(js->pmTable);
+    natsHash_Destroy(js->pmOld);
     _destroyAsyncReplies(&js->asyncReplies);
     _destroyOptions(&(js->opts));
     natsCondition_Destroy(js->cond);
@@ -158,20 +463,9 @@ js_unlockAndRelease(jsCtx *js)
         _freeContext(js);
 }
 
-static void
-_destroyPMInfo(pmInfo *pmi)
-{
-    if (pmi == NULL)
-        return;
-
-    NATS_FREE(pmi->id);
-    NATS_FREE(pmi);
-}
-
 void
 jsCtx_Destroy(jsCtx *js)
 {
-    pmInfo *pm;
     jsAsyncReplies *ar;
 
     if (js == NULL)
@@ -201,24 +495,7 @@ jsCtx_Destroy(jsCtx *js)
             natsMutex_Unlock(ar->mu);
         }
     }
-    if ((js->pm != NULL) && natsStrHash_Count(js->pm) > 0)
-    {
-        natsStrHashIter iter;
-        void            *v = NULL;
-
-        natsStrHashIter_Init(&iter, js->pm);
-        while (natsStrHashIter_Next(&iter, NULL, &v))
-        {
-            natsMsg *msg = (natsMsg*) v;
-            natsStrHashIter_RemoveCurrent(&iter);
-            natsMsg_Destroy(msg);
-        }
-    }
-    while ((pm = js->pmHead) != NULL)
-    {
-        js->pmHead = pm->next;
-        _destroyPMInfo(pm);
-    }
+    _removeAllPending(js, NULL);
     if (js->pmtmr != NULL)
         natsTimer_Stop(js->pmtmr);
     js_unlockAndRelease(js);
@@ -377,12 +654,20 @@ natsConnection_JetStream(jsCtx **new_js, natsConnection *nc, jsOptions *opts)
             pa->ErrHandlerClosure   = opts->PublishAsync.ErrHandlerClosure;
         }
         pa->StallWait           = opts->PublishAsync.StallWait;
+        pa->AdaptiveMaxPending  = opts->PublishAsync.AdaptiveMaxPending;
         js->opts.Wait           = opts->Wait;
     }
     if (js->opts.Wait == 0)
         js->opts.Wait = jsDefaultRequestWait;
     if (js->opts.PublishAsync.StallWait == 0)
         js->opts.PublishAsync.StallWait = jsDefaultStallWait;
+    if (js->opts.PublishAsync.AdaptiveMaxPending)
+    {
+        js->pmWindow = JS_ADAPTIVE_INIT_PENDING;
+        if ((js->opts.PublishAsync.MaxPending > 0) && (js->pmWindow > js->opts.PublishAsync.MaxPending))
+            js->pmWindow = js->opts.PublishAsync.MaxPending;
+        js->pmSlowStart = true;
+    }
     if ((s == NATS_OK) && (opts != NULL))
     {
         s = _copyPurgeOptions(js, &(opts->Stream.Purge));
@@ -744,11 +1029,85 @@ _parsePubAck(natsMsg *msg, jsPubAck *pa, jsPubAckErr *pae, char *errTxt, size_t
     return s;
 }
 
+// Returns the number of async publishes allowed in flight, 0 for no limit.
+// Lock held on entry.
+static int64_t
+_maxPending(jsCtx *js)
+{
+    return (js->opts.PublishAsync.AdaptiveMaxPending ? js->pmWindow : js->opts.PublishAsync.MaxPending);
+}
+
+// Updates the ack round trip times and, with AdaptiveMaxPending, the window
+// of async publishes in flight. The window grows (by one per ack until the
+// first reduction, then by one per window of acks) while acks come back
+// close to the lowest round trip time of the last one or two periods. It is
+// halved, at most once per round trip, when they are delayed by queuing or
+// when the stream did not respond.
+// Lock held on entry.
+static void
+_updatePubFlow(jsCtx *js, uint64_t seq, int64_t sentAt, bool congested)
+{
+    int64_t max = js->opts.PublishAsync.MaxPending;
+
+    if (!congested)
+    {
+        int64_t now = nats_NowMonotonicInNanoSeconds();
+        int64_t rtt = now - sentAt;
+
+        if ((js->pmMinRTT == 0) || (rtt < js->pmMinRTT))
+            js->pmMinRTT = rtt;
+        if ((js->pmPeriodMinRTT == 0) || (rtt < js->pmPeriodMinRTT))
+            js->pmPeriodMinRTT = rtt;
+        if (js->pmPeriodStart == 0)
+            js->pmPeriodStart = now;
+        else if (now - js->pmPeriodStart >= JS_ADAPTIVE_MIN_RTT_PERIOD)
+        {
+            js->pmMinRTT        = js->pmPeriodMinRTT;
+            js->pmPeriodMinRTT  = 0;
+            js->pmPeriodStart   = now;
+        }
+        js->pmRTT = (js->pmRTT == 0 ? rtt : (7*js->pmRTT + rtt)/8);
+
+        // Ignore small delays that are only jitter on fast links.
+        congested = ((js->pmRTT > 2*js->pmMinRTT) && (js->pmRTT - js->pmMinRTT > JS_ADAPTIVE_MIN_DELAY));
+    }
+    if (!js->opts.PublishAsync.AdaptiveMaxPending)
+        return;
+
+    if (congested)
+    {
+        // Acks of messages sent before the last reduction do not
+        // reflect it yet.
+        if (seq < js->pmWindowEpoch)
+            return;
+
+        js->pmWindow /= 2;
+        if (js->pmWindow < JS_ADAPTIVE_MIN_PENDING)
+            js->pmWindow = JS_ADAPTIVE_MIN_PENDING;
+        js->pmWindowAcks    = 0;
+        js->pmWindowEpoch   = js->asyncReplies.idVal;
+        js->pmSlowStart     = false;
+        js->pmDecreases++;
+        return;
+    }
+    if (max <= 0)
+        max = JS_ADAPTIVE_MAX_PENDING;
+    if (js->pmWindow >= max)
+        return;
+    if (js->pmSlowStart || (++(js->pmWindowAcks) >= js->pmWindow))
+    {
+        js->pmWindow++;
+        js->pmWindowAcks = 0;
+    }
+}
+
 static void
 _handleAsyncReply(natsConnection *nc, natsSubscription *ignored, natsMsg *msg, void *closure)
 {
     const char      *subject    = msg->subject;
     char            *id         = NULL;
+    uint64_t        seq         = 0;
+    int64_t         sentAt      = 0;
     jsCtx           *js         = (jsCtx*) closure;
     natsMsg         *pmsg       = NULL;
     jsAsyncReplies  *ar         = &js->asyncReplies;
@@ -761,13 +1120,15 @@ _handleAsyncReply(natsConnection *nc, natsSubscription *ignored, natsMsg *msg, v
 
     js_lock(js);
 
-    pmsg = natsStrHash_Remove(js->pm, id);
+    if (nats_decodeRespID(id, (int) strlen(id), &seq))
+        pmsg = _removePending(js, seq, &sentAt);
     if (pmsg == NULL)
     {
         js_unlock(js);
         natsMsg_Destroy(msg);
         return;
     }
+    _updatePubFlow(js, seq, sentAt, natsMsg_IsNoResponders(msg) || natsMsg_isTimeout(msg));
 
     opa = &(js->opts.PublishAsync);
     if (opa->AckHandler)
@@ -819,7 +1180,7 @@ _handleAsyncReply(natsConnection *nc, natsSubscription *ignored, natsMsg *msg, v
     // If there are callers waiting for async pub completion, or stalled async
     // publish calls and we are now below max pending, broadcast to unblock them.
     if (((js->pacw > 0) && (js->pmcount == 0))
-        || ((js->stalled > 0) && (js->pmcount <= opa->MaxPending)))
+        || ((js->stalled > 0) && (js->pmcount <= _maxPending(js))))
     {
         natsCondition_Broadcast(js->cond);
     }
@@ -942,7 +1303,6 @@ _initAsyncReplies(jsCtx *js, jsAsyncReplies *ar)
     natsSubscription    *sub    = NULL;
     natsCondition       *cond   = NULL;
     natsCondition       *rCond  = NULL;
-    natsStrHash         *map    = NULL;
     char                *pfx    = NULL;
     char                *subj   = NULL;
     natsMsg             *dMsg   = NULL;
@@ -952,7 +1312,6 @@ _initAsyncReplies(jsCtx *js, jsAsyncReplies *ar)
     bool                skipSub = (js->opts.PublishAsync.MuxReplies && !nc->opts->useOldRequestStyle);
 
     s = natsCondition_Create(&cond);
-    IFOK(s, natsStrHash_Create(&map, 64));
     if ((s == NATS_OK) && !skipSub)
     {
         char inbox[NUID_BUFFER_LEN+1];
@@ -1014,7 +1373,6 @@ _initAsyncReplies(jsCtx *js, jsAsyncReplies *ar)
     }
     if (s == NATS_OK)
     {
-        js->pm          = map;
         js->cond        = cond;
         ar->repliesPfx  = pfx;
         ar->idOffset    = (int) strlen(pfx);
@@ -1028,7 +1386,6 @@ _initAsyncReplies(jsCtx *js, jsAsyncReplies *ar)
     {
         NATS_FREE(pfx);
         natsMsg_Destroy(dMsg);
-        natsStrHash_Destroy(map);
         natsCondition_Destroy(cond);
         natsCondition_Destroy(rCond);
         if (ctxID > 0)
@@ -1037,34 +1394,28 @@ _initAsyncReplies(jsCtx *js, jsAsyncReplies *ar)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
-static natsStatus
+// Builds the reply subject for a new async publish and returns the
+// sequence that identifies it.
+// Lock held on entry.
+static uint64_t
 _newAsyncReply(char *reply, jsCtx *js)
 {
-    natsStatus      s   = NATS_OK;
-    jsAsyncReplies  *ar = &js->asyncReplies;
+    jsAsyncReplies  *ar     = &js->asyncReplies;
+    char            *idBuf  = reply+ar->idOffset;
 
-    // Create the internal objects if it is the first time that we are doing
-    // an async publish.
-    if (!ar->init)
-        s = _initAsyncReplies(js, ar);
-    if (s == NATS_OK)
-    {
-        // Build the reply inbox.
-        char *idBuf = reply+ar->idOffset;
-        memcpy(reply, ar->repliesPfx, ar->idOffset);
-        nats_encodeRespID(idBuf, ar->idVal++, false);
-    }
-    return NATS_UPDATE_ERR_STACK(s);
+    memcpy(reply, ar->repliesPfx, ar->idOffset);
+    nats_encodeRespID(idBuf, ar->idVal, false);
+    return ar->idVal++;
 }
 
 static void
 _timeoutPubAsync(natsTimer *t, void *closure)
 {
-    jsCtx   *js = (jsCtx*) closure;
-    pmInfo  *pm = NULL;
-    int64_t now = nats_Now();
-    int64_t next= 0;
-    jsAsyncReplies *ar;
+    jsCtx           *js     = (jsCtx*) closure;
+    jsPendingPub    *p      = NULL;
+    int64_t         now     = nats_Now();
+    int64_t         next    = 0;
+    jsAsyncReplies  *ar;
 
     js_lock(js);
     if (js->closed)
@@ -1074,46 +1425,44 @@ _timeoutPubAsync(natsTimer *t, void *closure)
     }
 
     ar = &js->asyncReplies;
-    while (((pm = js->pmHead) != NULL) && (pm->deadline <= now))
+    while ((js->pmdHead != 0)
+           && ((p = _getPending(js, js->pmdHead-1))->deadline <= now))
     {
-        // Check if the corresponding message is still in the hashtable.
-        if (natsStrHash_Get(js->pm, pm->id) != NULL)
+        natsMsg *m      = NULL;
+        char    *subj   = NULL;
+        char    id[NATS_MAX_RESP_ID_LEN+1];
+
+        nats_encodeRespID(id, js->pmdHead-1, false);
+
+        // The entry stays pending until the timeout message is processed,
+        // but it no longer has a deadline.
+        _unlinkPendingDeadline(js, p);
+
+        if ((nats_asprintf(&subj, "%s%s", ar->repliesPfx, id) > 0)
+            && (natsMsg_Create(&m, subj, NULL, NULL, 0) == NATS_OK))
         {
-            natsMsg *m      = NULL;
-            char    *subj   = NULL;
+            natsMsg_setTimeout(m);
 
-            if ((nats_asprintf(&subj, "%s%s", ar->repliesPfx, pm->id) > 0)
-                && (natsMsg_Create(&m, subj, NULL, NULL, 0) == NATS_OK))
+            if (ar->sub != NULL)
             {
-                natsMsg_setTimeout(m);
-
-                if (ar->sub != NULL)
-                {
-                    // Best attempt, ignore NATS_SLOW_CONSUMER errors which may be returned here.
-                    nats_lockSubAndDispatcher(ar->sub);
-                    natsSub_enqueueUserMessage(ar->sub, m);
-                    nats_unlockSubAndDispatcher(ar->sub);
-                }
-                else
-                   js_submitRespMsg(js, m);
+                // Best attempt, ignore NATS_SLOW_CONSUMER errors which may be returned here.
+                nats_lockSubAndDispatcher(ar->sub);
+                natsSub_enqueueUserMessage(ar->sub, m);
+                nats_unlockSubAndDispatcher(ar->sub);
             }
-            NATS_FREE(subj);
+            else
+               js_submitRespMsg(js, m);
         }
-        // Remove from the list.
-        js->pmHead = pm->next;
-        _destroyPMInfo(pm);
+        NATS_FREE(subj);
     }
 
-    if (js->pmHead == NULL)
+    if (js->pmdHead == 0)
     {
-        if (js->pmTail != NULL)
-            js->pmTail = NULL;
-
         next = 60*60*1000;
     }
     else
     {
-        next = js->pmHead->deadline - now;
+        next = _getPending(js, js->pmdHead-1)->deadline - now;
         if (next <= 0)
             next = 1;
     }
@@ -1130,82 +1479,72 @@ _timeoutPubAsyncComplete(natsTimer *t, void *closure)
 }
 
 static natsStatus
-_trackPublishAsyncTimeout(jsCtx *js, char *id, int64_t mw)
+_addPending(jsCtx *js, uint64_t seq, natsMsg *msg, int64_t mw)
 {
-    natsStatus  s       = NATS_OK;
-    pmInfo      *pm     = NULL;
-    pmInfo      *pmi    = NATS_CALLOC(1, sizeof(pmInfo));
+    natsStatus      s = NATS_OK;
+    jsPendingPub    *p;
 
-    if (pmi == NULL)
-        return nats_setDefaultError(NATS_NO_MEMORY);
+    if (js->pmInTable == 0)
+        js->pmBase = seq;
 
-    pmi->id = NATS_STRDUP(id);
-    if (pmi->id == NULL)
+    // Make room for this sequence. If the table is mostly empty, it is
+    // because of old entries still waiting for their ack, so move those
+    // out of the table instead of growing it.
+    while ((s == NATS_OK) && ((seq - js->pmBase) >= (uint64_t) js->pmSize))
     {
-        NATS_FREE(pmi);
-        return nats_setDefaultError(NATS_NO_MEMORY);
+        if (js->pmInTable*2 >= js->pmSize)
+            s = _growPendingTable(js);
+        else
+            s = _evictOldestPending(js);
     }
-    pmi->deadline = nats_setTargetTime(mw);
+    if (s != NATS_OK)
+        return NATS_UPDATE_ERR_STACK(s);
 
-    // Check if we can add at the end of the list
-    if (((pm = js->pmTail) != NULL) && (pmi->deadline >= pm->deadline))
-    {
-        js->pmTail->next = pmi;
-        js->pmTail = pmi;
-    }
-    // Or before the first
-    else if (((pm = js->pmHead) != NULL) && (pmi->deadline < pm->deadline))
-    {
-        pmi->next = js->pmHead;
-        js->pmHead = pmi;
-        natsTimer_Reset(js->pmtmr, mw);
-    }
-    // If the list was empty
-    else if (js->pmHead == NULL)
+    p = &(js->pmTable[seq & (uint64_t) (js->pmSize-1)]);
+    p->msg      = msg;
+    p->sentAt   = nats_NowMonotonicInNanoSeconds();
+    js->pmInTable++;
+
+    if (mw <= 0)
+        return NATS_OK;
+
+    p->deadline = nats_setTargetTime(mw);
+    _linkPendingDeadline(js, seq, p);
+
+    // Nothing to do if it does not expire before the others.
+    if (js->pmdHead != seq+1)
+        return NATS_OK;
+
+    if (js->pmtmr == NULL)
     {
-        js->pmHead = pmi;
-        js->pmTail = pmi;
-        if (js->pmtmr == NULL)
-        {
-            s = natsTimer_Create(&js->pmtmr, _timeoutPubAsync, _timeoutPubAsyncComplete, mw, (void*) js);
-            if (s == NATS_OK)
-                js_retain(js);
-        }
+        s = natsTimer_Create(&js->pmtmr, _timeoutPubAsync, _timeoutPubAsyncComplete, mw, (void*) js);
+        if (s == NATS_OK)
+            js_retain(js);
         else
-            natsTimer_Reset(js->pmtmr, mw);
+            _removePending(js, seq, NULL);
     }
     else
-    {
-        // Guaranteed to be somewhere in the list (not first, not last, and at
-        // least 2 elements).
-        pm = js->pmHead;
-        while ((pm != NULL) && (pm->next != NULL) && (pmi->deadline > pm->next->deadline))
-            pm = pm->next;
+        natsTimer_Reset(js->pmtmr, mw);
 
-        pmi->next = pm->next;
-        pm->next = pmi;
-    }
-    if (s != NATS_OK)
-        _destroyPMInfo(pmi);
     return NATS_UPDATE_ERR_STACK(s);
 }
 
 static natsStatus
-_registerPubMsg(natsConnection **nc, char *reply, jsCtx *js, natsMsg *msg, int64_t mw)
+_registerPubMsg(natsConnection **nc, char *reply, uint64_t *seq, jsCtx *js, natsMsg *msg, int64_t mw)
 {
     natsStatus  s       = NATS_OK;
-    char        *id     = NULL;
     bool        release = false;
     int64_t     maxp    = 0;
 
     js_lock(js);
 
-    maxp = js->opts.PublishAsync.MaxPending;
+    maxp = _maxPending(js);
 
     js->pmcount++;
-    s = _newAsyncReply(reply, js);
-    if (s == NATS_OK)
-        id = reply+js->asyncReplies.idOffset;
+    // Create the internal objects if it is the first time that we are doing
+    // an async publish.
+    if (!js->asyncReplies.init)
+        s = _initAsyncReplies(js, &js->asyncReplies);
     if ((s == NATS_OK)
             && (maxp > 0)
             && (js->pmcount > maxp))
@@ -1214,8 +1553,9 @@ _registerPubMsg(natsConnection **nc, char *reply, jsCtx *js, natsMsg *msg, int64
 
         _retain(js);
 
+        js->pmStalls++;
         js->stalled++;
-        while ((s != NATS_TIMEOUT) && (js->pmcount > maxp))
+        while ((s != NATS_TIMEOUT) && (js->pmcount > _maxPending(js)))
             s = natsCondition_AbsoluteTimedWait(js->cond, js->mu, target);
         js->stalled--;
 
@@ -1224,10 +1564,13 @@ _registerPubMsg(natsConnection **nc, char *reply, jsCtx *js, natsMsg *msg, int64
 
         release = true;
     }
-    if ((s == NATS_OK) && (mw > 0))
-        s = _trackPublishAsyncTimeout(js, id, mw);
+    // The reply sequence is assigned only now, so that it is added to the
+    // pending table in order.
     if (s == NATS_OK)
-        s = natsStrHash_Set(js->pm, id, true, msg, NULL);
+    {
+        *seq = _newAsyncReply(reply, js);
+        s = _addPending(js, *seq, msg, mw);
+    }
     if (s == NATS_OK)
         *nc = js->nc;
     else
@@ -1265,6 +1608,7 @@ js_PublishMsgAsync(jsCtx *js, natsMsg **msg, jsPubOptions *opts)
     // our own subscription for the replies.
     char            replyBuf[32 + NATS_MAX_JS_RESP_SUFFIX_LEN];
     char            *reply = replyBuf;
+    uint64_t        seq = 0;
     int64_t         mw = 0;
 
     if ((js == NULL) || (msg == NULL) || (*msg == NULL))
@@ -1284,14 +1628,12 @@ js_PublishMsgAsync(jsCtx *js, natsMsg **msg, jsPubOptions *opts)
     }
 
     // On success, the context will be retained.
-    IFOK(s, _registerPubMsg(&nc, reply, js, *msg, mw));
+    IFOK(s, _registerPubMsg(&nc, reply, &seq, js, *msg, mw));
     if (s == NATS_OK)
     {
         s = natsConn_publish(nc, *msg, (const char*) reply, false);
         if (s != NATS_OK)
         {
-            char *id = reply+js->asyncReplies.idOffset;
-
             // The message may or may not have been sent, we don't know for sure.
             // We are going to attempt to remove from the map. If we can, then
             // we return the failure and the user owns the message. If we can't
@@ -1299,8 +1641,8 @@ js_PublishMsgAsync(jsCtx *js, natsMsg **msg, jsPubOptions *opts)
             // this call a success. If there was a pub ack failure, it is handled
             // with the error callback, but regardless, the library owns the message.
             js_lock(js);
-            // If msg no longer in map, Remove() will return NULL.
-            if (natsStrHash_Remove(js->pm, id) == NULL)
+            // If msg no longer pending, _removePending() will return NULL.
+            if (_removePending(js, seq, NULL) == NULL)
                 s = NATS_OK;
             else
                 js->pmcount--;
@@ -1338,7 +1680,7 @@ js_PublishAsyncComplete(jsCtx *js, jsPubOptions *opts)
     }
 
     js_lock(js);
-    if ((js->pm == NULL) || (js->pmcount == 0))
+    if (js->pmcount == 0)
     {
         js_unlock(js);
         return NATS_OK;
@@ -1376,28 +1718,20 @@ js_PublishAsyncGetPendingList(natsMsgList *pending, jsCtx *js)
         return nats_setDefaultError(NATS_INVALID_ARG);
 
     js_lock(js);
-    if ((count = natsStrHash_Count(js->pm)) == 0)
+    if ((count = _pendingCount(js)) == 0)
     {
         js_unlock(js);
         return NATS_NOT_FOUND;
     }
+    pending->Count = 0;
     pending->Msgs  = (natsMsg**) NATS_CALLOC(count, sizeof(natsMsg*));
     if (pending->Msgs == NULL)
         s = nats_setDefaultError(NATS_NO_MEMORY);
     else
+        s = _removeAllPending(js, pending->Msgs);
+    if (s == NATS_OK)
     {
-        natsStrHashIter iter;
-        void            *val = NULL;
-        int             i    = 0;
-
-        natsStrHashIter_Init(&iter, js->pm);
-        while (natsStrHashIter_Next(&iter, NULL, &val))
-        {
-            pending->Msgs[i++] = (natsMsg*) val;
-            natsStrHashIter_RemoveCurrent(&iter);
-            if (js->pmcount > 0)
-                js->pmcount--;
-        }
+        js->pmcount -= (js->pmcount >= count ? count : js->pmcount);
         pending->Count = count;
     }
     js_unlock(js);
@@ -1408,6 +1742,24 @@ js_PublishAsyncGetPendingList(natsMsgList *pending, jsCtx *js)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+natsStatus
+js_PublishAsyncGetStats(jsPublishAsyncStats *stats, jsCtx *js)
+{
+    if ((stats == NULL) || (js == NULL))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    js_lock(js);
+    stats->Pending      = js->pmcount;
+    stats->MaxPending   = _maxPending(js);
+    stats->RTT          = js->pmRTT;
+    stats->MinRTT       = js->pmMinRTT;
+    stats->Stalls       = js->pmStalls;
+    stats->Decreases    = js->pmDecreases;
+    js_unlock(js);
+
+    return NATS_OK;
+}
+
 natsStatus
 jsSubOptions_Init(jsSubOptions *opts)
 {
@@ -1486,44 +1838,218 @@ _destroyFetch(jsFetch *fetch)
     NATS_FREE(fetch);
 }
 
-void
-jsSub_free(jsSub *jsi)
+static void
+_destroyAckBatch(jsAckBatch *ab)
 {
-    jsCtx *js = NULL;
-
-    if (jsi == NULL)
+    if (ab == NULL)
         return;
 
-    _destroyFetch(jsi->fetch);
-
-    js = jsi->js;
-    natsTimer_Destroy(jsi->hbTimer);
-
-    NATS_FREE(jsi->stream);
-    NATS_FREE(jsi->consumer);
-    NATS_FREE(jsi->nxtMsgSubj);
-    NATS_FREE(jsi->cmeta);
-    NATS_FREE(jsi->fcReply);
-    NATS_FREE(jsi->psubj);
-    js_destroyConsumerConfig(jsi->ocCfg);
-    NATS_FREE(jsi);
-
-    js_release(js);
+    natsTimer_Destroy(ab->timer);
+    natsBuf_Destroy(ab->replies);
+    NATS_FREE(ab->offsets);
+    NATS_FREE(ab->msgs);
+    NATS_FREE(ab->ptrs);
+    natsMutex_Destroy(ab->mu);
+    NATS_FREE(ab);
 }
 
-static void
-_autoAckCB(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+static natsStatus
+_createAckBatch(jsAckBatch **newAB, jsSubOptions *opts)
 {
-    jsSub   *jsi = (jsSub*) closure;
+    natsStatus  s   = NATS_OK;
+    jsAckBatch  *ab = NULL;
 
-    natsMsg_setNoDestroy(msg);
+    ab = (jsAckBatch*) NATS_CALLOC(1, sizeof(jsAckBatch));
+    if (ab == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
 
-    // Invoke user callback
-    (jsi->usrCb)(nc, sub, msg, jsi->usrCbClosure);
+    ab->size    = opts->AckBatchSize;
+    ab->ackAll  = (opts->Config.AckPolicy == js_AckAll);
 
-    natsMsg_Ack(msg, NULL);
-    natsMsg_clearNoDestroy(msg);
-    natsMsg_Destroy(msg);
+    s = natsMutex_Create(&(ab->mu));
+    IFOK(s, natsBuf_Create(&(ab->replies), ab->size * 64));
+    if (s == NATS_OK)
+    {
+        ab->offsets = (int*) NATS_CALLOC(ab->size, sizeof(int));
+        ab->msgs    = (natsMsg*) NATS_CALLOC(ab->size, sizeof(natsMsg));
+        ab->ptrs    = (natsMsg**) NATS_CALLOC(ab->size, sizeof(natsMsg*));
+        if ((ab->offsets == NULL) || (ab->msgs == NULL) || (ab->ptrs == NULL))
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    if (s == NATS_OK)
+        *newAB = ab;
+    else
+        _destroyAckBatch(ab);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Sends all buffered acks in a single batch.
+// Lock `ab->mu` held on entry. The connection lock is acquired by the
+// batch publish, so the subscription lock must not be held.
+static natsStatus
+_sendAckBatch(natsSubscription *sub, jsAckBatch *ab)
+{
+    natsStatus  s = NATS_OK;
+    const char  *data;
+    int         i;
+
+    if (ab->pending == 0)
+    {
+        ab->count = 0;
+        return NATS_OK;
+    }
+
+    data = natsBuf_Data(ab->replies);
+    for (i=0; i<ab->pending; i++)
+    {
+        natsMsg_init(&(ab->msgs[i]), data + ab->offsets[i], jsAckAck, (int) strlen(jsAckAck));
+        ab->ptrs[i] = &(ab->msgs[i]);
+    }
+    s = natsConnection_PublishBatch(sub->conn, ab->ptrs, ab->pending);
+
+    // Whether it succeeded or not, those acks are gone. On failure, the
+    // server will redeliver the messages after the consumer's AckWait.
+    natsBuf_Reset(ab->replies);
+    ab->pending = 0;
+    ab->count   = 0;
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+jsSub_flushAcks(natsSubscription *sub)
+{
+    jsAckBatch  *ab;
+    natsStatus  s;
+
+    if ((sub->jsi == NULL) || ((ab = sub->jsi->ackBatch) == NULL))
+        return NATS_OK;
+
+    natsMutex_Lock(ab->mu);
+    s = _sendAckBatch(sub, ab);
+    natsMutex_Unlock(ab->mu);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+static void
+_ackBatchTimerFired(natsTimer *timer, void* closure)
+{
+    natsSubscription *sub = (natsSubscription*) closure;
+
+    // Failures here would be about the connection being closed, in which
+    // case there is nothing to report, the messages will be redelivered.
+    jsSub_flushAcks(sub);
+}
+
+// Adds the ack of this message to the batch, unless the subscription is
+// closed or draining, in which case `buffered` is left to false and the
+// caller sends the ack directly (after the buffered ones have been sent).
+static natsStatus
+_bufferAck(natsSubscription *sub, jsAckBatch *ab, natsMsg *msg, bool *buffered)
+{
+    natsStatus  s       = NATS_OK;
+    uint64_t    dseq    = 0;
+    bool        direct  = false;
+    int         len;
+
+    // Check under the batch lock so that an ack can't be buffered after
+    // the final flush done when unsubscribing.
+    natsMutex_Lock(ab->mu);
+    natsSub_Lock(sub);
+    direct = (sub->closed || natsSub_drainStarted(sub));
+    natsSub_Unlock(sub);
+
+    if (!direct && ab->ackAll)
+    {
+        // Keep only the ack for the highest consumer sequence. If the reply
+        // subject can't be parsed, send it directly.
+        if (js_getMetaData(msg->reply+jsAckPrefixLen, NULL, NULL, NULL, NULL,
+                           NULL, &dseq, NULL, NULL, 1) != NATS_OK)
+        {
+            nats_clearLastError();
+            direct = true;
+        }
+    }
+    if (direct)
+    {
+        s = _sendAckBatch(sub, ab);
+        natsMutex_Unlock(ab->mu);
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+    len = (int) strlen(msg->reply) + 1;
+    if (ab->ackAll)
+    {
+        if (dseq > ab->ackAllSeq)
+        {
+            natsBuf_Reset(ab->replies);
+            s = natsBuf_Append(ab->replies, msg->reply, len);
+            if (s == NATS_OK)
+            {
+                ab->offsets[0]  = 0;
+                ab->pending     = 1;
+                ab->ackAllSeq   = dseq;
+            }
+        }
+    }
+    else
+    {
+        ab->offsets[ab->pending] = natsBuf_Len(ab->replies);
+        s = natsBuf_Append(ab->replies, msg->reply, len);
+        if (s == NATS_OK)
+            ab->pending++;
+    }
+    if (s == NATS_OK)
+    {
+        *buffered = true;
+        if (++(ab->count) >= ab->size)
+            s = _sendAckBatch(sub, ab);
+    }
+    natsMutex_Unlock(ab->mu);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+void
+jsSub_free(jsSub *jsi)
+{
+    jsCtx *js = NULL;
+
+    if (jsi == NULL)
+        return;
+
+    _destroyFetch(jsi->fetch);
+
+    js = jsi->js;
+    natsTimer_Destroy(jsi->hbTimer);
+    _destroyAckBatch(jsi->ackBatch);
+
+    NATS_FREE(jsi->stream);
+    NATS_FREE(jsi->consumer);
+    NATS_FREE(jsi->nxtMsgSubj);
+    NATS_FREE(jsi->cmeta);
+    NATS_FREE(jsi->fcReply);
+    NATS_FREE(jsi->psubj);
+    js_destroyConsumerConfig(jsi->ocCfg);
+    NATS_FREE(jsi);
+
+    js_release(js);
+}
+
+static void
+_autoAckCB(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+{
+    jsSub   *jsi = (jsSub*) closure;
+
+    natsMsg_setNoDestroy(msg);
+
+    // Invoke user callback
+    (jsi->usrCb)(nc, sub, msg, jsi->usrCbClosure);
+
+    natsMsg_Ack(msg, NULL);
+    natsMsg_clearNoDestroy(msg);
+    natsMsg_Destroy(msg);
 }
 
 natsStatus
@@ -2079,6 +2605,69 @@ js_checkFetchedMsg(natsSubscription *sub, natsMsg *msg, uint64_t fetchID, bool c
     return nats_setError(NATS_ERR, "%s", (desc == NULL ? "error checking pull subscribe message" : desc));
 }
 
+// In consume mode, pull requests that terminate are simply replaced, so
+// this function accounts for the messages and bytes that will not be
+// delivered and turns the status into NATS_OK, unless it is fatal.
+// Sub/dispatch locks must be held.
+natsStatus
+js_checkConsumeStatus(natsSubscription *sub, jsFetch *fetch, natsMsg *msg, natsStatus fetchStatus, bool usrMsg)
+{
+    const char  *val = NULL;
+    int64_t     n;
+
+    if (usrMsg || (msg == sub->control->fetch.expired))
+        return fetchStatus;
+
+    if (msg == sub->control->fetch.missedHeartbeat)
+    {
+        // Pull requests may have been lost, so request everything again.
+        fetch->pendingMsgs  = 0;
+        fetch->pendingBytes = 0;
+        fetch->stalled      = true;
+        return NATS_OK;
+    }
+
+    // The server indicates what a terminated pull request will not deliver,
+    // whether it is the latest request or a previous one.
+    if ((natsMsgHeader_Get(msg, jsPendingMsgsHdr, &val) == NATS_OK)
+        && ((n = nats_ParseInt64(val, (int) strlen(val))) > 0))
+    {
+        fetch->pendingMsgs -= n;
+    }
+    if ((natsMsgHeader_Get(msg, jsPendingBytesHdr, &val) == NATS_OK)
+        && ((n = nats_ParseInt64(val, (int) strlen(val))) > 0))
+    {
+        fetch->pendingBytes -= n;
+    }
+    if (fetch->pendingMsgs < 0)
+        fetch->pendingMsgs = 0;
+    if (fetch->pendingBytes < 0)
+        fetch->pendingBytes = 0;
+
+    switch (fetchStatus)
+    {
+        case NATS_TIMEOUT:
+        case NATS_NOT_FOUND:
+        case NATS_PIN_ID_MISMATCH:
+            return NATS_OK;
+        case NATS_LIMIT_REACHED:
+        {
+            // 409 is also used for fatal conditions.
+            val = NULL;
+            natsMsgHeader_Get(msg, DESCRIPTION_HDR, &val);
+            if ((val != NULL) && ((strstr(val, "Consumer Deleted") != NULL)
+                                  || (strstr(val, "Consumer is push based") != NULL)))
+            {
+                return fetchStatus;
+            }
+            nats_clearLastError();
+            return NATS_OK;
+        }
+        default:
+            return fetchStatus;
+    }
+}
+
 static natsStatus
 _publishPullRequest(natsConnection *nc, const char *subj, const char *rply,
                  natsBuffer *buf, jsFetchRequest *req)
@@ -2403,7 +2992,9 @@ _hbTimerFired(natsTimer *timer, void* closure)
         if (sub->ownDispatcher.queue.msgs == 0)
         {
             natsSub_enqueueMessage(sub, sub->control->fetch.missedHeartbeat);
-            natsTimer_Stop(timer);
+            // In consume mode, pull requests are reissued, so keep checking.
+            if ((jsi->fetch == NULL) || !jsi->fetch->opts.Consume)
+                natsTimer_Stop(timer);
         }
         nats_unlockSubAndDispatcher(sub);
         return;
@@ -2752,6 +3343,10 @@ _subscribeMulti(natsSubscription **new_sub, jsCtx *js, const char **subjects, in
         return nats_setError(NATS_INVALID_ARG,
                              "invalid InactiveThreshold value (%d), needs to be greater or equal to 0",
                              (int) opts->Config.InactiveThreshold);
+    if ((opts->AckBatchSize < 0) || (opts->AckBatchInterval < 0))
+        return nats_setError(NATS_INVALID_ARG,
+                             "invalid ack batch size (%d) or interval (%" PRId64 "), need to be greater or equal to 0",
+                             opts->AckBatchSize, opts->AckBatchInterval);
 
     // If user configures optional start sequence or time, the deliver policy
     // need to be updated accordingly. Server will return error if user tries to have both set.
@@ -2953,6 +3548,9 @@ PROCESS_INFO:
                 jsi->ackNone= (opts->Config.AckPolicy == js_AckNone || opts->Ordered);
                 js_retain(js);
 
+                if ((opts->AckBatchSize > 1) && !jsi->ackNone)
+                    s = _createAckBatch(&(jsi->ackBatch), opts);
+
                 if ((usrCB != NULL) && !opts->ManualAck && !jsi->ackNone)
                 {
                     // Keep track of user provided CB and closure
@@ -2989,7 +3587,7 @@ PROCESS_INFO:
         // Create the NATS subscription on given deliver subject. Note that
         // cb/cbClosure will be NULL for sync or pull subscriptions.
         IFOK(s, natsConn_subscribeImpl(&sub, nc, true, deliver,
-                                       opts->Queue, 0, cb, cbClosure, false, jsi));
+                                       opts->Queue, 0, cb, cbClosure, NULL, false, jsi));
         if ((s == NATS_OK) && (hbi > 0) && !isPullMode)
         {
             natsSub_Lock(sub);
@@ -2999,6 +3597,17 @@ PROCESS_INFO:
                 sub->refs--;
             natsSub_Unlock(sub);
         }
+        if ((s == NATS_OK) && (jsi->ackBatch != NULL))
+        {
+            int64_t interval = (opts->AckBatchInterval > 0 ? opts->AckBatchInterval : 100);
+
+            natsSub_Lock(sub);
+            sub->refs++;
+            s = natsTimer_Create(&jsi->ackBatch->timer, _ackBatchTimerFired, _releaseSubWhenStopped, interval, (void*) sub);
+            if (s != NATS_OK)
+                sub->refs--;
+            natsSub_Unlock(sub);
+        }
         NATS_FREE(pullWCInbox);
     }
     if ((s == NATS_OK) && create)
@@ -3187,6 +3796,27 @@ js_PullSubscribe(natsSubscription **sub, jsCtx *js, const char *subject, const c
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+// Posts the missed heartbeats error if it was detected since the last
+// pull request. Neither sub's nor dispatcher's lock must be held.
+static void
+_reportConsumeStalled(natsSubscription *sub, jsFetch *fetch)
+{
+    natsConnection  *nc     = sub->conn;
+    bool            stalled = false;
+
+    nats_lockSubAndDispatcher(sub);
+    stalled = fetch->stalled;
+    fetch->stalled = false;
+    nats_unlockSubAndDispatcher(sub);
+
+    if (!stalled)
+        return;
+
+    natsConn_Lock(nc);
+    natsAsyncCb_PostErrHandler(nc, sub, NATS_MISSED_HEARTBEAT, NULL);
+    natsConn_Unlock(nc);
+}
+
 // Neither sub's nor dispatcher's lock must be held.
 natsStatus
 js_maybeFetchMore(natsSubscription *sub, jsFetch *fetch)
@@ -3196,6 +3826,9 @@ js_maybeFetchMore(natsSubscription *sub, jsFetch *fetch)
     if (fetch->opts.NextHandler == NULL)
         return NATS_OK;
 
+    if (fetch->opts.Consume)
+        _reportConsumeStalled(sub, fetch);
+
     // Prepare the next fetch request
     if (!fetch->opts.NextHandler(&req.Batch, &req.MaxBytes, sub, fetch->opts.NextHandlerClosure))
         return NATS_OK;
@@ -3204,6 +3837,13 @@ js_maybeFetchMore(natsSubscription *sub, jsFetch *fetch)
     int64_t now = nats_Now();
     if (fetch->opts.Timeout != 0)
         req.Expires = (fetch->opts.Timeout - (now - fetch->startTimeMillis)) * 1000 * 1000; // ns, go time.Duration
+    if (fetch->opts.Consume)
+    {
+        int64_t expires = fetch->opts.FetchExpires * 1000 * 1000;
+
+        if ((req.Expires <= 0) || (req.Expires > expires))
+            req.Expires = expires;
+    }
     req.NoWait = fetch->opts.NoWait;
     req.Heartbeat = fetch->opts.Heartbeat * 1000 * 1000; // ns, go time.Duration
     req.Group = fetch->opts.Group;
@@ -3233,7 +3873,12 @@ js_maybeFetchMore(natsSubscription *sub, jsFetch *fetch)
     if (s == NATS_OK)
     {
         nats_lockSubAndDispatcher(sub);
-        fetch->requestedMsgs += req.Batch;
+        if (!fetch->opts.Consume)
+            fetch->requestedMsgs += req.Batch;
+        else if (fetch->opts.FetchMaxBytes > 0)
+            fetch->pendingBytes += req.MaxBytes;
+        else
+            fetch->pendingMsgs += req.Batch;
         nats_unlockSubAndDispatcher(sub);
     }
 
@@ -3294,6 +3939,58 @@ _autoNextFetchRequest(int *messages, int64_t *maxBytes, natsSubscription *sub, v
     return true;
 }
 
+// Sets Batch and MaxBytes for the next pull request in consume mode. A new
+// request is sent when what was requested but not yet delivered falls to
+// the threshold, and it asks for the difference.
+static bool
+_consumeNextFetchRequest(int *messages, int64_t *maxBytes, natsSubscription *sub, void *closure)
+{
+    jsFetch *fetch      = (jsFetch *)closure;
+    int64_t want        = 0;
+    int64_t wantBytes   = 0;
+    int64_t remaining;
+
+    nats_lockSubAndDispatcher(sub);
+
+    if (fetch->opts.FetchMaxBytes > 0)
+    {
+        if (fetch->pendingBytes <= (fetch->opts.FetchMaxBytes * fetch->opts.ThresholdPercent / 100))
+        {
+            want        = NATS_CONSUME_BYTES_BATCH;
+            wantBytes   = fetch->opts.FetchMaxBytes - fetch->pendingBytes;
+        }
+    }
+    else if (fetch->pendingMsgs <= ((int64_t) fetch->opts.FetchSize * fetch->opts.ThresholdPercent / 100))
+    {
+        want = fetch->opts.FetchSize - fetch->pendingMsgs;
+    }
+
+    // Do not ask for more than what the limits, if any, allow.
+    if ((want > 0) && (fetch->opts.MaxMessages > 0))
+    {
+        remaining = fetch->opts.MaxMessages - fetch->deliveredMsgs - fetch->pendingMsgs;
+        if (want > remaining)
+            want = remaining;
+    }
+    if ((want > 0) && (wantBytes > 0) && (fetch->opts.MaxBytes > 0))
+    {
+        remaining = fetch->opts.MaxBytes - fetch->deliveredBytes - fetch->pendingBytes;
+        if (wantBytes > remaining)
+            wantBytes = remaining;
+        if (wantBytes <= 0)
+            want = 0;
+    }
+
+    nats_unlockSubAndDispatcher(sub);
+
+    if (want <= 0)
+        return false;
+
+    *messages = (int) want;
+    *maxBytes = wantBytes;
+    return true;
+}
+
 natsStatus
 js_PullSubscribeAsync(natsSubscription **newsub, jsCtx *js, const char *subject, const char *durable,
                       natsMsgHandler msgCB, void *msgCBClosure,
@@ -3307,6 +4004,20 @@ js_PullSubscribeAsync(natsSubscription **newsub, jsCtx *js, const char *subject,
     if ((newsub == NULL) || (msgCB == NULL))
         return nats_setDefaultError(NATS_INVALID_ARG);
 
+    if ((jsOpts != NULL) && jsOpts->PullSubscribeAsync.Consume)
+    {
+        struct jsOptionsPullSubscribeAsync *o = &(jsOpts->PullSubscribeAsync);
+        int64_t expires = (o->FetchExpires > 0 ? o->FetchExpires : NATS_DEFAULT_CONSUME_EXPIRES);
+
+        if (o->NoWait || (o->KeepAhead > 0) || (o->NextHandler != NULL))
+            return nats_setError(NATS_INVALID_ARG, "%s", "Can not use Consume with NoWait, KeepAhead or NextHandler");
+        if ((o->ThresholdPercent < 0) || (o->ThresholdPercent > 99))
+            return nats_setError(NATS_INVALID_ARG, "invalid ThresholdPercent value (%d), needs to be between 1 and 99", o->ThresholdPercent);
+        if ((o->FetchSize < 0) || (o->FetchMaxBytes < 0) || (o->FetchExpires < 0))
+            return nats_setError(NATS_INVALID_ARG, "%s", "FetchSize, FetchMaxBytes and FetchExpires can not be negative");
+        if ((o->Heartbeat > 0) && (o->Heartbeat * 2 >= expires))
+            return nats_setError(NATS_INVALID_ARG, "Heartbeat (%" PRId64 ") needs to be less than half of FetchExpires (%" PRId64 ")", o->Heartbeat, expires);
+    }
     if ((jsOpts != NULL) && (jsOpts->PullSubscribeAsync.KeepAhead > 0))
     {
         if (jsOpts->PullSubscribeAsync.MaxBytes > 0)
@@ -3369,7 +4080,25 @@ js_PullSubscribeAsync(natsSubscription **newsub, jsCtx *js, const char *subject,
         fetch->opts = jsOpts->PullSubscribeAsync;
     if (fetch->opts.FetchSize == 0)
         fetch->opts.FetchSize = NATS_DEFAULT_ASYNC_FETCH_SIZE;
-    if (fetch->opts.NextHandler == NULL)
+    if (fetch->opts.Consume)
+    {
+        if (fetch->opts.FetchExpires == 0)
+            fetch->opts.FetchExpires = NATS_DEFAULT_CONSUME_EXPIRES;
+        if (fetch->opts.ThresholdPercent == 0)
+            fetch->opts.ThresholdPercent = NATS_DEFAULT_CONSUME_THRESHOLD;
+        // Pull requests lost without a status (for instance across a
+        // reconnect) would otherwise never be replaced, since they are
+        // only reissued when heartbeats are missed.
+        if (fetch->opts.Heartbeat == 0)
+        {
+            fetch->opts.Heartbeat = fetch->opts.FetchExpires / 2;
+            if (fetch->opts.Heartbeat > NATS_DEFAULT_CONSUME_MAX_HEARTBEAT)
+                fetch->opts.Heartbeat = NATS_DEFAULT_CONSUME_MAX_HEARTBEAT;
+        }
+        fetch->opts.NextHandler = _consumeNextFetchRequest;
+        fetch->opts.NextHandlerClosure = (void *)fetch;
+    }
+    else if (fetch->opts.NextHandler == NULL)
     {
         fetch->opts.NextHandler = _autoNextFetchRequest;
         fetch->opts.NextHandlerClosure = (void *)fetch;
@@ -3477,6 +4206,25 @@ _ackMsg(natsMsg *msg, jsOptions *opts, _ackOpts *o, jsErrCode *errCode)
         snprintf(tmp, sizeof(tmp), "%s {\"delay\":%" PRId64 "}", o->ackType, v);
         body = (const char*) tmp;
     }
+    if (jsi->ackBatch != NULL)
+    {
+        bool buffered = false;
+
+        // Plain asynchronous acks are buffered, anything else is sent
+        // after the buffered acks to preserve ordering.
+        if (!sync && (strcmp(body, jsAckAck) == 0))
+            s = _bufferAck(sub, jsi->ackBatch, msg, &buffered);
+        else
+            s = jsSub_flushAcks(sub);
+
+        if ((s == NATS_OK) && buffered)
+        {
+            natsMsg_setAcked(msg);
+            return NATS_OK;
+        }
+        if (s != NATS_OK)
+            return NATS_UPDATE_ERR_STACK(s);
+    }
     if (sync)
     {
         natsMsg *rply   = NULL;
@@ -3673,9 +4421,11 @@ applyNewSID(natsSubscription *sub)
 
     natsMutex_Lock(nc->subsMu);
     osid = sub->sid;
-    natsHash_Remove(nc->subs, osid);
     nsid = natsConn_getNewSID(nc);
+    natsConn_subsWriteBegin(nc);
+    natsHash_Remove(nc->subs, osid);
     natsHash_Set(nc->subs, nsid, sub, NULL);
+    natsConn_subsWriteEnd(nc);
     natsMutex_Unlock(nc->subsMu);
 
     natsSub_Lock(sub);
@@ -3997,3 +4747,558 @@ jsAtomicBatchCtx_Destroy(jsAtomicBatchCtx *ctx)
     NATS_FREE(ctx->id);
     NATS_FREE(ctx);
 }
+
+natsStatus
+jsStreamWriterOptions_Init(jsStreamWriterOptions *opts)
+{
+    if (opts == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    memset(opts, 0, sizeof(jsStreamWriterOptions));
+    return NATS_OK;
+}
+
+static void
+_freeStreamWriter(jsStreamWriter *w)
+{
+    int i;
+
+    for (i=0; (w->entries != NULL) && (i<w->opts.MaxInFlight); i++)
+    {
+        natsMsg_Destroy(w->entries[i].msg);
+        natsMsg_Destroy(w->entries[i].reply);
+    }
+    NATS_FREE(w->entries);
+    NATS_FREE(w->replyPfx);
+    natsTimer_Destroy(w->tmr);
+    natsCondition_Destroy(w->cond);
+    natsMutex_Destroy(w->mu);
+    js_release(w->js);
+    NATS_FREE(w);
+}
+
+static void
+_releaseStreamWriter(void *closure)
+{
+    jsStreamWriter  *w = (jsStreamWriter*) closure;
+    bool            doFree;
+
+    natsMutex_Lock(w->mu);
+    doFree = (--(w->refs) == 0);
+    natsMutex_Unlock(w->mu);
+
+    if (doFree)
+        _freeStreamWriter(w);
+}
+
+static void
+_releaseStreamWriterTimer(natsTimer *t, void *closure)
+{
+    _releaseStreamWriter(closure);
+}
+
+// Returns the entry for this sequence if it is in flight, NULL otherwise.
+// Lock held on entry.
+static jsStreamWriterEntry*
+_getWriterEntry(jsStreamWriter *w, uint64_t seq)
+{
+    jsStreamWriterEntry *e;
+
+    if ((seq < w->head) || (seq >= w->next))
+        return NULL;
+
+    e = &(w->entries[seq % (uint64_t) w->opts.MaxInFlight]);
+    return (e->done ? NULL : e);
+}
+
+// Sends the message of the entry for this sequence. The entry must have been
+// marked as `sending` so that it is not released during the call.
+// Lock not held on entry.
+static natsStatus
+_sendWriterEntry(jsStreamWriter *w, uint64_t seq, natsMsg *msg)
+{
+    natsStatus  s       = NATS_OK;
+    char        buf[64 + NATS_MAX_RESP_ID_LEN + 1];
+    char        *reply  = buf;
+
+    if (w->replyPfxLen > 64)
+    {
+        reply = NATS_MALLOC(w->replyPfxLen + NATS_MAX_RESP_ID_LEN + 1);
+        if (reply == NULL)
+            return nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    memcpy(reply, w->replyPfx, w->replyPfxLen);
+    nats_encodeRespID(reply+w->replyPfxLen, seq, false);
+
+    s = natsConn_publish(w->js->nc, msg, (const char*) reply, false);
+
+    if (reply != buf)
+        NATS_FREE(reply);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+static void
+_invokeWriterAckHandler(jsStreamWriter *w, natsMsg *msg, natsMsg *reply, natsStatus err)
+{
+    char        errTxt[256] = {'\0'};
+    jsPubAck    pa;
+    jsPubAckErr pae;
+    jsPubAck    *ppa        = NULL;
+    jsPubAckErr *ppae       = NULL;
+
+    if (reply == NULL)
+    {
+        memset(&pae, 0, sizeof(jsPubAckErr));
+        pae.Err     = err;
+        pae.ErrText = natsStatus_GetText(err);
+        ppae        = &pae;
+    }
+    else if (_parsePubAck(reply, &pa, &pae, errTxt, sizeof(errTxt)) != NATS_OK)
+        ppae = &pae;
+    else
+        ppa = &pa;
+
+    (w->opts.AckHandler)(w->js, msg, ppa, ppae, w->opts.AckHandlerClosure);
+
+    _freePubAck(ppa);
+    natsMsg_Destroy(reply);
+}
+
+// Invokes the ack handler, in order, for all the entries that are done.
+// Only one thread at a time does so. When no ack handler is set, simply
+// notifies the threads waiting in jsStreamWriter_Next() or _Flush().
+static void
+_reportWriterResults(jsStreamWriter *w)
+{
+    natsMutex_Lock(w->mu);
+    if ((w->opts.AckHandler == NULL) || w->reporting)
+    {
+        natsCondition_Broadcast(w->cond);
+        natsMutex_Unlock(w->mu);
+        return;
+    }
+    w->reporting = true;
+    while (!w->closed && (w->head < w->next))
+    {
+        jsStreamWriterEntry e = w->entries[w->head % (uint64_t) w->opts.MaxInFlight];
+
+        if (!e.done || e.sending)
+            break;
+
+        memset(&(w->entries[w->head % (uint64_t) w->opts.MaxInFlight]), 0, sizeof(jsStreamWriterEntry));
+        w->head++;
+        natsCondition_Broadcast(w->cond);
+        natsMutex_Unlock(w->mu);
+
+        _invokeWriterAckHandler(w, e.msg, e.reply, e.err);
+
+        natsMutex_Lock(w->mu);
+    }
+    w->reporting = false;
+    natsCondition_Broadcast(w->cond);
+    natsMutex_Unlock(w->mu);
+}
+
+static void
+_handleWriterReply(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+{
+    jsStreamWriter      *w  = (jsStreamWriter*) closure;
+    jsStreamWriterEntry *e  = NULL;
+    const char          *id = msg->subject+w->replyPfxLen;
+    uint64_t            seq = 0;
+
+    natsMutex_Lock(w->mu);
+    if (!w->closed && nats_decodeRespID(id, (int) strlen(id), &seq))
+        e = _getWriterEntry(w, seq);
+    if ((e != NULL) && natsMsg_IsNoResponders(msg) && (e->attempts <= w->opts.MaxRetries))
+    {
+        // The stream may be temporarily unavailable, the timer will resend.
+        e->retryAt = nats_setTargetTime(w->opts.RetryWait);
+        e = NULL;
+    }
+    if (e != NULL)
+    {
+        e->reply    = msg;
+        e->done     = true;
+        msg         = NULL;
+    }
+    natsMutex_Unlock(w->mu);
+
+    if (msg == NULL)
+        _reportWriterResults(w);
+    else
+        natsMsg_Destroy(msg);
+}
+
+static void
+_writerTimerCb(natsTimer *timer, void *closure)
+{
+    jsStreamWriter  *w      = (jsStreamWriter*) closure;
+    int64_t         now     = nats_Now();
+    bool            report  = false;
+    uint64_t        seq;
+
+    natsMutex_Lock(w->mu);
+    for (seq=w->head; !w->closed && (seq<w->next); seq++)
+    {
+        jsStreamWriterEntry *e = &(w->entries[seq % (uint64_t) w->opts.MaxInFlight]);
+        natsStatus          s;
+
+        if (e->done || e->sending)
+            continue;
+
+        if (e->deadline <= now)
+        {
+            e->err  = (e->retryAt > 0 ? NATS_NO_RESPONDERS : NATS_TIMEOUT);
+            e->done = true;
+            report  = true;
+        }
+        else if ((e->retryAt > 0) && (e->retryAt <= now))
+        {
+            e->retryAt = 0;
+            e->attempts++;
+            e->sending = true;
+            natsMutex_Unlock(w->mu);
+
+            s = _sendWriterEntry(w, seq, e->msg);
+
+            natsMutex_Lock(w->mu);
+            e->sending = false;
+            if ((s != NATS_OK) && !e->done)
+            {
+                e->err  = s;
+                e->done = true;
+            }
+            report = true;
+        }
+    }
+    if (!w->closed)
+        natsTimer_Reset(w->tmr, (w->head == w->next ? 60*60*1000 : w->tick));
+    natsMutex_Unlock(w->mu);
+
+    if (report)
+        _reportWriterResults(w);
+}
+
+natsStatus
+js_NewStreamWriter(jsStreamWriter **new_writer, jsCtx *js, jsStreamWriterOptions *opts)
+{
+    natsStatus      s       = NATS_OK;
+    jsStreamWriter  *w      = NULL;
+    natsConnection  *nc     = NULL;
+    char            *subj   = NULL;
+    char            inbox[NUID_BUFFER_LEN+1];
+
+    if ((new_writer == NULL) || (js == NULL))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    if ((opts != NULL)
+        && ((opts->MaxInFlight < 0) || (opts->MaxWait < 0) || (opts->RetryWait < 0)))
+    {
+        return nats_setError(NATS_INVALID_ARG, "%s", "stream writer options cannot be negative");
+    }
+
+    w = (jsStreamWriter*) NATS_CALLOC(1, sizeof(jsStreamWriter));
+    if (w == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    if (opts != NULL)
+        memcpy(&(w->opts), opts, sizeof(jsStreamWriterOptions));
+    if (w->opts.MaxInFlight == 0)
+        w->opts.MaxInFlight = 256;
+    if (w->opts.MaxWait == 0)
+        w->opts.MaxWait = js->opts.Wait;
+    if (w->opts.MaxRetries == 0)
+        w->opts.MaxRetries = 2;
+    if (w->opts.RetryWait == 0)
+        w->opts.RetryWait = 250;
+    // The timer takes care of both the retries and the deadlines.
+    w->tick = (w->opts.RetryWait < w->opts.MaxWait ? w->opts.RetryWait : w->opts.MaxWait);
+
+    js_retain(js);
+    w->js   = js;
+    w->refs = 1;
+    nc      = js->nc;
+
+    s = natsMutex_Create(&(w->mu));
+    IFOK(s, natsCondition_Create(&(w->cond)));
+    if (s == NATS_OK)
+    {
+        w->entries = (jsStreamWriterEntry*) NATS_CALLOC(w->opts.MaxInFlight, sizeof(jsStreamWriterEntry));
+        if (w->entries == NULL)
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    IFOK(s, natsNUID_Next(inbox, sizeof(inbox)));
+    if ((s == NATS_OK) && (nats_asprintf(&(w->replyPfx), "%s%.*s.",
+        nc->inboxPfx, NATS_RESP_PREFIX_LEN, (inbox + NUID_BUFFER_LEN-NATS_RESP_PREFIX_LEN)) < 0))
+    {
+        s = nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    if (s == NATS_OK)
+    {
+        w->replyPfxLen = (int) strlen(w->replyPfx);
+        if (nats_asprintf(&subj, "%s*", w->replyPfx) < 0)
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    if (s == NATS_OK)
+    {
+        w->refs++;
+        s = natsConn_subscribeNoPool(&(w->sub), nc, subj, _handleWriterReply, (void*) w);
+        if (s == NATS_OK)
+        {
+            natsSubscription_SetPendingLimits(w->sub, -1, -1);
+            natsSubscription_SetOnCompleteCB(w->sub, _releaseStreamWriter, (void*) w);
+        }
+        else
+            w->refs--;
+    }
+    NATS_FREE(subj);
+    if (s == NATS_OK)
+    {
+        w->refs++;
+        s = natsTimer_Create(&(w->tmr), _writerTimerCb, _releaseStreamWriterTimer, 60*60*1000, (void*) w);
+        if (s != NATS_OK)
+            w->refs--;
+    }
+
+    if (s == NATS_OK)
+        *new_writer = w;
+    else if ((w->mu == NULL) || (w->cond == NULL))
+        _freeStreamWriter(w); // nothing else refers to it yet
+    else
+        jsStreamWriter_Destroy(w);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+jsStreamWriter_Publish(jsStreamWriter *w, const char *subj, const void *data, int dataLen)
+{
+    natsStatus s;
+    natsMsg    *msg = NULL;
+
+    s = natsMsg_Create(&msg, subj, NULL, (const char*) data, dataLen);
+    IFOK(s, jsStreamWriter_PublishMsg(w, &msg));
+
+    // The `msg` pointer will have been set to NULL if the library took ownership.
+    natsMsg_Destroy(msg);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+jsStreamWriter_PublishMsg(jsStreamWriter *w, natsMsg **msg)
+{
+    natsStatus          s       = NATS_OK;
+    jsStreamWriterEntry *e      = NULL;
+    int64_t             target  = 0;
+    uint64_t            seq     = 0;
+
+    if ((w == NULL) || (msg == NULL) || (*msg == NULL) || nats_IsStringEmpty((*msg)->subject))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    natsMutex_Lock(w->mu);
+    target = nats_setTargetTime(w->opts.MaxWait);
+    while ((s != NATS_TIMEOUT) && !w->closed
+           && ((w->next - w->head) >= (uint64_t) w->opts.MaxInFlight))
+    {
+        s = natsCondition_AbsoluteTimedWait(w->cond, w->mu, target);
+    }
+    if (w->closed)
+        s = nats_setError(NATS_ILLEGAL_STATE, "%s", "stream writer destroyed");
+    else if (s == NATS_TIMEOUT)
+        s = nats_setError(s, "%s", "stalled with too many messages in flight");
+    if (s != NATS_OK)
+    {
+        natsMutex_Unlock(w->mu);
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+
+    seq = w->next++;
+    e = &(w->entries[seq % (uint64_t) w->opts.MaxInFlight]);
+    e->msg      = *msg;
+    e->deadline = nats_setTargetTime(w->opts.MaxWait);
+    e->attempts = 1;
+    e->sending  = true;
+    if (seq == w->head)
+        natsTimer_Reset(w->tmr, w->tick);
+    natsMutex_Unlock(w->mu);
+
+    s = _sendWriterEntry(w, seq, *msg);
+
+    natsMutex_Lock(w->mu);
+    e->sending = false;
+    if (s != NATS_OK)
+    {
+        // If this is still the last message, give it back to the user,
+        // otherwise it will be reported, in order, with this error.
+        if (!e->done && (seq == w->next-1))
+        {
+            memset(e, 0, sizeof(jsStreamWriterEntry));
+            w->next--;
+            natsCondition_Broadcast(w->cond);
+        }
+        else
+        {
+            if (!e->done)
+            {
+                e->err  = s;
+                e->done = true;
+            }
+            s = NATS_OK;
+            nats_clearLastError();
+        }
+    }
+    natsMutex_Unlock(w->mu);
+
+    if (s == NATS_OK)
+    {
+        *msg = NULL;
+        // The reply may have arrived while we were sending.
+        _reportWriterResults(w);
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+jsStreamWriter_Next(jsPubAck **new_puback, natsMsg **msg, jsStreamWriter *w,
+                    int64_t timeout, jsErrCode *errCode)
+{
+    natsStatus          s           = NATS_OK;
+    jsPubAck            *pa         = NULL;
+    int64_t             target      = 0;
+    char                errTxt[256] = {'\0'};
+    jsStreamWriterEntry e;
+    jsPubAckErr         pae;
+
+    if (errCode != NULL)
+        *errCode = 0;
+
+    if ((msg == NULL) || (w == NULL) || (timeout <= 0))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    *msg = NULL;
+    if (new_puback != NULL)
+        *new_puback = NULL;
+
+    if (w->opts.AckHandler != NULL)
+        return nats_setError(NATS_ILLEGAL_STATE, "%s", "results are reported to the ack handler");
+
+    natsMutex_Lock(w->mu);
+    if (w->head == w->next)
+    {
+        natsMutex_Unlock(w->mu);
+        return NATS_NOT_FOUND;
+    }
+    target = nats_setTargetTime(timeout);
+    while ((s != NATS_TIMEOUT) && !w->closed
+           && (!w->entries[w->head % (uint64_t) w->opts.MaxInFlight].done
+               || w->entries[w->head % (uint64_t) w->opts.MaxInFlight].sending))
+    {
+        s = natsCondition_AbsoluteTimedWait(w->cond, w->mu, target);
+    }
+    if (w->closed)
+        s = nats_setError(NATS_ILLEGAL_STATE, "%s", "stream writer destroyed");
+    if (s != NATS_OK)
+    {
+        natsMutex_Unlock(w->mu);
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+    e = w->entries[w->head % (uint64_t) w->opts.MaxInFlight];
+    memset(&(w->entries[w->head % (uint64_t) w->opts.MaxInFlight]), 0, sizeof(jsStreamWriterEntry));
+    w->head++;
+    natsCondition_Broadcast(w->cond);
+    natsMutex_Unlock(w->mu);
+
+    *msg = e.msg;
+    if (e.reply == NULL)
+    {
+        s = nats_setError(e.err, "%s", natsStatus_GetText(e.err));
+    }
+    else
+    {
+        if (new_puback != NULL)
+        {
+            pa = (jsPubAck*) NATS_CALLOC(1, sizeof(jsPubAck));
+            if (pa == NULL)
+                s = nats_setDefaultError(NATS_NO_MEMORY);
+        }
+        if ((s == NATS_OK) && (_parsePubAck(e.reply, pa, &pae, errTxt, sizeof(errTxt)) != NATS_OK))
+        {
+            if (errCode != NULL)
+                *errCode = pae.ErrCode;
+            s = nats_setError(pae.Err, "%s", errTxt);
+        }
+        if ((s == NATS_OK) && (new_puback != NULL))
+            *new_puback = pa;
+        else
+            jsPubAck_Destroy(pa);
+        natsMsg_Destroy(e.reply);
+    }
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+jsStreamWriter_Flush(jsStreamWriter *w, int64_t timeout)
+{
+    natsStatus  s       = NATS_OK;
+    int64_t     target  = 0;
+    uint64_t    seq     = 0;
+
+    if ((w == NULL) || (timeout <= 0))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    natsMutex_Lock(w->mu);
+    target = nats_setTargetTime(timeout);
+    while ((s != NATS_TIMEOUT) && !w->closed)
+    {
+        if (w->opts.AckHandler != NULL)
+        {
+            if ((w->head == w->next) && !w->reporting)
+                break;
+        }
+        else
+        {
+            for (seq=w->head; seq<w->next; seq++)
+            {
+                jsStreamWriterEntry *e = &(w->entries[seq % (uint64_t) w->opts.MaxInFlight]);
+
+                if (!e->done || e->sending)
+                    break;
+            }
+            if (seq == w->next)
+                break;
+        }
+        s = natsCondition_AbsoluteTimedWait(w->cond, w->mu, target);
+    }
+    if (w->closed)
+        s = nats_setError(NATS_ILLEGAL_STATE, "%s", "stream writer destroyed");
+    natsMutex_Unlock(w->mu);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+void
+jsStreamWriter_Destroy(jsStreamWriter *w)
+{
+    if (w == NULL)
+        return;
+
+    natsMutex_Lock(w->mu);
+    if (w->closed)
+    {
+        natsMutex_Unlock(w->mu);
+        return;
+    }
+    w->closed = true;
+    if (w->sub != NULL)
+        natsSubscription_Destroy(w->sub);
+    if (w->tmr != NULL)
+        natsTimer_Stop(w->tmr);
+    natsCondition_Broadcast(w->cond);
+    natsMutex_Unlock(w->mu);
+
+    _releaseStreamWriter((void*) w);
+}
@@ -29,6 +29,10 @@ void js_unlock(jsCtx *js);
 #endif // DEV_MODE
 
 #define NATS_DEFAULT_ASYNC_FETCH_SIZE 128 // messages
+#define NATS_DEFAULT_CONSUME_EXPIRES 30000 // ms
+#define NATS_DEFAULT_CONSUME_THRESHOLD 50 // percent
+#define NATS_DEFAULT_CONSUME_MAX_HEARTBEAT 30000 // ms
+#define NATS_CONSUME_BYTES_BATCH 1000000 // messages per request when driven by bytes
 
 extern const char*      jsDefaultAPIPrefix;
 extern const int64_t    jsDefaultRequestWait;
@@ -42,6 +46,8 @@ extern const int64_t    jsDefaultRequestWait;
 #define jsExpectedLastMsgIdHdr         "Nats-Expected-Last-Msg-Id"
 #define jsConsumerStalledHdr           "Nats-Consumer-Stalled"
 #define jsConsumerPinIDHdr             "Nats-Pin-Id"
+#define jsPendingMsgsHdr               "Nats-Pending-Messages"
+#define jsPendingBytesHdr              "Nats-Pending-Bytes"
 #define jsNatsBatchIdHdr               "Nats-Batch-Id"
 #define jsNatsBatchSequenceHdr         "Nats-Batch-Sequence"
 #define jsNatsBatchCommit              "Nats-Batch-Commit"
@@ -317,6 +323,9 @@ js_checkFetchedMsg(natsSubscription *sub, natsMsg *msg, uint64_t fetchID, bool c
 natsStatus
 js_maybeFetchMore(natsSubscription *sub, jsFetch *fetch);
 
+natsStatus
+js_checkConsumeStatus(natsSubscription *sub, jsFetch *fetch, natsMsg *msg, natsStatus fetchStatus, bool usrMsg);
+
 void
 js_setOnReleasedCb(jsCtx *js, js_onReleaseCb cb, void *arg);
 
@@ -1537,7 +1537,7 @@ kvStore_History(kvEntryList *list, kvStore *kv, const char *key, const kvWatchOp
     // On success, create the array of entries.
     if ((s == NATS_OK) && (n > 0))
     {
-        list->Entries = (kvEntry**) calloc(n, sizeof(kvEntry*));
+        list->Entries = (kvEntry**) NATS_CALLOC(n, sizeof(kvEntry*));
         if (list->Entries == NULL)
             s = nats_setDefaultError(NATS_NO_MEMORY);
         else
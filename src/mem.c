@@ -0,0 +1,106 @@
+// Copyright 2026 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "natsp.h"
+
+#include <string.h>
+
+#include "mem.h"
+#include "glib/glib.h"
+
+natsAllocator nats_allocator = { malloc, calloc, realloc, free, false };
+
+static struct
+{
+    uint64_t    allocs;
+    uint64_t    bytes;
+
+} _allocStats[NATS_ALLOC_CATEGORIES];
+
+void
+nats_memCount(natsAllocCategory category, size_t size)
+{
+    nats_atomicAdd64(&(_allocStats[category].allocs), 1);
+    nats_atomicAdd64(&(_allocStats[category].bytes), (uint64_t) size);
+}
+
+char*
+nats_memStrdup(natsAllocCategory category, const char *str)
+{
+    char    *dup;
+    size_t  len = strlen(str) + 1;
+
+    dup = (char*) nats_memMalloc(category, len);
+    if (dup != NULL)
+        memcpy(dup, str, len);
+
+    return dup;
+}
+
+natsStatus
+nats_SetAllocator(natsMallocHandler mallocCb, natsCallocHandler callocCb,
+                  natsReallocHandler reallocCb, natsFreeHandler freeCb)
+{
+    bool allNull = ((mallocCb == NULL) && (callocCb == NULL)
+                    && (reallocCb == NULL) && (freeCb == NULL));
+
+    // This is invoked before the library is opened, so the error is not
+    // recorded with nats_setError(), which requires the library's thread
+    // local storage (and would allocate memory).
+    if (!allNull
+        && ((mallocCb == NULL) || (callocCb == NULL)
+            || (reallocCb == NULL) || (freeCb == NULL)))
+    {
+        return NATS_INVALID_ARG;
+    }
+
+    // Memory allocated with one allocator can't be released with another,
+    // so the allocator can't be changed once the library has been opened.
+    if (nats_wasLibOpened())
+        return NATS_ILLEGAL_STATE;
+
+    if (allNull)
+    {
+        mallocCb  = malloc;
+        callocCb  = calloc;
+        reallocCb = realloc;
+        freeCb    = free;
+    }
+    nats_allocator.mallocCb  = mallocCb;
+    nats_allocator.callocCb  = callocCb;
+    nats_allocator.reallocCb = reallocCb;
+    nats_allocator.freeCb    = freeCb;
+
+    return NATS_OK;
+}
+
+void
+nats_SetAllocStatsEnabled(bool enabled)
+{
+    nats_allocator.trackStats = enabled;
+}
+
+natsStatus
+nats_GetAllocStats(natsAllocCategory category, uint64_t *allocs, uint64_t *bytes)
+{
+    // Not using nats_setDefaultError() since the library may not be opened.
+    if (((int) category < 0) || ((int) category >= NATS_ALLOC_CATEGORIES))
+        return NATS_INVALID_ARG;
+
+    if (allocs != NULL)
+        *allocs = nats_atomicLoad64(&(_allocStats[category].allocs));
+    if (bytes != NULL)
+        *bytes = nats_atomicLoad64(&(_allocStats[category].bytes));
+
+    return NATS_OK;
+}
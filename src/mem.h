@@ -16,16 +16,74 @@
 
 #include <stdlib.h>
 
-#define NATS_MALLOC(s)      malloc((s))
-#define NATS_CALLOC(c,s)    calloc((c), (s))
-#define NATS_REALLOC(p, s)  realloc((p), (s))
-
-#ifdef _WIN32
-#define NATS_STRDUP(s)      _strdup((s))
-#else
-#define NATS_STRDUP(s)      strdup((s))
+#include "nats.h"
+
+#define NATS_ALLOC_CATEGORIES   (natsAlloc_JSON + 1)
+
+typedef struct __natsAllocator
+{
+    natsMallocHandler   mallocCb;
+    natsCallocHandler   callocCb;
+    natsReallocHandler  reallocCb;
+    natsFreeHandler     freeCb;
+    volatile bool       trackStats;
+
+} natsAllocator;
+
+extern natsAllocator nats_allocator;
+
+void  nats_memCount(natsAllocCategory category, size_t size);
+char *nats_memStrdup(natsAllocCategory category, const char *str);
+
+static inline void*
+nats_memMalloc(natsAllocCategory category, size_t size)
+{
+    void *ptr = nats_allocator.mallocCb(size);
+
+    if ((ptr != NULL) && nats_allocator.trackStats)
+        nats_memCount(category, size);
+    return ptr;
+}
+
+static inline void*
+nats_memCalloc(natsAllocCategory category, size_t count, size_t size)
+{
+    void *ptr = nats_allocator.callocCb(count, size);
+
+    if ((ptr != NULL) && nats_allocator.trackStats)
+        nats_memCount(category, count * size);
+    return ptr;
+}
+
+static inline void*
+nats_memRealloc(natsAllocCategory category, void *ptr, size_t size)
+{
+    void *newPtr = nats_allocator.reallocCb(ptr, size);
+
+    if ((newPtr != NULL) && nats_allocator.trackStats)
+        nats_memCount(category, size);
+    return newPtr;
+}
+
+static inline void
+nats_memFree(void *ptr)
+{
+    if (ptr != NULL)
+        nats_allocator.freeCb(ptr);
+}
+
+// Allocations are attributed to NATS_MEM_CATEGORY, which a source file
+// can define (before including this header) to account for its allocations
+// under a given natsAllocCategory.
+#ifndef NATS_MEM_CATEGORY
+#define NATS_MEM_CATEGORY   natsAlloc_Other
 #endif
-#define NATS_FREE(p)        free((p))
+
+#define NATS_MALLOC(s)      nats_memMalloc(NATS_MEM_CATEGORY, (s))
+#define NATS_CALLOC(c,s)    nats_memCalloc(NATS_MEM_CATEGORY, (c), (s))
+#define NATS_REALLOC(p, s)  nats_memRealloc(NATS_MEM_CATEGORY, (p), (s))
+#define NATS_STRDUP(s)      nats_memStrdup(NATS_MEM_CATEGORY, (s))
+#define NATS_FREE(p)        nats_memFree((void*) (p))
 
 // **Note** does not free the array itself.
 static void NATS_FREE_STRINGS(char **strings, int count)
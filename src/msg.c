@@ -11,6 +11,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+// Allocations made in this file are accounted as message allocations.
+#define NATS_MEM_CATEGORY   natsAlloc_Msgs
+
 #include "natsp.h"
 
 // Do this after including natsp.h in order to have some of the
@@ -686,6 +689,320 @@ natsMsg_freeHeaders(natsMsg *msg)
     natsStrHash_Destroy(msg->headers);
 }
 
+// Blocks are taken only by the connection's reading thread, from the 'free'
+// lists that no other thread accesses. Any thread gives blocks back, without
+// a lock, by pushing them on the 'returned' lists, which the reading thread
+// moves in full to its 'free' list when that one is empty. The counters are
+// updated atomically.
+struct __natsMsgPool
+{
+    natsMsg     *free[MSG_POOL_NUM_CLASSES];
+    natsMsg     *returned[MSG_POOL_NUM_CLASSES];
+    int         refs;
+    int         closed;
+    int64_t     retained;
+    int64_t     maxBytes;
+    uint64_t    hits;
+    uint64_t    misses;
+
+};
+
+#define _msgPoolClassSize(i)    (1 << (MSG_POOL_MIN_CLASS_SHIFT + (i)))
+
+static void
+_freePoolList(natsMsg *msg)
+{
+    natsMsg *next;
+
+    for (; msg != NULL; msg = next)
+    {
+        next = msg->next;
+        NATS_FREE(msg);
+    }
+}
+
+// Must not be invoked concurrently with _msgPoolGet().
+static void
+_freePoolBlocks(natsMsgPool *pool)
+{
+    int i;
+
+    for (i=0; i<MSG_POOL_NUM_CLASSES; i++)
+    {
+        _freePoolList(pool->free[i]);
+        pool->free[i] = NULL;
+        _freePoolList((natsMsg*) nats_atomicExchangePtr(&(pool->returned[i]), NULL));
+    }
+}
+
+natsStatus
+natsMsgPool_Create(natsMsgPool **newPool, int64_t maxBytes)
+{
+    natsMsgPool *pool = NULL;
+
+    pool = (natsMsgPool*) NATS_CALLOC(1, sizeof(natsMsgPool));
+    if (pool == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    pool->refs      = 1;
+    pool->maxBytes  = maxBytes;
+
+    *newPool = pool;
+
+    return NATS_OK;
+}
+
+void
+natsMsgPool_GetStats(natsMsgPool *pool, uint64_t *hits, uint64_t *misses,
+                     int64_t *retained)
+{
+    if (hits != NULL)
+        *hits = nats_atomicLoad64(&(pool->hits));
+    if (misses != NULL)
+        *misses = nats_atomicLoad64(&(pool->misses));
+    if (retained != NULL)
+        *retained = (int64_t) nats_atomicLoad64(&(pool->retained));
+}
+
+static void
+_msgPoolRelease(natsMsgPool *pool)
+{
+    if (nats_atomicAddInt(&(pool->refs), -1) > 0)
+        return;
+
+    // Blocks returned after the pool was closed are freed here.
+    _freePoolBlocks(pool);
+    NATS_FREE(pool);
+}
+
+void
+natsMsgPool_Release(natsMsgPool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    nats_atomicStoreInt(&(pool->closed), 1);
+    _freePoolBlocks(pool);
+    _msgPoolRelease(pool);
+}
+
+// Returns a memory block of at least 'size' bytes, taken from the pool
+// if possible. On success, 'idx' is the size class of the block, or -1
+// if the block was not allocated for the pool. Must be invoked by the
+// connection's reading thread only.
+static natsMsg*
+_msgPoolGet(natsMsgPool *pool, int size, int *idx)
+{
+    natsMsg *msg = NULL;
+    int     i;
+
+    for (i=0; (i<MSG_POOL_NUM_CLASSES) && (_msgPoolClassSize(i) < size); i++);
+
+    if (i == MSG_POOL_NUM_CLASSES)
+    {
+        // Too big to be pooled.
+        nats_atomicAdd64(&(pool->misses), 1);
+        *idx = -1;
+        return (natsMsg*) NATS_MALLOC(size);
+    }
+    if (pool->free[i] == NULL)
+        pool->free[i] = (natsMsg*) nats_atomicExchangePtr(&(pool->returned[i]), NULL);
+
+    if ((msg = pool->free[i]) != NULL)
+    {
+        pool->free[i] = msg->next;
+        nats_atomicAdd64(&(pool->retained), -_msgPoolClassSize(i));
+        nats_atomicAdd64(&(pool->hits), 1);
+    }
+    else
+    {
+        nats_atomicAdd64(&(pool->misses), 1);
+        msg = (natsMsg*) NATS_MALLOC(_msgPoolClassSize(i));
+        if (msg == NULL)
+            return NULL;
+    }
+    nats_atomicAddInt(&(pool->refs), 1);
+    *idx = i;
+
+    return msg;
+}
+
+// Returns the message memory block to its pool, or frees it if the pool
+// is closed or the limit of retained memory would be exceeded. Concurrent
+// returns may exceed that limit by a few blocks.
+static void
+_msgPoolPut(natsMsg *msg)
+{
+    natsMsgPool *pool = msg->pool;
+    int         i     = msg->poolIdx;
+    int64_t     size  = _msgPoolClassSize(i);
+    natsMsg     *head = NULL;
+
+    if (!nats_atomicLoadInt(&(pool->closed))
+        && ((int64_t) nats_atomicLoad64(&(pool->retained)) + size <= pool->maxBytes))
+    {
+        nats_atomicAdd64(&(pool->retained), size);
+        do
+        {
+            head = (natsMsg*) nats_atomicLoadPtr(&(pool->returned[i]));
+            msg->next = head;
+        }
+        while (!nats_atomicCasPtr(&(pool->returned[i]), head, msg));
+        msg = NULL;
+    }
+    _msgPoolRelease(pool);
+
+    NATS_FREE(msg);
+}
+
+struct __natsReadChunkPool
+{
+    natsMutex       *mu;
+    int             refs;
+    bool            closed;
+    natsReadChunk   *free;
+    int             numFree;
+
+};
+
+static void
+_freeChunkPoolChunks(natsReadChunkPool *pool)
+{
+    natsReadChunk *chunk;
+
+    while ((chunk = pool->free) != NULL)
+    {
+        pool->free = chunk->next;
+        NATS_FREE(chunk);
+    }
+    pool->numFree = 0;
+}
+
+natsStatus
+natsReadChunkPool_Create(natsReadChunkPool **newPool)
+{
+    natsStatus          s     = NATS_OK;
+    natsReadChunkPool   *pool = NULL;
+
+    pool = (natsReadChunkPool*) NATS_CALLOC(1, sizeof(natsReadChunkPool));
+    if (pool == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    s = natsMutex_Create(&(pool->mu));
+    if (s != NATS_OK)
+    {
+        NATS_FREE(pool);
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+    pool->refs = 1;
+
+    *newPool = pool;
+
+    return NATS_OK;
+}
+
+// Pool lock held on entry, released on exit.
+static void
+_chunkPoolUnlockAndRelease(natsReadChunkPool *pool)
+{
+    int refs = --(pool->refs);
+
+    natsMutex_Unlock(pool->mu);
+
+    if (refs == 0)
+    {
+        _freeChunkPoolChunks(pool);
+        natsMutex_Destroy(pool->mu);
+        NATS_FREE(pool);
+    }
+}
+
+void
+natsReadChunkPool_Release(natsReadChunkPool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    natsMutex_Lock(pool->mu);
+    pool->closed = true;
+    _freeChunkPoolChunks(pool);
+    _chunkPoolUnlockAndRelease(pool);
+}
+
+natsStatus
+natsReadChunkPool_Get(natsReadChunkPool *pool, int size, natsReadChunk **newChunk)
+{
+    natsReadChunk *chunk = NULL;
+
+    natsMutex_Lock(pool->mu);
+    if ((chunk = pool->free) != NULL)
+    {
+        pool->free = chunk->next;
+        pool->numFree--;
+    }
+    pool->refs++;
+    natsMutex_Unlock(pool->mu);
+
+    // The read buffer has been resized.
+    if ((chunk != NULL) && (chunk->size != size))
+    {
+        NATS_FREE(chunk);
+        chunk = NULL;
+    }
+    if (chunk == NULL)
+    {
+        chunk = (natsReadChunk*) NATS_MALLOC(sizeof(natsReadChunk) + size);
+        if (chunk == NULL)
+        {
+            natsMutex_Lock(pool->mu);
+            _chunkPoolUnlockAndRelease(pool);
+            return nats_setDefaultError(NATS_NO_MEMORY);
+        }
+    }
+    chunk->pool = pool;
+    chunk->refs = 1;
+    chunk->size = size;
+    chunk->next = NULL;
+
+    *newChunk = chunk;
+
+    return NATS_OK;
+}
+
+void
+natsReadChunk_Retain(natsReadChunk *chunk)
+{
+    nats_atomicAddInt(&(chunk->refs), 1);
+}
+
+bool
+natsReadChunk_IsShared(natsReadChunk *chunk)
+{
+    return (nats_atomicLoadInt(&(chunk->refs)) > 1);
+}
+
+void
+natsReadChunk_Release(natsReadChunk *chunk)
+{
+    natsReadChunkPool *pool;
+
+    if ((chunk == NULL) || (nats_atomicAddInt(&(chunk->refs), -1) > 0))
+        return;
+
+    pool = chunk->pool;
+    natsMutex_Lock(pool->mu);
+    if (!pool->closed && (pool->numFree < READ_CHUNK_POOL_MAX_FREE))
+    {
+        chunk->next = pool->free;
+        pool->free = chunk;
+        pool->numFree++;
+        chunk = NULL;
+    }
+    _chunkPoolUnlockAndRelease(pool);
+
+    NATS_FREE(chunk);
+}
+
 void
 natsMsg_free(void *object)
 {
@@ -696,8 +1013,12 @@ natsMsg_free(void *object)
 
     msg = (natsMsg*) object;
     natsMsg_freeHeaders(msg);
+    natsReadChunk_Release(msg->chunk);
 
-    NATS_FREE(msg);
+    if (msg->pool != NULL)
+        _msgPoolPut(msg);
+    else
+        NATS_FREE(msg);
 }
 
 void
@@ -769,33 +1090,72 @@ natsMsg_GetTime(natsMsg *msg)
     return msg->time;
 }
 
-natsStatus
-natsMsg_createWithPadding(natsMsg **newMsg,
-               const char *subject, int subjLen,
-               const char *reply, int replyLen,
-               const char *buf, int bufLen, int bufPaddingSize, int hdrLen)
+// Returns true if the 'len' bytes at 'ptr', and the byte that follows,
+// are within the first 'chunkLen' bytes of the chunk's data.
+static bool
+_inChunk(natsReadChunk *chunk, int chunkLen, const char *ptr, int len)
+{
+    const char *data = natsReadChunk_Data(chunk);
+
+    return ((ptr >= data) && (ptr + len < data + chunkLen));
+}
+
+static natsStatus
+_createMsg(natsMsg **newMsg, natsMsgPool *pool,
+           natsReadChunk *chunk, int chunkLen,
+           const char *subject, int subjLen,
+           const char *reply, int replyLen,
+           const char *buf, int bufLen, int bufPaddingSize, int hdrLen)
 {
     natsMsg     *msg      = NULL;
     char        *ptr      = NULL;
+    int         poolIdx   = -1;
     int         bufSize   = 0;
     int         dataLen   = bufLen;
     bool        hasHdrs   = (hdrLen > 0 ? true : false);
     // Make payload a null-terminated string and add at least one zero byte to the end
     int         padLen    = (bufPaddingSize > 0 ? bufPaddingSize : 1);
+    // What can be referenced in the read chunk instead of being copied.
+    bool        subjRef   = false;
+    bool        replyRef  = false;
+    bool        dataRef   = false;
 
-    bufSize  = subjLen;
-    bufSize += 1;
-    if (replyLen > 0)
+    if (chunk != NULL)
+    {
+        subjRef  = _inChunk(chunk, chunkLen, subject, subjLen);
+        replyRef = ((replyLen > 0) && _inChunk(chunk, chunkLen, reply, replyLen));
+        // Padding can't be provided without a copy.
+        dataRef  = ((bufPaddingSize <= 0) && _inChunk(chunk, chunkLen, buf, bufLen));
+        if (!subjRef && !replyRef && !dataRef)
+            chunk = NULL;
+    }
+
+    bufSize = 0;
+    if (!subjRef)
+    {
+        bufSize += subjLen;
+        bufSize += 1;
+    }
+    if ((replyLen > 0) && !replyRef)
     {
         bufSize += replyLen;
         bufSize += 1;
     }
-    bufSize += bufLen;
-    bufSize += padLen;
     if (hasHdrs)
+    {
+        bufSize += hdrLen;
         bufSize++;
+    }
+    if (!dataRef)
+    {
+        bufSize += bufLen - hdrLen;
+        bufSize += padLen;
+    }
 
-    msg = NATS_MALLOC(sizeof(natsMsg) + bufSize);
+    if (pool != NULL)
+        msg = _msgPoolGet(pool, (int) sizeof(natsMsg) + bufSize, &poolIdx);
+    else
+        msg = NATS_MALLOC(sizeof(natsMsg) + bufSize);
     if (msg == NULL)
         return nats_setDefaultError(NATS_NO_MEMORY);
 
@@ -816,15 +1176,34 @@ natsMsg_createWithPadding(natsMsg **newMsg,
     msg->next       = NULL;
     msg->seq        = 0;
     msg->time       = 0;
+    msg->pool       = (poolIdx >= 0 ? pool : NULL);
+    msg->poolIdx    = poolIdx;
+    msg->chunk      = chunk;
+
+    if (chunk != NULL)
+        natsReadChunk_Retain(chunk);
 
     ptr = (char*) (((char*) &(msg->next)) + sizeof(msg->next));
 
-    msg->subject = (const char*) ptr;
-    memcpy(ptr, subject, subjLen);
-    ptr += subjLen;
-    *(ptr++) = '\0';
+    if (subjRef)
+    {
+        msg->subject = subject;
+        ((char*) subject)[subjLen] = '\0';
+    }
+    else
+    {
+        msg->subject = (const char*) ptr;
+        memcpy(ptr, subject, subjLen);
+        ptr += subjLen;
+        *(ptr++) = '\0';
+    }
 
-    if (replyLen > 0)
+    if (replyRef)
+    {
+        msg->reply = reply;
+        ((char*) reply)[replyLen] = '\0';
+    }
+    else if (replyLen > 0)
     {
         msg->reply = (const char*) ptr;
         memcpy(ptr, reply, replyLen);
@@ -851,26 +1230,68 @@ natsMsg_createWithPadding(natsMsg **newMsg,
         natsMsg_setNeedsLift(msg);
         dataLen -= hdrLen;
     }
-    msg->data    = (const char*) ptr;
+    if (dataRef)
+    {
+        msg->data = buf;
+        ((char*) buf)[dataLen] = '\0';
+    }
+    else
+    {
+        msg->data = (const char*) ptr;
+        if (buf != NULL)
+            memcpy(ptr, buf, dataLen);
+        ptr += dataLen;
+        memset(ptr, 0, padLen);
+    }
     msg->dataLen = dataLen;
-    if (buf != NULL)
-        memcpy(ptr, buf, dataLen);
-    ptr += dataLen;
-    memset(ptr, 0, padLen);
     // This is essentially to match server's view of a message size
     // when sending messages to pull consumers and keeping track
     // of size in regards to a max_bytes setting.
     msg->wsz = subjLen + replyLen + bufLen;
 
     // Setting the callback will trigger garbage collection when
-    // natsMsg_Destroy() is invoked.
-    msg->gc.freeCb = natsMsg_free;
+    // natsMsg_Destroy() is invoked. Pooled messages are returned to
+    // their pool directly from natsMsg_Destroy() instead.
+    if (msg->pool == NULL)
+        msg->gc.freeCb = natsMsg_free;
 
     *newMsg = msg;
 
     return NATS_OK;
 }
 
+natsStatus
+natsMsg_createWithPadding(natsMsg **newMsg,
+               const char *subject, int subjLen,
+               const char *reply, int replyLen,
+               const char *buf, int bufLen, int bufPaddingSize, int hdrLen)
+{
+    return _createMsg(newMsg, NULL, NULL, 0, subject, subjLen, reply, replyLen,
+                      buf, bufLen, bufPaddingSize, hdrLen);
+}
+
+natsStatus
+natsMsg_createFromPool(natsMsg **newMsg, natsMsgPool *pool,
+                       const char *subject, int subjLen,
+                       const char *reply, int replyLen,
+                       const char *buf, int bufLen, int bufPaddingSize,
+                       int hdrLen)
+{
+    return _createMsg(newMsg, pool, NULL, 0, subject, subjLen, reply, replyLen,
+                      buf, bufLen, bufPaddingSize, hdrLen);
+}
+
+natsStatus
+natsMsg_createFromChunk(natsMsg **newMsg, natsMsgPool *pool,
+                        natsReadChunk *chunk, int chunkLen,
+                        const char *subject, int subjLen,
+                        const char *reply, int replyLen,
+                        const char *buf, int bufLen, int hdrLen)
+{
+    return _createMsg(newMsg, pool, chunk, chunkLen, subject, subjLen,
+                      reply, replyLen, buf, bufLen, 0, hdrLen);
+}
+
 natsStatus
 natsMsg_create(natsMsg **newMsg,
                const char *subject, int subjLen,
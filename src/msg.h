@@ -51,6 +51,34 @@
 
 #define natsMsg_dataAndHdrLen(m)    ((m)->dataLen + (m)->hdrLen)
 
+// Size classes of the message pool: memory blocks (natsMsg structure
+// plus headers/payload) from 256 bytes to 64KB.
+#define MSG_POOL_MIN_CLASS_SHIFT    (8)
+#define MSG_POOL_NUM_CLASSES        (9)
+
+typedef struct __natsMsgPool natsMsgPool;
+
+// Maximum number of free read chunks a pool keeps for reuse.
+#define READ_CHUNK_POOL_MAX_FREE    (8)
+
+typedef struct __natsReadChunkPool natsReadChunkPool;
+
+// A reference counted buffer the read loop reads into. Messages created
+// from a chunk point to their subject, reply and payload in the chunk,
+// and hold a reference until they are destroyed.
+typedef struct __natsReadChunk
+{
+    natsReadChunkPool       *pool;
+    int                     refs;
+    int                     size;
+    struct __natsReadChunk  *next;
+
+    // Nothing after this: the chunk data goes there.
+
+} natsReadChunk;
+
+#define natsReadChunk_Data(c)       ((char*) ((c) + 1))
+
 struct __natsMsg
 {
     natsGCItem          gc;
@@ -75,6 +103,14 @@ struct __natsMsg
     // or for JetStream).
     struct __natsSubscription *sub;
 
+    // If not NULL, the pool this message's memory block will be
+    // returned to, and the index of its size class.
+    natsMsgPool         *pool;
+    int                 poolIdx;
+
+    // If not NULL, the read chunk this message points into.
+    natsReadChunk       *chunk;
+
     // Must be last field!
     struct __natsMsg    *next;
 
@@ -116,6 +152,74 @@ natsMsg_createWithPadding(natsMsg **newMsg,
                           const char *buf, int bufLen, int bufPaddingSize,
                           int hdrLen);
 
+// Same as natsMsg_createWithPadding() but the memory block is taken from
+// the given pool, if possible. The message will return its memory block
+// to the pool when destroyed.
+natsStatus
+natsMsg_createFromPool(natsMsg **newMsg, natsMsgPool *pool,
+                       const char *subject, int subjLen,
+                       const char *reply, int replyLen,
+                       const char *buf, int bufLen, int bufPaddingSize,
+                       int hdrLen);
+
+// Creates a pool of message memory blocks, organized in size classes.
+// The pool will not retain (much) more than 'maxBytes' of memory. Messages
+// can be created from a single thread only, but destroyed from any thread.
+natsStatus
+natsMsgPool_Create(natsMsgPool **newPool, int64_t maxBytes);
+
+// Gets the number of allocations served from the pool (hits), the
+// number that required a memory allocation (misses) and the amount
+// of memory currently retained by the pool.
+void
+natsMsgPool_GetStats(natsMsgPool *pool, uint64_t *hits, uint64_t *misses,
+                     int64_t *retained);
+
+// Releases the owner's reference. The memory retained by the pool is
+// freed, and the pool itself is freed when the last message created
+// from it is destroyed.
+void
+natsMsgPool_Release(natsMsgPool *pool);
+
+// Same as natsMsg_createFromPool() (the pool can be NULL) but the subject,
+// reply and payload are not copied if they are within the first 'chunkLen'
+// bytes of the chunk's data. The byte following each of them is then
+// overwritten with a '\0', so the caller must have consumed it already.
+// The message holds a reference on the chunk until destroyed. Headers are
+// always copied.
+natsStatus
+natsMsg_createFromChunk(natsMsg **newMsg, natsMsgPool *pool,
+                        natsReadChunk *chunk, int chunkLen,
+                        const char *subject, int subjLen,
+                        const char *reply, int replyLen,
+                        const char *buf, int bufLen, int hdrLen);
+
+// Creates a pool of read chunks.
+natsStatus
+natsReadChunkPool_Create(natsReadChunkPool **newPool);
+
+// Returns a chunk of 'size' bytes, taken from the pool if possible, with
+// a reference count of 1. Free chunks of a different size are discarded.
+natsStatus
+natsReadChunkPool_Get(natsReadChunkPool *pool, int size, natsReadChunk **chunk);
+
+// Releases the owner's reference. The free chunks are freed, and the
+// pool itself is freed when the last chunk is released.
+void
+natsReadChunkPool_Release(natsReadChunkPool *pool);
+
+void
+natsReadChunk_Retain(natsReadChunk *chunk);
+
+// Returns true if someone other than the caller holds a reference.
+bool
+natsReadChunk_IsShared(natsReadChunk *chunk);
+
+// Releases a reference, returning the chunk to its pool if that was
+// the last one.
+void
+natsReadChunk_Release(natsReadChunk *chunk);
+
 natsStatus
 natsHeaderValue_create(natsHeaderValue **retV, const char *value, bool makeCopy);
 
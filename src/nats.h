@@ -171,6 +171,14 @@ typedef struct __natsSubscription   natsSubscription;
  */
 typedef struct __natsMsg            natsMsg;
 
+/** \brief A publisher prepared for a given subject.
+ *
+ * A #natsPublisher is created with #natsConnection_PreparePublisher and
+ * publishes messages on a single subject, without having to encode the
+ * subject for each message.
+ */
+typedef struct __natsPublisher      natsPublisher;
+
 /** \brief Way to configure a #natsConnection.
  *
  * Options can be used to create a customized #natsConnection.
@@ -221,6 +229,33 @@ typedef struct __natsClientConfig
         natsThreadStartedHandler    ThreadStartedHandler;
         void                        *ThreadStartedHandlerClosure;
 
+        // Number of threads firing the library's internal timers (such as
+        // connection PINGs, subscription timeouts, JetStream heartbeat
+        // checks). Each thread has its own lock, and timers are spread
+        // between them, timers of a given connection or subscription always
+        // firing from the same thread. Defaults to 1 when 0 or negative.
+        int TimerThreads;
+
+        // Number of threads performing the socket I/O of connections through
+        // io_uring (Linux only). When greater than 0, connections that are
+        // not attached to an user event loop are spread between these threads
+        // instead of each having its own read loop and flusher threads. If
+        // io_uring is not available, connections use their own threads.
+        // Options specific to those threads (such as the read buffer limits,
+        // read batching, zero copy messages or the write deadline) have no
+        // effect on the connections serviced by the io_uring threads.
+        int IOUringThreads;
+
+        // Number of threads of the library's I/O pool (Linux only), each
+        // servicing the socket reads and flushes of many connections through
+        // epoll. When greater than 0, connections that are not attached to
+        // an user event loop nor to an io_uring thread (see `IOUringThreads`)
+        // are spread between these threads instead of each having its own
+        // read loop and flusher threads. As for the io_uring threads, the
+        // options specific to the connection's own threads have no effect on
+        // the connections serviced by the pool.
+        int IOThreadPoolSize;
+
 } natsClientConfig;
 
 /** \brief A list of NATS messages.
@@ -285,6 +320,12 @@ typedef struct __jsCtx                  jsCtx;
  */
 typedef struct __jsAtomicBatchCtx       jsAtomicBatchCtx;
 
+/**
+ * The JetStream stream writer. Use to publish messages with many of them
+ * in flight while getting their acknowledgments in publish order.
+ */
+typedef struct __jsStreamWriter         jsStreamWriter;
+
 /**
  * Options for scheduled jetstream messages; sent as part of #jsPubOptions.
  *
@@ -337,6 +378,21 @@ typedef struct jsPubOptions
 
 } jsPubOptions;
 
+/**
+ * The subsystems to which the library's memory allocations are attributed.
+ *
+ * @see nats_GetAllocStats()
+ */
+typedef enum
+{
+        natsAlloc_Other = 0,    ///< Allocations that do not belong to any of the other categories.
+        natsAlloc_Msgs,         ///< Allocations of messages.
+        natsAlloc_Buffers,      ///< Allocations of internal buffers (protocol, outbound data, etc..).
+        natsAlloc_Hashes,       ///< Allocations of internal hash maps.
+        natsAlloc_JSON,         ///< Allocations made while parsing JSON documents.
+
+} natsAllocCategory;
+
 /**
  * Determines how messages in a set are retained.
  */
@@ -1088,6 +1144,27 @@ typedef struct jsSubOptions
          * the heartbeats value can be overridden in the consumer configuration.
          */
         bool                    Ordered;        ///< If true, this will be an ordered consumer.
+        /**
+         * If greater than 1, asynchronous acknowledgments (#natsMsg_Ack, or
+         * the automatic acknowledgment done after an asynchronous callback
+         * returns) are not sent right away but buffered in the subscription
+         * and sent together once this many have been accumulated, or after
+         * `AckBatchInterval`, whichever comes first.
+         *
+         * When the consumer's acknowledgment policy is #js_AckAll, only the
+         * acknowledgment of the highest consumer sequence is sent.
+         *
+         * Buffered acknowledgments are sent before any other kind of
+         * acknowledgment (#natsMsg_AckSync, #natsMsg_Nak, #natsMsg_InProgress,
+         * #natsMsg_Term) of the same subscription so that ordering is preserved,
+         * and when the subscription is unsubscribed, drained or destroyed.
+         *
+         * \note If the connection is closed while acknowledgments are still
+         * buffered, they are lost and the server will redeliver those messages
+         * after the consumer's `AckWait`.
+         */
+        int                     AckBatchSize;   ///< Number of asynchronous acks to accumulate before sending them.
+        int64_t                 AckBatchInterval; ///< Maximum time, in milliseconds, an ack stays buffered. Defaults to 100.
 
 } jsSubOptions;
 
@@ -1303,12 +1380,49 @@ typedef struct jsPubAckErr
 
 } jsPubAckErr;
 
+/**
+ * Statistics of the asynchronous publishes of a #jsCtx, returned by
+ * #js_PublishAsyncGetStats.
+ */
+typedef struct jsPublishAsyncStats
+{
+        int64_t         Pending;        ///< Number of asynchronous publishes waiting for their acknowledgment.
+        int64_t         MaxPending;     ///< Current limit of asynchronous publishes in flight, 0 if there is none.
+        int64_t         RTT;            ///< Smoothed acknowledgment round trip time, in nanoseconds.
+        int64_t         MinRTT;         ///< Lowest acknowledgment round trip time of the last 10 to 20 seconds, in nanoseconds.
+        uint64_t        Stalls;         ///< Number of publish calls that had to wait for acknowledgments.
+        uint64_t        Decreases;      ///< Number of times the limit has been reduced (see jsOptionsPublishAsync.AdaptiveMaxPending).
+
+} jsPublishAsyncStats;
+
 #ifndef BUILD_IN_DOXYGEN
 // Forward declarations
 typedef void (*jsPubAckErrHandler)(jsCtx *js, jsPubAckErr *pae, void *closure);
 typedef void (*jsPubAckHandler)(jsCtx *js, natsMsg *msg, jsPubAck *pa, jsPubAckErr *pae, void *closure);
 #endif
 
+/**
+ * Options for a #jsStreamWriter, created with #js_NewStreamWriter.
+ *
+ * Initialize the object with #jsStreamWriterOptions_Init.
+ */
+typedef struct jsStreamWriterOptions
+{
+        int                     MaxInFlight;            ///< Maximum number of messages published and not yet reported, default is 256.
+        int64_t                 MaxWait;                ///< Amount of time (in milliseconds) to wait for the acknowledgment of a message,
+                                                        ///  or for room in a publish call, default is the context's Wait value.
+        int                     MaxRetries;             ///< Number of times a message is resent when there is no responder, default is 2.
+                                                        ///  Use a negative value to disable retries.
+        int64_t                 RetryWait;              ///< Amount of time (in milliseconds) to wait before resending a message, default is 250 ms.
+
+        // If AckHandler is specified, the callback is invoked for every
+        // published message, in publish order. Otherwise, the results
+        // are obtained, in the same order, with jsStreamWriter_Next().
+        jsPubAckHandler         AckHandler;             ///< Callback invoked, in publish order, for each published message.
+        void                    *AckHandlerClosure;     ///< Closure (or user data) passed to #jsPubAckHandler callback.
+
+} jsStreamWriterOptions;
+
 /**
  * Options for the js_DirectGetMsg() call, which retrieves a message
  * from any server (not only the leader) as long as the stream has
@@ -1458,6 +1572,46 @@ typedef struct jsOptionsPullSubscribeAsync
         jsFetchNextHandler      NextHandler;
         void                    *NextHandlerClosure;
 
+        /// @brief If set, the subscription continuously pulls messages
+        /// ("consume" mode) instead of fulfilling a single fetch.
+        ///
+        /// Up to `FetchSize` messages (or `FetchMaxBytes` bytes if set) are
+        /// requested. As soon as the number of messages (or bytes) requested
+        /// but not yet delivered falls to `ThresholdPercent` of that amount,
+        /// a new pull request is sent for the difference. The next messages
+        /// are then already on their way while the current ones are being
+        /// processed, with at most two pull requests outstanding.
+        ///
+        /// Each pull request expires after `FetchExpires` and is simply
+        /// replaced. If heartbeats are missed, the #NATS_MISSED_HEARTBEAT
+        /// error is posted to the connection's asynchronous error handler
+        /// and the pull requests are reissued, instead of terminating the
+        /// subscription. In this mode, `Heartbeat` defaults to half of
+        /// `FetchExpires`, up to 30 seconds, so that pull requests lost
+        /// without notice (for instance across a reconnect) are replaced.
+        ///
+        /// `Timeout`, `MaxMessages` and `MaxBytes` still terminate the
+        /// subscription when reached.
+        ///
+        /// @note Consume can not be used in conjunction with NoWait,
+        /// KeepAhead or NextHandler.
+        bool                    Consume;
+
+        /// @brief In consume mode, the maximum number of bytes requested
+        /// but not yet delivered. When set, refills are driven by bytes
+        /// instead of messages.
+        int64_t                 FetchMaxBytes;
+
+        /// @brief In consume mode, percentage (between 1 and 99) of
+        /// `FetchSize` (or `FetchMaxBytes`) that triggers a refill, 50
+        /// if not set.
+        int                     ThresholdPercent;
+
+        /// @brief In consume mode, expiration of each pull request (in
+        /// milliseconds), 30 seconds if not set. If `Heartbeat` is set,
+        /// it needs to be less than half of this value.
+        int64_t                 FetchExpires;
+
 } jsOptionsPullSubscribeAsync;
 
 /**
@@ -1491,6 +1645,10 @@ typedef struct jsOptionsPublishAsync
                                                         ///  subscription per context). Works only if the connection has not been
                                                         ///  created with #natsOptions_UseOldRequestStyle.
 
+        bool                    AdaptiveMaxPending;     ///< If `true`, the number of asynchronous publishes in flight is adjusted, up to
+                                                        ///  MaxPending (or 65536 if not set), from the measured acknowledgment round trip
+                                                        ///  time and the "no responders" or timed out acknowledgments. See #js_PublishAsyncGetStats.
+
 } jsOptionsPublishAsync;
 
 /**
@@ -2253,6 +2411,24 @@ typedef struct __stanSubOptions     stanSubOptions;
 typedef void (*natsMsgHandler)(
         natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure);
 
+/** \brief Callback used to deliver several messages at once to the application.
+ *
+ * This is the callback that one provides when creating an asynchronous
+ * subscription with #natsConnection_SubscribeBatch. The library invokes this
+ * callback with the messages that were removed from the subscription's
+ * pending queue at once, in the order they were received. The number of
+ * messages is between 1 and the value set with #natsOptions_SetDispatchBatchSize.
+ *
+ * The array itself belongs to the library and is only valid for the duration
+ * of the callback, but each message must be destroyed by the application,
+ * as with #natsMsgHandler.
+ *
+ * @see natsConnection_SubscribeBatch()
+ * @see natsOptions_SetDispatchBatchSize()
+ */
+typedef void (*natsMsgBatchHandler)(
+        natsConnection *nc, natsSubscription *sub, natsMsg **msgs, int count, void *closure);
+
 /** \brief Callback used to notify the user of asynchronous connection events.
  *
  * This callback is used for asynchronous events such as disconnected
@@ -2427,6 +2603,61 @@ typedef const char* (*natsTokenHandler)(void *closure);
  */
 typedef void (*natsOnCompleteCB)(void *closure);
 
+/** \brief Callback used to notify that the library no longer references published data.
+ *
+ * This is used by #natsConnection_PublishNoCopy. The library does not copy the
+ * data passed to that function into its internal buffer, but instead keeps a
+ * reference to it until it has been written to the socket. This callback is
+ * then invoked to notify the application that the memory pointed by `data` can
+ * be reused or freed.
+ *
+ * The `status` is #NATS_OK if the data was written to the socket (or copied
+ * into the reconnect buffer), otherwise it indicates why the data could not
+ * be sent.
+ *
+ * \warning This callback may be invoked from the publishing thread or from the
+ * connection's flusher thread, with internal connection locks held. It must
+ * return quickly and must not call any function on this connection.
+ *
+ * @see natsConnection_PublishNoCopy()
+ */
+typedef void (*natsPublishReleaseHandler)(
+        natsConnection *nc, const void *data, int dataLen, natsStatus status,
+        void *closure);
+
+/** \brief Memory allocation function.
+ *
+ * Has the same semantics than the standard `malloc()` function.
+ *
+ * @see nats_SetAllocator()
+ */
+typedef void* (*natsMallocHandler)(size_t size);
+
+/** \brief Memory allocation function for zero-initialized arrays.
+ *
+ * Has the same semantics than the standard `calloc()` function.
+ *
+ * @see nats_SetAllocator()
+ */
+typedef void* (*natsCallocHandler)(size_t count, size_t size);
+
+/** \brief Memory reallocation function.
+ *
+ * Has the same semantics than the standard `realloc()` function.
+ *
+ * @see nats_SetAllocator()
+ */
+typedef void* (*natsReallocHandler)(void *ptr, size_t size);
+
+/** \brief Memory release function.
+ *
+ * Has the same semantics than the standard `free()` function. The library
+ * never invokes it with a `NULL` pointer.
+ *
+ * @see nats_SetAllocator()
+ */
+typedef void (*natsFreeHandler)(void *ptr);
+
 /** \brief Callback used to specify how long to wait between reconnects.
  *
  * This callback is used to get from the user the desired delay the library
@@ -2869,6 +3100,76 @@ nats_PrintLastErrorStack(FILE *file);
 NATS_EXTERN natsStatus
 nats_SetMessageDeliveryPoolSize(int max);
 
+/** \brief Sets the functions the library uses to allocate and free memory.
+ *
+ * By default, the library uses the standard `malloc()`, `calloc()`,
+ * `realloc()` and `free()` functions. This call allows an application to
+ * route all the library's allocations to a different allocator.
+ *
+ * This must be invoked before the library is initialized, that is, before
+ * #nats_Open (or any other function that would implicitly open the library)
+ * is called for the first time, otherwise #NATS_ILLEGAL_STATE is returned.
+ * Passing `NULL` for all functions restores the default allocator.
+ *
+ * \note Since the library may not be initialized, no error text is
+ * recorded when this call fails (see #nats_GetLastError).
+ *
+ * \warning Memory that the documentation says must be freed by the
+ * application with `free()` must then be released with `freeCb`. Similarly,
+ * memory that the application passes to the library and that the library
+ * frees (for instance in #natsUserJWTHandler) must be allocated with
+ * `mallocCb`.
+ *
+ * \note This does not apply to memory allocated by third-party libraries
+ * such as OpenSSL.
+ *
+ * @see nats_GetAllocStats()
+ *
+ * @param mallocCb the function replacing `malloc()`.
+ * @param callocCb the function replacing `calloc()`.
+ * @param reallocCb the function replacing `realloc()`.
+ * @param freeCb the function replacing `free()`.
+ */
+NATS_EXTERN natsStatus
+nats_SetAllocator(natsMallocHandler mallocCb, natsCallocHandler callocCb,
+                  natsReallocHandler reallocCb, natsFreeHandler freeCb);
+
+/** \brief Enables or disables the collection of allocation statistics.
+ *
+ * When enabled, the library counts the number of allocations, and the
+ * number of bytes requested, for each #natsAllocCategory. This is disabled
+ * by default since updating those counters has a cost for each allocation.
+ *
+ * This can be invoked at any time. Disabling the collection does not reset
+ * the counters.
+ *
+ * @see nats_GetAllocStats()
+ *
+ * @param enabled `true` to collect allocation statistics, `false` otherwise.
+ */
+NATS_EXTERN void
+nats_SetAllocStatsEnabled(bool enabled);
+
+/** \brief Gets the allocation statistics for a given category.
+ *
+ * Returns the number of allocations, and the total number of bytes requested,
+ * that the library made for the given category since the collection of
+ * statistics was enabled with #nats_SetAllocStatsEnabled. A reallocation
+ * counts as an allocation of the new size.
+ *
+ * These are cumulative counts, which allows an application to attribute
+ * memory growth to a given subsystem by sampling them over time.
+ *
+ * \note You can pass `NULL` to any of the count your are not interested in
+ * getting.
+ *
+ * @param category the #natsAllocCategory to get the statistics for.
+ * @param allocs the location where to store the number of allocations.
+ * @param bytes the location where to store the number of bytes requested.
+ */
+NATS_EXTERN natsStatus
+nats_GetAllocStats(natsAllocCategory category, uint64_t *allocs, uint64_t *bytes);
+
 /** \brief Release thread-local memory possibly allocated by the library.
  *
  * This needs to be called on user-created threads where NATS calls are
@@ -3047,6 +3348,122 @@ natsStatistics_GetCounts(const natsStatistics *stats,
                          uint64_t *outMsgs, uint64_t *outBytes,
                          uint64_t *reconnects);
 
+/** \brief Extracts the message pool statistics.
+ *
+ * Gets the counts related to the pool of incoming messages, which is
+ * enabled with #natsOptions_UseMessagePool. All counts are 0 if the
+ * pool is not enabled.
+ *
+ * \note You can pass `NULL` to any of the count your are not interested in
+ * getting.
+ *
+ * @see natsConnection_GetStats()
+ *
+ * @param stats the pointer to the #natsStatistics object to get the values from.
+ * @param hits number of incoming messages whose memory was taken from the pool.
+ * @param misses number of incoming messages that required a new allocation.
+ * @param retainedBytes number of bytes currently retained by the pool.
+ */
+NATS_EXTERN natsStatus
+natsStatistics_GetMsgPoolCounts(const natsStatistics *stats,
+                                uint64_t *hits, uint64_t *misses,
+                                int64_t *retainedBytes);
+
+/** \brief Extracts the socket read statistics.
+ *
+ * Gets the number of read calls made on the connection's socket, and the
+ * number of bytes they returned, since the connection was created. The
+ * average number of bytes per read is `readBytes / readCalls`. Reads that
+ * returned nothing because no data was available are counted too. For a
+ * connection serviced by an io_uring thread (see `IOUringThreads` in
+ * #natsClientConfig), each receive completion counts as a read.
+ *
+ * Also gets the current size of the read buffer, which may change over time
+ * if #natsOptions_SetReadBufferLimits is used.
+ *
+ * \note You can pass `NULL` to any of the count your are not interested in
+ * getting.
+ *
+ * @see natsConnection_GetStats()
+ *
+ * @param stats the pointer to the #natsStatistics object to get the values from.
+ * @param readCalls number of read calls made on the socket.
+ * @param readBytes number of bytes read from the socket.
+ * @param bufSize current size, in bytes, of the read buffer.
+ */
+NATS_EXTERN natsStatus
+natsStatistics_GetReadCounts(const natsStatistics *stats,
+                             uint64_t *readCalls, uint64_t *readBytes,
+                             int *bufSize);
+
+/** \brief Extracts the number of waits for the socket to be readable.
+ *
+ * Gets the number of times the connection waited for its socket to be
+ * ready (with `poll()` or `select()`) before or during a read, since the
+ * connection was created. With a non-blocking socket, a read that finds no
+ * data available is followed by such a wait. Adding this count to the one
+ * of read calls from #natsStatistics_GetReadCounts gives the number of
+ * system calls made to read from the socket.
+ *
+ * @see natsConnection_GetStats()
+ * @see natsOptions_UseReadBatching()
+ *
+ * @param stats the pointer to the #natsStatistics object to get the values from.
+ * @param readWaits the location where to store the number of waits.
+ */
+NATS_EXTERN natsStatus
+natsStatistics_GetReadWaits(const natsStatistics *stats, uint64_t *readWaits);
+
+/** \brief Extracts the flusher statistics.
+ *
+ * Gets the number of flushes performed by the connection's flusher thread
+ * and the number of bytes they wrote, since the connection was created.
+ * The average number of bytes per flush is `flushedBytes / flushes`. Data
+ * written in place by the publishing threads (for instance when the buffer
+ * is full or with #natsOptions_SetSendAsap) is not included.
+ *
+ * Also gets the accumulation wait currently used by the flusher thread when
+ * it adapts it to the write rate (see #natsOptions_SetFlusherTargetRate),
+ * `0` otherwise.
+ *
+ * \note You can pass `NULL` to any of the count your are not interested in
+ * getting.
+ *
+ * @see natsConnection_GetStats()
+ *
+ * @param stats the pointer to the #natsStatistics object to get the values from.
+ * @param flushes number of flushes performed by the flusher thread.
+ * @param flushedBytes number of bytes written by these flushes.
+ * @param windowUs current accumulation wait, in microseconds.
+ */
+NATS_EXTERN natsStatus
+natsStatistics_GetFlushCounts(const natsStatistics *stats,
+                              uint64_t *flushes, uint64_t *flushedBytes,
+                              int64_t *windowUs);
+
+/** \brief Extracts the TLS offload statistics.
+ *
+ * Gets the number of TLS handshakes completed by the connection since it was
+ * created, and, among them, how many resulted in the kernel taking over the
+ * sending and the receiving of TLS records (see #natsOptions_TLSKernelOffload).
+ * If the offload counts are equal to the number of handshakes, every TLS
+ * session established so far has been offloaded.
+ *
+ * \note You can pass `NULL` to any of the count your are not interested in
+ * getting.
+ *
+ * @see natsConnection_GetStats()
+ *
+ * @param stats the pointer to the #natsStatistics object to get the values from.
+ * @param handshakes number of completed TLS handshakes.
+ * @param sendOffloads number of handshakes after which sends were offloaded.
+ * @param recvOffloads number of handshakes after which receives were offloaded.
+ */
+NATS_EXTERN natsStatus
+natsStatistics_GetTLSOffloadCounts(const natsStatistics *stats,
+                                   uint64_t *handshakes, uint64_t *sendOffloads,
+                                   uint64_t *recvOffloads);
+
 /** \brief Destroys the #natsStatistics object.
  *
  * Destroys the statistics object, freeing up memory.
@@ -3327,6 +3744,49 @@ natsOptions_TLSHandshakeFirst(natsOptions *opts);
 NATS_EXTERN natsStatus
 natsOptions_AllowConcurrentTLSHandshakes(natsOptions *opts);
 
+/** \brief Lets the kernel handle TLS records once the handshake is done.
+ *
+ * Asks OpenSSL to hand the TLS record layer over to the kernel (kTLS) after
+ * each successful TLS handshake. When this is possible, encryption of the
+ * outgoing data and decryption of the incoming data is done by the kernel,
+ * and the library writes to and reads from the socket with plain `send()`
+ * and `recv()` calls, without going through OpenSSL nor serializing these
+ * calls with each other.
+ *
+ * Offload requires OpenSSL 3.0 or above built with kTLS support, a kernel
+ * with the `tls` module loaded, and a cipher suite and protocol version that
+ * the kernel supports. When any of these is missing, the connection silently
+ * keeps using OpenSSL for that direction. Use #natsStatistics_GetTLSOffloadCounts
+ * to check whether offload was engaged.
+ *
+ * @param opts the pointer to the #natsOptions object.
+ */
+NATS_EXTERN natsStatus
+natsOptions_TLSKernelOffload(natsOptions *opts);
+
+/** \brief Decouples TLS reads from TLS writes.
+ *
+ * By default, the library lets OpenSSL read from and write to the socket,
+ * and since an SSL object can't be used by several threads at once, a read
+ * in progress (in the thread reading from the socket) and a write (done by
+ * the flusher or a publishing thread) exclude each other, including while
+ * the socket is being accessed.
+ *
+ * With this option, once the TLS handshake is complete, OpenSSL is driven
+ * through memory buffers. Encrypted data is read from and written to the
+ * socket by the library without holding the SSL object, which is only
+ * locked for the duration of the encryption or decryption. This lets
+ * reads and writes proceed in parallel.
+ *
+ * \note This option has no effect when an external event loop, or the
+ * library I/O threads, are used, nor when kernel TLS offload is engaged
+ * (see #natsOptions_TLSKernelOffload).
+ *
+ * @param opts the pointer to the #natsOptions object.
+ */
+NATS_EXTERN natsStatus
+natsOptions_TLSMemoryBIO(natsOptions *opts);
+
 /** \brief Loads the trusted CA certificates from a file.
  *
  * Loads the trusted CA certificates from a file.
@@ -3615,6 +4075,55 @@ natsOptions_SetIgnoreAuthErrorAbort(natsOptions *opts, bool ignore);
 NATS_EXTERN natsStatus
 natsOptions_SetIOBufSize(natsOptions *opts, int ioBufSize);
 
+/** \brief Lets the read buffer grow and shrink with the incoming traffic.
+ *
+ * By default, the buffer the connection reads from the socket into has
+ * the fixed size set with #natsOptions_SetIOBufSize. With this option,
+ * the buffer starts with that size, brought within the given bounds, and
+ * is then resized based on how much of it reads fill: it is doubled each
+ * time a read fills it, and it is shrunk when a series of reads used
+ * less than a quarter of it.
+ *
+ * This allows busy connections to read more messages per system call,
+ * while mostly idle connections don't hold on to large buffers.
+ *
+ * Call this function with 0 for both bounds to get back to a fixed size
+ * buffer. The current size can be obtained with #natsStatistics_GetReadCounts.
+ *
+ * \note This has no effect on connections using an external event loop.
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param minSize the minimum size, in bytes, of the read buffer.
+ * @param maxSize the maximum size, in bytes, of the read buffer. Must not be
+ * less than `minSize`.
+ */
+NATS_EXTERN natsStatus
+natsOptions_SetReadBufferLimits(natsOptions *opts, int minSize, int maxSize);
+
+/** \brief Waits for data before reading after a partial read.
+ *
+ * When a write deadline is set with #natsOptions_SetWriteDeadline, the
+ * connection's socket is non-blocking: the connection tries to read from
+ * the socket right away after having processed what was read, and waits
+ * for the socket to be readable only when nothing was available. When this
+ * option is enabled, the connection waits for the socket to be readable
+ * first whenever the previous read did not fill the read buffer, since the
+ * socket has then most likely been drained. The wait does not add a system
+ * call: it replaces the one that follows a read returning no data. This mode
+ * therefore only avoids the reads that would return no data, saving one
+ * system call per wake up. This can be observed with
+ * #natsStatistics_GetReadCounts and #natsStatistics_GetReadWaits.
+ *
+ * \note This has no effect without a write deadline, since the socket is
+ * then blocking and the read itself waits for data. It has no effect on
+ * TLS connections nor on connections using an external event loop either.
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param batching `true` to enable read batching, `false` otherwise.
+ */
+NATS_EXTERN natsStatus
+natsOptions_UseReadBatching(natsOptions *opts, bool batching);
+
 /** \brief Indicates if the connection will be allowed to reconnect.
  *
  * Specifies whether or not the client library should try to reconnect when
@@ -3982,6 +4491,62 @@ natsOptions_SetEventLoop(natsOptions *opts,
 NATS_EXTERN natsStatus
 natsOptions_UseGlobalMessageDelivery(natsOptions *opts, bool global);
 
+/** \brief Switch on/off the use of a lock-free queue for message delivery.
+ *
+ * Messages for an asynchronous subscriber are queued by the connection's
+ * reading thread and removed by the subscriber's message delivery thread.
+ * By default, this queue is protected by the subscription's lock, and the
+ * delivery thread is signaled each time a message is added to an empty queue.
+ *
+ * When this option is enabled, asynchronous subscribers that have their own
+ * message delivery thread use a lock-free queue instead. The reading thread
+ * adds messages, and checks the pending limits, without acquiring the
+ * subscription's lock, and the delivery thread removes and delivers them
+ * without acquiring it either. The delivery thread checks the queue once
+ * more, after yielding, before waiting for new messages, and is signaled only
+ * if it is actually waiting. This reduces contention and context switches when
+ * messages arrive at a high rate.
+ *
+ * The lock is still used by JetStream subscriptions, and once a subscription
+ * is closed, draining or has a maximum number of messages to deliver (see
+ * #natsSubscription_AutoUnsubscribe).
+ *
+ * \note This has no effect on subscribers using the global message delivery
+ * thread pool (see #natsOptions_UseGlobalMessageDelivery), nor on synchronous
+ * subscribers.
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param lockFree if `true`, asynchronous subscribers with their own delivery
+ * thread use a lock-free queue.
+ */
+NATS_EXTERN natsStatus
+natsOptions_UseLockFreeDispatchQueue(natsOptions *opts, bool lockFree);
+
+/** \brief Sets the maximum number of messages removed from a queue at once.
+ *
+ * By default, a message delivery thread acquires the lock protecting the
+ * queue of pending messages each time it removes a message.
+ *
+ * With a value greater than 1, the delivery thread removes up to that many
+ * messages while holding the lock, then invokes the message handler for each
+ * of them (or the #natsMsgBatchHandler once, see #natsConnection_SubscribeBatch)
+ * without acquiring the lock again.
+ *
+ * \note This applies only to asynchronous subscriptions without a delivery
+ * limit (see #natsSubscription_AutoUnsubscribe), a timeout or JetStream
+ * processing, whose messages are still removed one at a time.
+ *
+ * \warning If the subscription is closed from a message handler, messages
+ * that were already removed from the queue with the current batch are still
+ * delivered.
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param batchSize the maximum number of messages removed at once, from 1
+ * (the default) to 256.
+ */
+NATS_EXTERN natsStatus
+natsOptions_SetDispatchBatchSize(natsOptions *opts, int batchSize);
+
 /** \brief Dictates the order in which host name are resolved during connect.
  *
  * The library would previously favor IPv6 addresses during the connect process.
@@ -4090,6 +4655,34 @@ natsOptions_SetSendAsap(natsOptions *opts, bool sendAsap);
 NATS_EXTERN natsStatus
 natsOptions_SetFlusherWaitMicros(natsOptions *opts, int64_t flusherWaitUs);
 
+/** \brief Adapts the flusher thread's wait to the write rate.
+ *
+ * By default, the flusher thread's accumulation wait (see
+ * #natsOptions_SetFlusherWaitMicros) depends on simple activity heuristics,
+ * which may not suit traffic whose rate varies a lot over time.
+ *
+ * With this option, the flusher thread measures the rate of writes (every
+ * 100 milliseconds) and picks the accumulation wait so that there are about
+ * `flushesPerSec` flushes, that is socket write system calls, per second:
+ * no wait while the write rate is below the target, and a wait growing with
+ * the write rate above it. The wait never exceeds the value set with
+ * #natsOptions_SetFlusherWaitMicros, which therefore acts as the latency
+ * budget of a publish.
+ *
+ * The flusher's decisions can be observed with
+ * #natsStatistics_GetFlushCounts.
+ *
+ * \note This option has no effect if #natsOptions_SetSendAsap is set to
+ * `true`, or for connections serviced by the library's I/O threads, since
+ * the flusher thread is not used in those cases.
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param flushesPerSec the target number of flushes per second, `0` to
+ * disable (the default). Must be `>= 0`.
+ */
+NATS_EXTERN natsStatus
+natsOptions_SetFlusherTargetRate(natsOptions *opts, int flushesPerSec);
+
 /** \brief Switches the use of old style requests.
  *
  * Setting `useOldStyle` to `true` forces the request calls to use the original
@@ -4436,6 +5029,61 @@ natsOptions_SetCustomInboxPrefix(natsOptions *opts, const char *inboxPrefix);
 NATS_EXTERN natsStatus
 natsOptions_SetMessageBufferPadding(natsOptions *opts, int paddingSize);
 
+/** \brief Recycles the memory of incoming messages through a pool.
+ *
+ * By default, the library allocates a new #natsMsg for every incoming
+ * message and frees it when the message is destroyed. When this option
+ * is enabled, each connection keeps a pool of message buffers, organized
+ * in size classes, and #natsMsg_Destroy returns the message's buffer
+ * to this pool so that it can be reused for a subsequent incoming message.
+ *
+ * Messages whose size exceed the largest size class (64KB) are not pooled.
+ * The pool never retains more than `maxRetainedBytes` bytes: when that
+ * limit would be exceeded, destroyed messages are simply freed.
+ *
+ * Pool hits and misses, and the number of retained bytes, can be obtained
+ * with #natsStatistics_GetMsgPoolCounts.
+ *
+ * \note Messages may be destroyed after the connection is destroyed. The
+ * pool is released when the last pooled message is destroyed.
+ *
+ * Changing this option has no effect on existing NATS connections.
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param useMsgPool `true` to enable the message pool, `false` otherwise.
+ * @param maxRetainedBytes the maximum number of bytes the pool can retain,
+ * or 0 to use the default (4MB).
+ */
+NATS_EXTERN natsStatus
+natsOptions_UseMessagePool(natsOptions *opts, bool useMsgPool, int64_t maxRetainedBytes);
+
+/** \brief Lets incoming messages point into the connection's read buffers.
+ *
+ * By default, the subject, reply and payload of an incoming message are
+ * copied from the buffer the connection reads from the socket into the
+ * #natsMsg. When this option is enabled, the connection reads into
+ * reference counted chunks of #natsOptions_SetIOBufSize bytes, and a
+ * message that is entirely contained in a chunk references its subject,
+ * reply and payload there instead. The chunk is reused or freed once all
+ * the messages that reference it have been destroyed. Headers are still
+ * copied, and so is anything that spans two reads.
+ *
+ * This saves a copy of the payload, which matters for large messages,
+ * but an application that holds on to a single message keeps the whole
+ * chunk allocated.
+ *
+ * \note This has no effect when a payload padding is set with
+ * #natsOptions_SetMessageBufferPadding, nor on connections using an
+ * external event loop.
+ *
+ * Changing this option has no effect on existing NATS connections.
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param zeroCopy `true` to enable zero-copy messages, `false` otherwise.
+ */
+NATS_EXTERN natsStatus
+natsOptions_UseZeroCopyMessages(natsOptions *opts, bool zeroCopy);
+
 /** \brief Destroys a #natsOptions object.
  *
  * Destroys the natsOptions object, freeing used memory. See the note in
@@ -5934,6 +6582,35 @@ natsConnection_PublishString(natsConnection *nc, const char *subj,
 NATS_EXTERN natsStatus
 natsConnection_PublishMsg(natsConnection *nc, natsMsg *msg);
 
+/** \brief Publishes an array of messages.
+ *
+ * Publishes the `count` messages from the `msgs` array, in order. This is
+ * equivalent to calling #natsConnection_PublishMsg for each message, but the
+ * connection lock is acquired once, the connection state is checked once, and
+ * the flusher is notified once for the whole batch. This reduces the cost of
+ * publishing bursts of small messages.
+ *
+ * All messages are validated (subject, maximum payload, headers support) before
+ * any is written. If one of them is invalid, an error is returned and none of
+ * the messages is sent.
+ *
+ * \note The messages are not destroyed by this call, nor referenced after it
+ * returns: the application can destroy them or reuse them immediately.
+ *
+ * \warning If an error occurs while writing to the socket, some of the messages
+ * may have been sent.
+ *
+ * See #natsConnection_Publish note regarding when the data is sent.
+ *
+ * @see #natsConnection_PublishMsg()
+ *
+ * @param nc the pointer to the #natsConnection object.
+ * @param msgs the array of pointers to the #natsMsg objects to send.
+ * @param count the number of messages in the `msgs` array.
+ */
+NATS_EXTERN natsStatus
+natsConnection_PublishBatch(natsConnection *nc, natsMsg **msgs, int count);
+
 /** \brief Publishes data on a subject expecting replies on the given reply.
  *
  * Publishes the data argument to the given subject expecting a response on
@@ -5974,6 +6651,89 @@ NATS_EXTERN natsStatus
 natsConnection_PublishRequestString(natsConnection *nc, const char *subj,
                                     const char *reply, const char *str);
 
+/** \brief Publishes data on a subject without copying the data.
+ *
+ * Similar to #natsConnection_Publish, except that the data is not copied into
+ * the connection's internal buffer. Instead, the library keeps a reference to
+ * `data` and writes it to the socket, along with the protocol and the other
+ * buffered data, using a single gather write (such as `sendmsg()` or `WSASend()`).
+ * This is beneficial for large payloads, for which the copy would otherwise
+ * be the main cost of publishing.
+ *
+ * The application must not modify or free `data` until the `releaseCb` callback
+ * is invoked. Regardless of the outcome of this call, `releaseCb` is invoked
+ * exactly once, possibly before this function returns. The status passed to
+ * the callback indicates if the data was sent or not.
+ *
+ * \note When the connection is reconnecting, or when it is attached to an external
+ * event loop, the data is copied as usual and `releaseCb` is invoked before this
+ * function returns.
+ *
+ * See #natsConnection_Publish note regarding when the data is sent.
+ *
+ * @see natsPublishReleaseHandler
+ *
+ * @param nc the pointer to the #natsConnection object.
+ * @param subj the subject the data is sent to.
+ * @param data the data to be sent, can be `NULL`.
+ * @param dataLen the length of the data to be sent.
+ * @param releaseCb the callback invoked when the library no longer references `data`.
+ * @param releaseClosure a pointer to an user object that will be passed to the callback.
+ */
+NATS_EXTERN natsStatus
+natsConnection_PublishNoCopy(natsConnection *nc, const char *subj,
+                             const void *data, int dataLen,
+                             natsPublishReleaseHandler releaseCb, void *releaseClosure);
+
+/** \brief Creates a publisher for the given subject.
+ *
+ * Creates a #natsPublisher that publishes messages on the subject `subj`.
+ * The protocol prefix for this subject is encoded once here, so that each
+ * #natsPublisher_Publish call only has to encode the payload size. This
+ * reduces the cost of publishing small messages to the same subjects
+ * repeatedly.
+ *
+ * The publisher holds a reference to the connection, and can be used by
+ * several threads at the same time. It must be destroyed with
+ * #natsPublisher_Destroy.
+ *
+ * @see natsPublisher_Publish()
+ * @see natsPublisher_Destroy()
+ *
+ * @param newPub the location where to store the pointer to the newly
+ * created #natsPublisher object.
+ * @param nc the pointer to the #natsConnection object.
+ * @param subj the subject the messages will be sent to.
+ */
+NATS_EXTERN natsStatus
+natsConnection_PreparePublisher(natsPublisher **newPub, natsConnection *nc,
+                                const char *subj);
+
+/** \brief Publishes data on the publisher's subject.
+ *
+ * Publishes the data argument to the subject given to
+ * #natsConnection_PreparePublisher. This is equivalent to calling
+ * #natsConnection_Publish with that subject.
+ *
+ * See #natsConnection_Publish note regarding when the data is sent.
+ *
+ * @param pub the pointer to the #natsPublisher object.
+ * @param data the data to be sent, can be `NULL`.
+ * @param dataLen the length of the data to be sent.
+ */
+NATS_EXTERN natsStatus
+natsPublisher_Publish(natsPublisher *pub, const void *data, int dataLen);
+
+/** \brief Destroys the publisher.
+ *
+ * Destroys the #natsPublisher object and releases its reference to the
+ * connection. This does not affect messages already published.
+ *
+ * @param pub the pointer to the #natsPublisher object to destroy.
+ */
+NATS_EXTERN void
+natsPublisher_Destroy(natsPublisher *pub);
+
 /** \brief Sends a request and waits for a reply.
  *
  * Sends a request payload and delivers the first response message,
@@ -6175,6 +6935,29 @@ natsConnection_SubscribeTimeout(natsSubscription **sub, natsConnection *nc,
                                 const char *subject, int64_t timeout,
                                 natsMsgHandler cb, void *cbClosure);
 
+/** \brief Creates an asynchronous subscription delivering messages in batches.
+ *
+ * Expresses interest in the given subject. The subject can have wildcards
+ * (see \ref wildcardsGroup). Messages will be delivered to the associated
+ * #natsMsgBatchHandler, one or more at a time, depending on how many are
+ * pending and on the value set with #natsOptions_SetDispatchBatchSize.
+ *
+ * \note With the default batch size of 1, the callback is invoked for each
+ * message, with `count` set to 1.
+ *
+ * @param sub the location where to store the pointer to the newly created
+ * #natsSubscription object.
+ * @param nc the pointer to the #natsConnection object.
+ * @param subject the subject this subscription is created for.
+ * @param cb the #natsMsgBatchHandler callback.
+ * @param cbClosure a pointer to an user defined object (can be `NULL`). See
+ * the #natsMsgBatchHandler prototype.
+ */
+NATS_EXTERN natsStatus
+natsConnection_SubscribeBatch(natsSubscription **sub, natsConnection *nc,
+                              const char *subject, natsMsgBatchHandler cb,
+                              void *cbClosure);
+
 /** \brief Creates a synchronous subscription.
  *
  * Similar to #natsConnection_Subscribe, but creates a synchronous subscription
@@ -7835,6 +8618,19 @@ js_PublishAsyncComplete(jsCtx *js, jsPubOptions *opts);
 NATS_EXTERN natsStatus
 js_PublishAsyncGetPendingList(natsMsgList *pending, jsCtx *js);
 
+/** \brief Returns statistics about the asynchronous publishes.
+ *
+ * Returns the number of asynchronous publishes waiting for their acknowledgment,
+ * the current limit of publishes in flight (which changes over time when
+ * jsOptionsPublishAsync.AdaptiveMaxPending is set), the acknowledgment round
+ * trip times and how many times publish calls had to wait.
+ *
+ * @param stats the pointer to a #jsPublishAsyncStats object, typically defined on the stack.
+ * @param js the pointer to the #jsCtx object.
+ */
+NATS_EXTERN natsStatus
+js_PublishAsyncGetStats(jsPublishAsyncStats *stats, jsCtx *js);
+
 /** \brief Starts an atomic batch publish.
  *
  * This call initializes an atomic batch publish and sends the first message.
@@ -7899,6 +8695,118 @@ js_BatchPublishCommit(jsPubAck **new_puback, jsAtomicBatchCtx *ctx, natsMsg *msg
 NATS_EXTERN void
 jsAtomicBatchCtx_Destroy(jsAtomicBatchCtx *ctx);
 
+/** \brief Initializes a stream writer options structure.
+ *
+ * Use this before setting specific #jsStreamWriterOptions options and passing it
+ * to #js_NewStreamWriter.
+ *
+ * @param opts the pointer to the #jsStreamWriterOptions to initialize.
+ */
+NATS_EXTERN natsStatus
+jsStreamWriterOptions_Init(jsStreamWriterOptions *opts);
+
+/** \brief Creates a stream writer.
+ *
+ * A stream writer publishes messages without waiting for their acknowledgment,
+ * up to #jsStreamWriterOptions.MaxInFlight of them, and reports the results
+ * strictly in publish order, either through the #jsStreamWriterOptions.AckHandler
+ * callback, or with #jsStreamWriter_Next.
+ *
+ * Messages that get a "no responders" reply (for instance while a stream
+ * leader is being elected) are resent after #jsStreamWriterOptions.RetryWait,
+ * up to #jsStreamWriterOptions.MaxRetries times. A message that is not
+ * acknowledged within #jsStreamWriterOptions.MaxWait is reported with
+ * a `NATS_TIMEOUT` error.
+ *
+ * \note The writer uses its own subscription to receive the acknowledgments.
+ *
+ * @see jsStreamWriter_Destroy
+ *
+ * @param new_writer the location where to store the newly created #jsStreamWriter object.
+ * @param js the pointer to the #jsCtx object.
+ * @param opts the pointer to the #jsStreamWriterOptions object, possibly `NULL`.
+ */
+NATS_EXTERN natsStatus
+js_NewStreamWriter(jsStreamWriter **new_writer, jsCtx *js, jsStreamWriterOptions *opts);
+
+/** \brief Publishes data through the stream writer.
+ *
+ * See #jsStreamWriter_PublishMsg for details.
+ *
+ * @param w the pointer to the #jsStreamWriter object.
+ * @param subj the subject the data is sent to.
+ * @param data the data to be sent, can be `NULL`.
+ * @param dataLen the length of the data to be sent.
+ */
+NATS_EXTERN natsStatus
+jsStreamWriter_Publish(jsStreamWriter *w, const char *subj, const void *data, int dataLen);
+
+/** \brief Publishes a message through the stream writer.
+ *
+ * If there are already #jsStreamWriterOptions.MaxInFlight messages not yet
+ * reported, this call waits up to #jsStreamWriterOptions.MaxWait for one
+ * of them to be reported, and returns `NATS_TIMEOUT` if that did not happen.
+ *
+ * On success, the library takes ownership of the message and `msg` is set
+ * to `NULL`. The message is given back with its result, to the
+ * #jsStreamWriterOptions.AckHandler callback or by #jsStreamWriter_Next.
+ *
+ * \note If the message could not be sent and other messages have been
+ * published in the meantime, this call returns `NATS_OK` and the failure
+ * is reported, in order, with the message.
+ *
+ * @param w the pointer to the #jsStreamWriter object.
+ * @param msg the memory location where the pointer to the #natsMsg object is located.
+ */
+NATS_EXTERN natsStatus
+jsStreamWriter_PublishMsg(jsStreamWriter *w, natsMsg **msg);
+
+/** \brief Returns the result of the oldest message published through the stream writer.
+ *
+ * Waits up to `timeout` milliseconds for the result of the oldest published
+ * message not yet reported, and returns that message along with its
+ * acknowledgment or error. The user is responsible for destroying the
+ * returned message and #jsPubAck object.
+ *
+ * This call returns `NATS_NOT_FOUND` if there is no published message left
+ * to report, and `NATS_TIMEOUT` with `msg` set to `NULL` if the result did
+ * not arrive in time. Any other error (including `NATS_TIMEOUT` with `msg`
+ * not `NULL`) is the result of the publish of the returned message.
+ *
+ * \note This call cannot be used if #jsStreamWriterOptions.AckHandler is set.
+ *
+ * @param new_puback the location where to store the pub ack, or `NULL` if not needed.
+ * @param msg the location where to store the pointer to the published #natsMsg object.
+ * @param w the pointer to the #jsStreamWriter object.
+ * @param timeout the amount of time (in milliseconds) to wait for the result.
+ * @param errCode the location where to store the JetStream specific error code, possibly `NULL`.
+ */
+NATS_EXTERN natsStatus
+jsStreamWriter_Next(jsPubAck **new_puback, natsMsg **msg, jsStreamWriter *w,
+                    int64_t timeout, jsErrCode *errCode);
+
+/** \brief Waits for the results of all messages published through the stream writer.
+ *
+ * If #jsStreamWriterOptions.AckHandler is set, waits until the callback has
+ * been invoked for every published message. Otherwise, waits until the result
+ * of every published message is available to #jsStreamWriter_Next.
+ *
+ * @param w the pointer to the #jsStreamWriter object.
+ * @param timeout the amount of time (in milliseconds) to wait.
+ */
+NATS_EXTERN natsStatus
+jsStreamWriter_Flush(jsStreamWriter *w, int64_t timeout);
+
+/** \brief Destroys the stream writer.
+ *
+ * Stops the writer and releases the messages whose results have not been
+ * reported yet.
+ *
+ * @param w the pointer to the #jsStreamWriter object.
+ */
+NATS_EXTERN void
+jsStreamWriter_Destroy(jsStreamWriter *w);
+
 /** @} */ // end of jsPubGroup
 
 /** \defgroup jsSubGroup Subscribing
@@ -259,6 +259,8 @@ struct __natsOptions
     bool                    secureExplicitlySet;
     bool                    tlsHandshakeFirst;
     bool                    tlsConcurrentHandshakes;
+    bool                    tlsKernelOffload;
+    bool                    tlsMemoryBIO;
     int                     ioBufSize;
     int                     maxReconnect;
     int64_t                 reconnectWait;
@@ -321,6 +323,14 @@ struct __natsOptions
     // out of a thread pool is used. natsClientConfig controls the pool size.
     bool                    useSharedReplyDispatcher;
 
+    // If set to true, subscriptions with their own delivery thread use a
+    // lock-free queue between the connection and that thread.
+    bool                    lockFreeDispatchQueue;
+
+    // Maximum number of messages a delivery thread removes from the queue
+    // each time it acquires the lock.
+    int                     dispatchBatchSize;
+
     int                     orderIP; // possible values: 0,4,6,46,64
 
     // forces the old method of Requests that utilize
@@ -336,6 +346,10 @@ struct __natsOptions
     // 0 means flush as soon as signaled.
     int64_t                 flusherWait;
 
+    // If positive, the flusher thread picks its accumulation wait, up to
+    // `flusherWait`, so that there are about that many flushes per second.
+    int                     flusherTargetRate;
+
     // If set to true, pending requests will fail with NATS_CONNECTION_DISCONNECTED
     // when the library detects a disconnection.
     bool                    failRequestsOnDisconnect;
@@ -385,18 +399,42 @@ struct __natsOptions
     // Custom message payload padding size
     int payloadPaddingSize;
 
+    // Recycle inbound messages through a per-connection pool, and the
+    // maximum number of bytes the pool may retain.
+    bool    useMsgPool;
+    int64_t msgPoolMaxBytes;
+
+    // Have inbound messages point into refcounted read chunks instead
+    // of copying their content.
+    bool    zeroCopyMsgs;
+
+    // Bounds within which the read buffer is resized based on how much
+    // of it reads fill. Both 0 means that the buffer has a fixed size.
+    int     ioBufMinSize;
+    int     ioBufMaxSize;
+
+    // After a read that did not fill the buffer, wait for the socket to
+    // be readable instead of trying to read right away.
+    bool    readBatching;
+
     // If set to true, client opts out of the default connect behavior of aborting
     // subsequent reconnect attempts if server returns the same auth error twice
     // (regardless of reconnect policy).
     bool ignoreAuthErrAbort;
 };
-typedef struct __pmInfo
+// An async published message waiting for its ack. Stored in the jsCtx's
+// pending table at the index of its reply sequence. Entries with a deadline
+// are also linked, in deadline order, through the sequences (plus 1, so
+// that 0 means "none") of the previous and next entries.
+typedef struct __jsPendingPub
 {
-    char                *id;
+    natsMsg             *msg;
+    int64_t             sentAt;
     int64_t             deadline;
-    struct __pmInfo     *next;
+    uint64_t            prev;
+    uint64_t            next;
 
-} pmInfo;
+} jsPendingPub;
 
 typedef void (*js_onReleaseCb)(void *arg);
 
@@ -426,14 +464,34 @@ struct __jsCtx
     jsOptions  	        opts;
     int				    refs;
     natsCondition       *cond;
-    natsStrHash         *pm;
+    // Ring of pending async published messages, indexed by reply sequence
+    // (modulo pmSize, a power of 2), starting at sequence pmBase. Entries
+    // older than pmBase that are still pending are moved to pmOld.
+    jsPendingPub        *pmTable;
+    int                 pmSize;
+    int                 pmInTable;
+    uint64_t            pmBase;
+    natsHash            *pmOld;
+    // Sequences (plus 1) of the first and last entries in deadline order.
+    uint64_t            pmdHead;
+    uint64_t            pmdTail;
     natsTimer           *pmtmr;
-    pmInfo              *pmHead;
-    pmInfo              *pmTail;
     jsAsyncReplies      asyncReplies;
     int                 pacw;
     int64_t             pmcount;
     int                 stalled;
+    // Flow control of async publishes: window used instead of MaxPending
+    // when AdaptiveMaxPending is set, and ack round trip times (in ns).
+    int64_t             pmWindow;
+    int64_t             pmWindowAcks;
+    uint64_t            pmWindowEpoch;
+    bool                pmSlowStart;
+    int64_t             pmRTT;
+    int64_t             pmMinRTT;
+    int64_t             pmPeriodMinRTT;
+    int64_t             pmPeriodStart;
+    uint64_t            pmStalls;
+    uint64_t            pmDecreases;
     bool                closed;
     js_onReleaseCb      onReleaseCb;
     void                *onReleaseCbArg;
@@ -448,6 +506,43 @@ struct __jsAtomicBatchCtx
 
 };
 
+// A message published through a jsStreamWriter, waiting to be reported.
+typedef struct __jsStreamWriterEntry
+{
+    natsMsg             *msg;
+    natsMsg             *reply;     // The ack (or error) received from the server.
+    natsStatus          err;        // Set if the entry failed without a reply.
+    int64_t             deadline;
+    int64_t             retryAt;    // If not 0, resend at this time.
+    int                 attempts;
+    bool                sending;    // The message is being (re)sent.
+    bool                done;
+
+} jsStreamWriterEntry;
+
+struct __jsStreamWriter
+{
+    natsMutex               *mu;
+    natsCondition           *cond;
+    int                     refs;
+    jsCtx                   *js;
+    jsStreamWriterOptions   opts;
+    natsSubscription        *sub;
+    natsTimer               *tmr;
+    int64_t                 tick;
+    char                    *replyPfx;
+    int                     replyPfxLen;
+    // Ring of opts.MaxInFlight entries, indexed by sequence. Sequences
+    // from `head` to `next` (excluded) are in flight or waiting to be
+    // reported, in order.
+    jsStreamWriterEntry     *entries;
+    uint64_t                head;
+    uint64_t                next;
+    bool                    reporting;
+    bool                    closed;
+
+};
+
 typedef struct __jsFetch
 {
     struct jsOptionsPullSubscribeAsync opts;
@@ -468,8 +563,39 @@ typedef struct __jsFetch
 
     // Pin ID if pinned by the server
     char        *pinID;
+
+    // Consume mode: messages and bytes requested but not yet delivered,
+    // and whether heartbeats have been missed since the last pull request.
+    int64_t     pendingMsgs;
+    int64_t     pendingBytes;
+    bool        stalled;
 } jsFetch;
 
+// Asynchronous acks of a JetStream subscription buffered to be sent
+// together (see jsSubOptions.AckBatchSize).
+typedef struct __jsAckBatch
+{
+    natsMutex   *mu;
+    natsTimer   *timer;
+    int         size;
+    bool        ackAll;
+
+    // Ack subjects, each one NUL terminated, and their offsets in the buffer.
+    natsBuffer  *replies;
+    int         *offsets;
+    int         pending;
+
+    // Number of acks buffered since the last send. With AckAll, this can
+    // be more than `pending` since only the highest sequence is kept.
+    int         count;
+    uint64_t    ackAllSeq;
+
+    // Used to build the batch when sending, sized to `size`.
+    natsMsg     *msgs;
+    natsMsg     **ptrs;
+
+} jsAckBatch;
+
 typedef struct __jsSub
 {
     jsCtx               *js;
@@ -535,6 +661,9 @@ typedef struct __jsSub
     // When resetting an OrderedConsumer, need the original configuration.
     jsConsumerConfig    *ocCfg;
 
+    // Set when acks are batched, immutable after creation.
+    jsAckBatch          *ackBatch;
+
 } jsSub;
 
 struct __kvStore
@@ -728,6 +857,10 @@ struct __natsSubscription
     natsMsgHandler              msgCb;
     void                        *msgCbClosure;
 
+    // If set, messages are delivered to this callback (with msgCbClosure)
+    // instead, possibly several at a time.
+    natsMsgBatchHandler         batchCb;
+
     int64_t                     timeout;
     natsTimer                   *timeoutTimer;
     bool                        timedOut;
@@ -794,6 +927,24 @@ typedef struct __natsSockCtx
     natsProxyConnHandler    proxyConnectCb;
     void                    *proxyConnectClosure;
 
+    // Number of recv()/SSL_read() calls, bytes read, and waits for the socket
+    // to be ready within or before a read, updated atomically.
+    uint64_t                readCalls;
+    uint64_t                readBytes;
+    uint64_t                readWaits;
+
+    // Set when the kernel took over the TLS record layer for the given
+    // direction (kTLS), in which case plain send()/recv() can be used.
+    bool                    ktlsSend;
+    bool                    ktlsRecv;
+
+    // When the TLS session uses memory BIOs, sslMu protects only the SSL
+    // object, and tlsSendMu serializes the sending of encrypted data, which
+    // is staged in tlsOut.
+    bool                    tlsMemBIO;
+    natsMutex               *tlsSendMu;
+    char                    *tlsOut;
+
 } natsSockCtx;
 
 typedef struct __respInfo
@@ -832,6 +983,30 @@ typedef struct __respMuxer
 
 } respMuxer;
 
+// Data published with natsConnection_PublishNoCopy() that is referenced,
+// not copied, until it is written to the socket along with `nc->bw`.
+typedef struct __natsWriteRef
+{
+    int                         pos;    // Position in `nc->bw` the data follows.
+    const char                  *data;
+    int                         dataLen;
+    natsPublishReleaseHandler   cb;
+    void                        *closure;
+
+} natsWriteRef;
+
+// References to user data to be written, in order, with an outbound buffer.
+typedef struct __natsWriteRefs
+{
+    natsWriteRef    *list;
+    int             count;
+    int             cap;
+    int64_t         bytes;
+    natsIOVec       *iov;
+    int             iovCap;
+
+} natsWriteRefs;
+
 struct __natsConnection
 {
     natsMutex           *mu;
@@ -851,11 +1026,30 @@ struct __natsConnection
     natsBuffer          *bw;
     natsBuffer          *scratch;
 
+    // References to user data to be written, in order, with `bw`.
+    natsWriteRefs       wrefs;
+
+    // The flusher thread swaps `bw` and `wrefs` with these (empty) ones and
+    // writes them without holding the lock, but holding `writeMu`. Until it
+    // is done, `flushing` is true: data is buffered instead of being written
+    // in place, in place flushes acquire `writeMu` and publishers wait on
+    // `flushingCond` once `bw` is full.
+    natsBuffer          *bwOut;
+    natsWriteRefs       wrefsOut;
+    bool                flushing;
+    natsMutex           *writeMu;
+    natsCondition       *flushingCond;
+
     natsServerInfo      info;
 
     int64_t             ssid;
     natsHash            *subs;
     natsMutex           *subsMu;
+    // The read loop looks up `subs` without holding `subsMu`: writers make
+    // `subsSeq` odd while they modify the hash, and wait for `subsReaders`
+    // to drop to 0 before freeing what a lookup may still reference.
+    int                 subsSeq;
+    int                 subsReaders;
 
     microService        **services;
     int                 numServices;
@@ -889,6 +1083,13 @@ struct __natsConnection
     // only a single write is pending (sparse traffic or a synchronous
     // request/reply or KV loop).
     int64_t             flusherKicks;
+    // Used when the flusher's wait is adapted to the write rate (see
+    // `flusherTargetRate` option): number of writes buffered since the
+    // start of the current measurement period, start of the period and
+    // current accumulation wait (in microseconds).
+    int64_t             flusherWrites;
+    int64_t             flusherPeriodStart;
+    int64_t             flusherWindow;
 
     natsThread          *reconnectThread;
     int                 inReconnect;
@@ -896,6 +1097,15 @@ struct __natsConnection
 
     natsStatistics      stats;
 
+    // Pool of inbound messages, if enabled through options.
+    natsMsgPool         *msgPool;
+
+    // Pool of read chunks, if zero-copy messages are enabled.
+    natsReadChunkPool   *readChunks;
+
+    // Current size of the read loop buffer, updated atomically.
+    int                 readBufSize;
+
     natsThread          *drainThread;
     int64_t             drainTimeout;
     bool                dontSendInPlace;
@@ -922,12 +1132,14 @@ struct __natsConnection
         bool            attached;
         bool            writeAdded;
         bool            retained;   // Will be set to true at the very first successful attach.
+        bool            libIO;      // Serviced by one of the library's I/O threads (io_uring or I/O pool).
+        bool            resetParser; // Parser state is from the socket before the last attach.
         void            *buffer;
         void            *data;
     } el;
 
     // Msg filters for testing.
-    // Protected by subsMu
+    // Protected by subsMu, and updated as a `subs` change (see subsSeq).
     natsMsgFilter       filter;
     void                *filterClosure;
 
@@ -940,6 +1152,16 @@ struct __natsConnection
     } srvVersion;
 };
 
+struct __natsPublisher
+{
+    natsConnection      *nc;
+
+    // The encoded "PUB <subject> " protocol prefix, and its length.
+    char                *proto;
+    int                 protoLen;
+
+};
+
 void
 nats_setNATSThreadKey(void);
 
@@ -1083,6 +1305,9 @@ jsSub_checkOrderedMsg(natsSubscription *sub, natsMsg *msg, bool *reset);
 natsStatus
 jsSub_resetOrderedConsumer(natsSubscription *sub, uint64_t sseq);
 
+natsStatus
+jsSub_flushAcks(natsSubscription *sub);
+
 bool
 natsMsg_isJSCtrl(natsMsg *msg, int *ctrlType);
 
@@ -436,6 +436,38 @@ natsOptions_AllowConcurrentTLSHandshakes(natsOptions *opts)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+natsStatus
+natsOptions_TLSKernelOffload(natsOptions *opts)
+{
+    natsStatus s = NATS_OK;
+
+    LOCK_AND_CHECK_OPTIONS(opts, 0);
+
+    s = _getSSLCtx(opts);
+    if (s == NATS_OK)
+        opts->tlsKernelOffload = true;
+
+    UNLOCK_OPTS(opts);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsOptions_TLSMemoryBIO(natsOptions *opts)
+{
+    natsStatus s = NATS_OK;
+
+    LOCK_AND_CHECK_OPTIONS(opts, 0);
+
+    s = _getSSLCtx(opts);
+    if (s == NATS_OK)
+        opts->tlsMemoryBIO = true;
+
+    UNLOCK_OPTS(opts);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 natsStatus
 natsOptions_LoadCATrustedCertificates(natsOptions *opts, const char *fileName)
 {
@@ -892,6 +924,18 @@ natsOptions_AllowConcurrentTLSHandshakes(natsOptions *opts)
     return nats_setError(NATS_ILLEGAL_STATE, "%s", NO_SSL_ERR);
 }
 
+natsStatus
+natsOptions_TLSKernelOffload(natsOptions *opts)
+{
+    return nats_setError(NATS_ILLEGAL_STATE, "%s", NO_SSL_ERR);
+}
+
+natsStatus
+natsOptions_TLSMemoryBIO(natsOptions *opts)
+{
+    return nats_setError(NATS_ILLEGAL_STATE, "%s", NO_SSL_ERR);
+}
+
 natsStatus
 natsOptions_LoadCATrustedCertificates(natsOptions *opts, const char *fileName)
 {
@@ -1297,6 +1341,30 @@ natsOptions_UseGlobalMessageDelivery(natsOptions *opts, bool global)
     return NATS_OK;
 }
 
+natsStatus
+natsOptions_UseLockFreeDispatchQueue(natsOptions *opts, bool lockFree)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, 0);
+
+    opts->lockFreeDispatchQueue = lockFree;
+
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
+natsStatus
+natsOptions_SetDispatchBatchSize(natsOptions *opts, int batchSize)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, ((batchSize < 1) || (batchSize > NATS_OPTS_MAX_DISPATCH_BATCH_SIZE)));
+
+    opts->dispatchBatchSize = batchSize;
+
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
 natsStatus
 natsOptions_IPResolutionOrder(natsOptions *opts, int order)
 {
@@ -1333,6 +1401,16 @@ natsOptions_SetFlusherWaitMicros(natsOptions *opts, int64_t flusherWaitUs)
     return NATS_OK;
 }
 
+natsStatus
+natsOptions_SetFlusherTargetRate(natsOptions *opts, int flushesPerSec)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, (flushesPerSec < 0));
+    opts->flusherTargetRate = flushesPerSec;
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
 natsStatus
 natsOptions_SetNoEcho(natsOptions *opts, bool noEcho)
 {
@@ -1736,6 +1814,58 @@ natsOptions_SetMessageBufferPadding(natsOptions *opts, int paddingSize)
     return NATS_OK;
 }
 
+natsStatus
+natsOptions_UseZeroCopyMessages(natsOptions *opts, bool zeroCopy)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, 0);
+
+    opts->zeroCopyMsgs = zeroCopy;
+
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
+natsStatus
+natsOptions_SetReadBufferLimits(natsOptions *opts, int minSize, int maxSize)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, ((minSize < 0)
+                                  || (maxSize < minSize)
+                                  || ((minSize == 0) != (maxSize == 0))));
+
+    opts->ioBufMinSize = minSize;
+    opts->ioBufMaxSize = maxSize;
+
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
+natsStatus
+natsOptions_UseReadBatching(natsOptions *opts, bool batching)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, 0);
+
+    opts->readBatching = batching;
+
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
+natsStatus
+natsOptions_UseMessagePool(natsOptions *opts, bool useMsgPool, int64_t maxRetainedBytes)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, (maxRetainedBytes < 0));
+
+    opts->useMsgPool        = useMsgPool;
+    opts->msgPoolMaxBytes   = (maxRetainedBytes == 0 ? NATS_OPTS_DEFAULT_MSG_POOL_MAX_BYTES : maxRetainedBytes);
+
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
 static void
 _freeOptions(natsOptions *opts)
 {
@@ -1793,6 +1923,8 @@ natsOptions_Create(natsOptions **newOpts)
     opts->reconnectJitter       = NATS_OPTS_DEFAULT_RECONNECT_JITTER;
     opts->reconnectJitterTLS    = NATS_OPTS_DEFAULT_RECONNECT_JITTER_TLS;
     opts->flusherWait           = NATS_OPTS_DEFAULT_FLUSHER_WAIT;
+    opts->msgPoolMaxBytes       = NATS_OPTS_DEFAULT_MSG_POOL_MAX_BYTES;
+    opts->dispatchBatchSize     = NATS_OPTS_DEFAULT_DISPATCH_BATCH_SIZE;
     opts->asyncErrCb            = natsConn_defaultErrHandler;
 
     // Override with values from the config (or from environment variables)
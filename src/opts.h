@@ -46,6 +46,9 @@ static inline void natsOptions_unlock(natsOptions *opts)
 #define NATS_OPTS_DEFAULT_RECONNECT_JITTER      (100)               // 100 ms
 #define NATS_OPTS_DEFAULT_RECONNECT_JITTER_TLS  (1000)              // 1 second
 #define NATS_OPTS_DEFAULT_FLUSHER_WAIT          (1000)              // 1000 microseconds
+#define NATS_OPTS_DEFAULT_MSG_POOL_MAX_BYTES    (4 * 1024 * 1024)   // 4 MB
+#define NATS_OPTS_DEFAULT_DISPATCH_BATCH_SIZE   (1)
+#define NATS_OPTS_MAX_DISPATCH_BATCH_SIZE       (256)
 
 natsOptions*
 natsOptions_clone(natsOptions *opts);
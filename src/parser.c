@@ -19,6 +19,14 @@
 #include "util.h"
 #include "mem.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define NATS_PARSER_SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 // cloneMsgArg is used when the split buffer scenario has the pubArg in the existing read buffer, but
 // we need to hold onto it into the next read.
 static natsStatus
@@ -221,6 +229,190 @@ _processMsgArgs(natsConnection *nc, char *buf, int bufLen)
     return s;
 }
 
+static inline int
+_firstBit(unsigned int m)
+{
+#if defined(_MSC_VER)
+    unsigned long idx;
+
+    _BitScanForward(&idx, m);
+    return (int) idx;
+#else
+    return __builtin_ctz(m);
+#endif
+}
+
+// Scans a control line from `i`, recording the position of up to `maxSpaces`
+// spaces. Returns the index of the '\n' terminating the line, or -1 if there
+// is none in `buf`, or if the line has more spaces than that or a tab.
+static int
+_scanMsgLine(const char *buf, int i, int bufLen, int *spaces, int maxSpaces, int *numSpaces)
+{
+    int n = 0;
+
+#ifdef NATS_PARSER_SSE2
+    const __m128i   sp  = _mm_set1_epi8(' ');
+    const __m128i   nl  = _mm_set1_epi8('\n');
+    const __m128i   tab = _mm_set1_epi8('\t');
+
+    // Classify 16 bytes at a time.
+    for (; i + 16 <= bufLen; i += 16)
+    {
+        __m128i         v   = _mm_loadu_si128((const __m128i*) (buf + i));
+        unsigned int    sm  = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(v, sp));
+        unsigned int    em  = (unsigned int) _mm_movemask_epi8(
+                                    _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, tab)));
+        int             e   = 16;
+
+        if (em != 0)
+        {
+            e = _firstBit(em);
+            if (buf[i + e] != '\n')
+                return -1;
+
+            sm &= (1U << e) - 1;
+        }
+        for (; sm != 0; sm &= sm - 1)
+        {
+            if (n == maxSpaces)
+                return -1;
+            spaces[n++] = i + _firstBit(sm);
+        }
+        if (e < 16)
+        {
+            *numSpaces = n;
+            return i + e;
+        }
+    }
+#endif
+    for (; i < bufLen; i++)
+    {
+        char b = buf[i];
+
+        if (b == ' ')
+        {
+            if (n == maxSpaces)
+                return -1;
+            spaces[n++] = i;
+        }
+        else if (b == '\n')
+        {
+            *numSpaces = n;
+            return i;
+        }
+        else if (b == '\t')
+        {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+// Parses a non-negative integer of at most 18 digits without branching on
+// each digit. Returns -1 if empty, too long or not all digits.
+static inline int64_t
+_parseMsgInt(const char *d, int dLen)
+{
+    int64_t         n   = 0;
+    unsigned int    bad = 0;
+    int             i;
+
+    if ((dLen <= 0) || (dLen > 18))
+        return -1;
+
+    for (i=0; i<dLen; i++)
+    {
+        unsigned int dec = (unsigned int) (unsigned char) d[i] - '0';
+
+        bad |= (dec > 9);
+        n = (n * 10) + dec;
+    }
+    return (bad ? -1 : n);
+}
+
+// Fast path for a MSG or HMSG control line that is complete in `buf` from
+// index `i` and in the form sent by the server: upper case, single spaces
+// and CRLF. Sets the message arguments as _processMsgArgs() would and
+// returns the index of the line's '\n'. Returns -1, without touching the
+// parser state, for anything else (split line, tabs, errors...), which is
+// then handled by the byte state machine.
+static int
+_parseMsgArgsFast(natsConnection *nc, char *buf, int bufLen, int i)
+{
+    natsParser  *ps     = nc->ps;
+    bool        hasHdr  = (buf[i] == 'H');
+    int         start   = i + (hasHdr ? 5 : 4);
+    int         seps[5];
+    int         numSeps = 0;
+    int         numArgs;
+    int         end;
+    int         k;
+    int64_t     sid;
+    int64_t     hdr     = -1;
+    int64_t     size;
+
+    if ((start >= bufLen)
+        || (memcmp(buf + i, (hasHdr ? "HMSG " : "MSG "), start - i) != 0))
+    {
+        return -1;
+    }
+
+    // Record the spaces between arguments, then the '\r' as the end of the
+    // last one.
+    end = _scanMsgLine(buf, start, bufLen, seps, 4, &numSeps);
+    if ((end < 0) || (buf[end - 1] != '\r'))
+        return -1;
+
+    seps[numSeps] = end - 1;
+    numArgs = numSeps + 1;
+    if (hasHdr ? ((numArgs != 4) && (numArgs != 5)) : ((numArgs != 3) && (numArgs != 4)))
+        return -1;
+
+    // No empty argument
+    if (seps[0] == start)
+        return -1;
+    for (k = 1; k < numArgs; k++)
+    {
+        if (seps[k] == seps[k - 1] + 1)
+            return -1;
+    }
+
+    sid  = _parseMsgInt(buf + seps[0] + 1, seps[1] - seps[0] - 1);
+    size = _parseMsgInt(buf + seps[numArgs - 2] + 1, seps[numArgs - 1] - seps[numArgs - 2] - 1);
+    if (hasHdr)
+        hdr = _parseMsgInt(buf + seps[numArgs - 3] + 1, seps[numArgs - 2] - seps[numArgs - 3] - 1);
+
+    if ((sid < 0) || (size < 0) || (size > INT32_MAX)
+        || (hasHdr && ((hdr < 0) || (hdr > size))))
+    {
+        return -1;
+    }
+
+    if (natsBuf_InitWithBackend(&(ps->ma.subjectRec), buf + start,
+                                seps[0] - start, seps[0] - start) != NATS_OK)
+    {
+        return -1;
+    }
+    ps->ma.subject = &(ps->ma.subjectRec);
+    ps->ma.reply   = NULL;
+    if (numArgs == (hasHdr ? 5 : 4))
+    {
+        if (natsBuf_InitWithBackend(&(ps->ma.replyRec), buf + seps[1] + 1,
+                                    seps[2] - seps[1] - 1, seps[2] - seps[1] - 1) != NATS_OK)
+        {
+            return -1;
+        }
+        ps->ma.reply = &(ps->ma.replyRec);
+    }
+
+    ps->hdr     = (hasHdr ? 0 : -1);
+    ps->ma.hdr  = (int) hdr;
+    ps->ma.sid  = sid;
+    ps->ma.size = (int) size;
+
+    return end;
+}
+
 // parse is the fast protocol parser engine.
 natsStatus
 natsParser_Parse(natsConnection *nc, char* buf, int bufLen)
@@ -237,6 +429,34 @@ natsParser_Parse(natsConnection *nc, char* buf, int bufLen)
         {
             case OP_START:
             {
+                int end;
+
+                // Complete MSG/HMSG control lines don't need to go through
+                // the state machine one byte at a time.
+                if (((b == 'M') || (b == 'H'))
+                    && ((end = _parseMsgArgsFast(nc, buf, bufLen, i)) > 0))
+                {
+                    int msgEnd = end + 1 + nc->ps->ma.size;
+
+                    nc->ps->drop       = 0;
+                    nc->ps->afterSpace = end + 1;
+
+                    // If the whole message is there, process it right away,
+                    // otherwise continue as the MSG_ARG state would.
+                    if ((msgEnd + 1 < bufLen)
+                        && (buf[msgEnd] == '\r') && (buf[msgEnd + 1] == '\n'))
+                    {
+                        s = natsConn_processMsg(nc, buf + end + 1, nc->ps->ma.size);
+                        nc->ps->afterSpace = msgEnd + 2;
+                        i = msgEnd + 1;
+                    }
+                    else
+                    {
+                        nc->ps->state = MSG_PAYLOAD;
+                        i = msgEnd - 1;
+                    }
+                    break;
+                }
                 switch (b)
                 {
                     case 'M':
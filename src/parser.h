@@ -83,6 +83,11 @@ typedef struct __natsParser
     natsBuffer  *msgBuf;
     char        scratch[MAX_CONTROL_LINE_SIZE];
 
+    // If not NULL, the read chunk holding the 'chunkLen' bytes being
+    // parsed, that messages can point into.
+    struct __natsReadChunk  *chunk;
+    int                     chunkLen;
+
 } natsParser;
 
 // This is defined in natsp.h, natsp.h includes us. Alternatively, we can move
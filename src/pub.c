@@ -45,59 +45,72 @@ static const char *digits = "0123456789";
 // string representation of a hdr/msg size. See GETBYTES_SIZE.
 #define BYTES_SIZE_MAX (12)
 
-// _publish is the internal function to publish messages to a nats server.
-// Sends a protocol data message by queueing into the bufio writer
-// and kicking the flusher thread. These writes should be protected.
-natsStatus
-natsConn_publish(natsConnection *nc, natsMsg *msg, const char *reply, bool directFlush)
+// Information about a message to publish, computed by _prepareMsg()
+// and used by _writeMsg().
+typedef struct __pubMsgInfo
 {
-    natsStatus  s               = NATS_OK;
-    int         msgHdSize       = 0;
-    char        dlb[BYTES_SIZE_MAX];
-    int         dli             = BYTES_SIZE_MAX;
-    int         dlSize          = 0;
-    char        hlb[BYTES_SIZE_MAX];
-    int         hli             = BYTES_SIZE_MAX;
-    int         hlSize          = 0;
-    int         subjLen         = 0;
-    int         replyLen        = 0;
-    bool        reconnecting    = false;
-    int         ppo             = 1; // pub proto offset
-    int         hdrl            = 0;
-    int         totalLen        = 0;
+    const char  *reply;
+    int         subjLen;
+    int         replyLen;
+    int         hdrl;
+    int         totalLen;
 
-    if (nc == NULL)
-        return nats_setDefaultError(NATS_INVALID_ARG);
-
-    if ((msg->subject == NULL)
-        || ((subjLen = (int) strlen(msg->subject)) == 0))
-    {
-        return nats_setDefaultError(NATS_INVALID_SUBJECT);
-    }
+} pubMsgInfo;
 
-    // If a reply is provided through params, use that one,
-    // otherwise fallback to msg->reply.
-    if (reply == NULL)
-        reply = msg->reply;
+// Checks the state of the connection for publishing.
+// Connection lock held on entry.
+static natsStatus
+_checkPubState(natsConnection *nc)
+{
+    if (natsConn_isClosed(nc))
+        return nats_setDefaultError(NATS_CONNECTION_CLOSED);
 
-    replyLen = ((reply != NULL) ? (int) strlen(reply) : 0);
+    if (natsConn_isDrainingPubs(nc))
+        return nats_setDefaultError(NATS_DRAINING);
 
-    natsConn_Lock(nc);
+    return NATS_OK;
+}
 
-    if (natsConn_isClosed(nc))
+// Prepares the connection for writing a message: when reconnecting, checks
+// that the pending buffer is not full and records its current position in
+// `pos`, so that a failed write can be undone. Otherwise, sets the write
+// deadline.
+// Connection lock held on entry.
+static natsStatus
+_startWrite(natsConnection *nc, bool *reconnecting, int *pos)
+{
+    if ((*reconnecting = natsConn_isReconnecting(nc)))
     {
-        natsConn_Unlock(nc);
+        // Check if we are over
+        if (natsBuf_Len(nc->pending) >= nc->opts->reconnectBufSize)
+            return nats_setDefaultError(NATS_INSUFFICIENT_BUFFER);
 
-        return nats_setDefaultError(NATS_CONNECTION_CLOSED);
+        *pos = natsBuf_Len(nc->pending);
     }
-
-    if (natsConn_isDrainingPubs(nc))
+    else
     {
-        natsConn_Unlock(nc);
+        SET_WRITE_DEADLINE(nc);
+    }
+    return NATS_OK;
+}
 
-        return nats_setDefaultError(NATS_DRAINING);
+// Validates the message and computes the information needed to encode it.
+// Connection lock held on entry.
+static natsStatus
+_prepareMsg(natsConnection *nc, natsMsg *msg, const char *reply, pubMsgInfo *pi)
+{
+    if ((msg->subject == NULL)
+        || ((pi->subjLen = (int) strlen(msg->subject)) == 0))
+    {
+        return nats_setDefaultError(NATS_INVALID_SUBJECT);
     }
 
+    // If a reply is provided through params, use that one,
+    // otherwise fallback to msg->reply.
+    pi->reply    = (reply != NULL ? reply : msg->reply);
+    pi->replyLen = ((pi->reply != NULL) ? (int) strlen(pi->reply) : 0);
+    pi->hdrl     = 0;
+
     // We can have headers NULL but needsLift which means we are in special
     // situation where a message was received and is sent back without the user
     // accessing the headers. It should still be considered having headers.
@@ -108,105 +121,161 @@ natsConn_publish(natsConnection *nc, natsMsg *msg, const char *reply, bool direc
         // connect in progress - when using natsOptions_SetRetryOnFailedConnect
         // option).
         if (!nc->initc && !nc->info.headers)
-        {
-            natsConn_Unlock(nc);
-
             return nats_setDefaultError(NATS_NO_SERVER_SUPPORT);
-        }
 
-        hdrl = natsMsgHeader_encodedLen(msg);
-        if (hdrl > 0)
-        {
-            GETBYTES_SIZE(hdrl, hlb, hli)
-            hlSize = (BYTES_SIZE_MAX - hli);
-            ppo = 0;
-            totalLen = hdrl;
-        }
+        pi->hdrl = natsMsgHeader_encodedLen(msg);
     }
     // This will represent headers + data
-    totalLen += msg->dataLen;
+    pi->totalLen = pi->hdrl + msg->dataLen;
 
-    if (!nc->initc && ((int64_t) totalLen > nc->info.maxPayload))
+    if (!nc->initc && ((int64_t) pi->totalLen > nc->info.maxPayload))
     {
-        natsConn_Unlock(nc);
-
         return nats_setError(NATS_MAX_PAYLOAD,
                              "Payload %d greater than maximum allowed: %" PRId64,
-                             totalLen, nc->info.maxPayload);
+                             pi->totalLen, nc->info.maxPayload);
     }
 
-    // Check if we are reconnecting, and if so check if
-    // we have exceeded our reconnect outbound buffer limits.
-    if ((reconnecting = natsConn_isReconnecting(nc)))
+    return NATS_OK;
+}
+
+// Encodes the protocol (and headers) of a message previously checked with
+// _prepareMsg() and writes it, along with the payload, to the connection.
+// When the protocol fits in the outbound buffer, it is encoded there directly,
+// otherwise it goes through the scratch buffer.
+// If `releaseCb` is not NULL, the payload is referenced instead of copied,
+// see _publish().
+// Connection lock held on entry.
+static natsStatus
+_writeMsg(natsConnection *nc, natsMsg *msg, pubMsgInfo *pi,
+          natsPublishReleaseHandler releaseCb, void *releaseClosure, bool *refOwned)
+{
+    natsStatus  s               = NATS_OK;
+    int         msgHdSize       = 0;
+    char        dlb[BYTES_SIZE_MAX];
+    int         dli             = BYTES_SIZE_MAX;
+    int         dlSize          = 0;
+    char        hlb[BYTES_SIZE_MAX];
+    int         hli             = BYTES_SIZE_MAX;
+    int         hlSize          = 0;
+    int         ppo             = 1; // pub proto offset
+    natsBuffer  *hb             = nc->scratch;
+    bool        direct          = false;
+
+    if (pi->hdrl > 0)
     {
-        // Check if we are over
-        if (natsBuf_Len(nc->pending) >= nc->opts->reconnectBufSize)
-        {
-            natsConn_Unlock(nc);
-            return nats_setDefaultError(NATS_INSUFFICIENT_BUFFER);
-        }
+        GETBYTES_SIZE(pi->hdrl, hlb, hli)
+        hlSize = (BYTES_SIZE_MAX - hli);
+        ppo = 0;
     }
 
-    GETBYTES_SIZE(totalLen, dlb, dli)
+    GETBYTES_SIZE(pi->totalLen, dlb, dli)
     dlSize = (BYTES_SIZE_MAX - dli);
 
     // We include the NATS headers in the message header scratch.
     msgHdSize = (_HPUB_P_LEN_ - ppo)
-                + subjLen + 1
-                + (replyLen > 0 ? replyLen + 1 : 0)
-                + (hdrl > 0 ? hlSize + 1 + hdrl : 0)
+                + pi->subjLen + 1
+                + (pi->replyLen > 0 ? pi->replyLen + 1 : 0)
+                + (pi->hdrl > 0 ? hlSize + 1 + pi->hdrl : 0)
                 + dlSize + _CRLF_LEN_;
 
-    natsBuf_MoveTo(nc->scratch, _HPUB_P_LEN_);
+    direct = (!nc->usePending
+              && !nc->sockCtx.useEventLoop
+              && (nc->bw != NULL)
+              && (natsBuf_Available(nc->bw) >= msgHdSize));
 
-    if (natsBuf_Capacity(nc->scratch) < msgHdSize)
+    if (direct)
     {
-        // Although natsBuf_Append() would make sure that the buffer
-        // grows, it is better to make sure that the buffer is big
-        // enough for the pre-calculated size. We make it even a bit bigger.
-        s = natsBuf_Expand(nc->scratch, (int) ((float)msgHdSize * 1.1));
+        hb = nc->bw;
+        s = natsBuf_Append(hb, _HPUB_P_ + ppo, _HPUB_P_LEN_ - ppo);
+    }
+    else
+    {
+        natsBuf_MoveTo(nc->scratch, _HPUB_P_LEN_);
+
+        if (natsBuf_Capacity(nc->scratch) < msgHdSize)
+        {
+            // Although natsBuf_Append() would make sure that the buffer
+            // grows, it is better to make sure that the buffer is big
+            // enough for the pre-calculated size. We make it even a bit bigger.
+            s = natsBuf_Expand(nc->scratch, (int) ((float)msgHdSize * 1.1));
+        }
     }
 
     if (s == NATS_OK)
-        s = natsBuf_Append(nc->scratch, msg->subject, subjLen);
+        s = natsBuf_Append(hb, msg->subject, pi->subjLen);
     if (s == NATS_OK)
-        s = natsBuf_Append(nc->scratch, _SPC_, _SPC_LEN_);
-    if ((s == NATS_OK) && (reply != NULL))
+        s = natsBuf_Append(hb, _SPC_, _SPC_LEN_);
+    if ((s == NATS_OK) && (pi->reply != NULL))
     {
-        s = natsBuf_Append(nc->scratch, reply, replyLen);
+        s = natsBuf_Append(hb, pi->reply, pi->replyLen);
         if (s == NATS_OK)
-            s = natsBuf_Append(nc->scratch, _SPC_, _SPC_LEN_);
+            s = natsBuf_Append(hb, _SPC_, _SPC_LEN_);
     }
-    if ((s == NATS_OK) && (hdrl > 0))
+    if ((s == NATS_OK) && (pi->hdrl > 0))
     {
-        s = natsBuf_Append(nc->scratch, (hlb+hli), hlSize);
+        s = natsBuf_Append(hb, (hlb+hli), hlSize);
         if (s == NATS_OK)
-            s = natsBuf_Append(nc->scratch, _SPC_, _SPC_LEN_);
+            s = natsBuf_Append(hb, _SPC_, _SPC_LEN_);
     }
     if (s == NATS_OK)
-        s = natsBuf_Append(nc->scratch, (dlb+dli), dlSize);
+        s = natsBuf_Append(hb, (dlb+dli), dlSize);
     if (s == NATS_OK)
-        s = natsBuf_Append(nc->scratch, _CRLF_, _CRLF_LEN_);
-    if ((s == NATS_OK) && hdrl > 0)
-        s = natsMsgHeader_encode(nc->scratch, msg);
+        s = natsBuf_Append(hb, _CRLF_, _CRLF_LEN_);
+    if ((s == NATS_OK) && (pi->hdrl > 0))
+        s = natsMsgHeader_encode(hb, msg);
 
-    if (s == NATS_OK)
+    if ((s == NATS_OK) && !direct)
+        s = natsConn_bufferWrite(nc, natsBuf_Data(nc->scratch)+ppo, msgHdSize);
+
+    if ((s == NATS_OK) && (releaseCb != NULL))
     {
-        int pos = 0;
+        s = natsConn_bufferWriteRef(nc, msg->data, msg->dataLen,
+                                    releaseCb, releaseClosure);
+        if (s == NATS_OK)
+            *refOwned = true;
+    }
+    else if (s == NATS_OK)
+        s = natsConn_bufferWrite(nc, msg->data, msg->dataLen);
 
-        if (reconnecting)
-            pos = natsBuf_Len(nc->pending);
-        else
-            SET_WRITE_DEADLINE(nc);
+    if (s == NATS_OK)
+        s = natsConn_bufferWrite(nc, _CRLF_, _CRLF_LEN_);
 
-        s = natsConn_bufferWrite(nc, natsBuf_Data(nc->scratch)+ppo, msgHdSize);
+    return NATS_UPDATE_ERR_STACK(s);
+}
 
-        if (s == NATS_OK)
-            s = natsConn_bufferWrite(nc, msg->data, msg->dataLen);
+// _publish is the internal function to publish messages to a nats server.
+// Sends a protocol data message by queueing into the bufio writer
+// and kicking the flusher thread. These writes should be protected.
+// If `releaseCb` is not NULL, the message data is referenced instead of
+// copied and `*refOwned` is set to true once the connection has taken
+// ownership of the reference, that is, is responsible for invoking the
+// callback.
+static natsStatus
+_publish(natsConnection *nc, natsMsg *msg, const char *reply, bool directFlush,
+         natsPublishReleaseHandler releaseCb, void *releaseClosure, bool *refOwned)
+{
+    natsStatus  s               = NATS_OK;
+    bool        reconnecting    = false;
+    int         pos             = 0;
+    pubMsgInfo  pi;
 
-        if (s == NATS_OK)
-            s = natsConn_bufferWrite(nc, _CRLF_, _CRLF_LEN_);
+    if (nc == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    natsConn_Lock(nc);
+
+    natsConn_waitForBufferSpace(nc);
+
+    s = _checkPubState(nc);
+    IFOK(s, _prepareMsg(nc, msg, reply, &pi));
 
+    // Check if we are reconnecting, and if so check if
+    // we have exceeded our reconnect outbound buffer limits.
+    IFOK(s, _startWrite(nc, &reconnecting, &pos));
+
+    if (s == NATS_OK)
+    {
+        s = _writeMsg(nc, msg, &pi, releaseCb, releaseClosure, refOwned);
         if ((s != NATS_OK) && reconnecting)
             natsBuf_MoveTo(nc->pending, pos);
     }
@@ -222,7 +291,7 @@ natsConn_publish(natsConnection *nc, natsMsg *msg, const char *reply, bool direc
     if (s == NATS_OK)
     {
         nc->stats.outMsgs  += 1;
-        nc->stats.outBytes += totalLen;
+        nc->stats.outBytes += pi.totalLen;
     }
 
     natsConn_Unlock(nc);
@@ -230,6 +299,13 @@ natsConn_publish(natsConnection *nc, natsMsg *msg, const char *reply, bool direc
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+natsStatus
+natsConn_publish(natsConnection *nc, natsMsg *msg, const char *reply, bool directFlush)
+{
+    natsStatus s = _publish(nc, msg, reply, directFlush, NULL, NULL, NULL);
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 natsStatus
 natsConnection_Publish(natsConnection *nc, const char *subj,
                        const void *data, int dataLen)
@@ -272,6 +348,240 @@ natsConnection_PublishMsg(natsConnection *nc, natsMsg *msg)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+natsStatus
+natsConnection_PublishNoCopy(natsConnection *nc, const char *subj,
+                             const void *data, int dataLen,
+                             natsPublishReleaseHandler releaseCb, void *releaseClosure)
+{
+    natsStatus s;
+    natsMsg    msg;
+    bool       owned = false;
+
+    if (releaseCb == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    natsMsg_init(&msg, subj, (const char*) data, dataLen);
+    s = _publish(nc, &msg, NULL, false, releaseCb, releaseClosure, &owned);
+
+    // If the connection did not take ownership of the data, it is
+    // our responsibility to notify the user.
+    if (!owned)
+        (*releaseCb)(nc, data, dataLen, s, releaseClosure);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsConnection_PublishBatch(natsConnection *nc, natsMsg **msgs, int count)
+{
+    natsStatus  s               = NATS_OK;
+    bool        reconnecting    = false;
+    int         pos             = 0;
+    int64_t     bytes           = 0;
+    pubMsgInfo  *pis            = NULL;
+    pubMsgInfo  spis[64];
+    int         i;
+
+    if ((nc == NULL) || (msgs == NULL) || (count < 0))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    if (count == 0)
+        return NATS_OK;
+
+    for (i=0; i<count; i++)
+    {
+        if (msgs[i] == NULL)
+            return nats_setDefaultError(NATS_INVALID_ARG);
+    }
+
+    pis = spis;
+    if (count > (int) (sizeof(spis)/sizeof(pubMsgInfo)))
+    {
+        pis = (pubMsgInfo*) NATS_MALLOC(count * sizeof(pubMsgInfo));
+        if (pis == NULL)
+            return nats_setDefaultError(NATS_NO_MEMORY);
+    }
+
+    natsConn_Lock(nc);
+
+    natsConn_waitForBufferSpace(nc);
+
+    s = _checkPubState(nc);
+
+    // Validate all messages first so that none is sent if one is invalid.
+    for (i=0; (s == NATS_OK) && (i<count); i++)
+    {
+        s = _prepareMsg(nc, msgs[i], NULL, &(pis[i]));
+        if (s == NATS_OK)
+            bytes += pis[i].totalLen;
+    }
+
+    IFOK(s, _startWrite(nc, &reconnecting, &pos));
+
+    for (i=0; (s == NATS_OK) && (i<count); i++)
+    {
+        // When reconnecting, the pending buffer limit applies to each
+        // message, as it would for individual publish calls.
+        if (reconnecting && (natsBuf_Len(nc->pending) >= nc->opts->reconnectBufSize))
+            s = nats_setDefaultError(NATS_INSUFFICIENT_BUFFER);
+        else
+            s = _writeMsg(nc, msgs[i], &(pis[i]), NULL, NULL, NULL);
+    }
+
+    if ((s != NATS_OK) && reconnecting)
+        natsBuf_MoveTo(nc->pending, pos);
+
+    if ((s == NATS_OK) && !reconnecting)
+        s = natsConn_flushOrKickFlusher(nc);
+
+    if (s == NATS_OK)
+    {
+        nc->stats.outMsgs  += (uint64_t) count;
+        nc->stats.outBytes += (uint64_t) bytes;
+    }
+
+    natsConn_Unlock(nc);
+
+    if (pis != spis)
+        NATS_FREE(pis);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsConnection_PreparePublisher(natsPublisher **newPub, natsConnection *nc,
+                                const char *subj)
+{
+    natsPublisher   *pub     = NULL;
+    int             subjLen  = 0;
+
+    if ((newPub == NULL) || (nc == NULL))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    if ((subj == NULL) || ((subjLen = (int) strlen(subj)) == 0))
+        return nats_setDefaultError(NATS_INVALID_SUBJECT);
+
+    pub = (natsPublisher*) NATS_CALLOC(1, sizeof(natsPublisher));
+    if (pub == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    // The "PUB " protocol is "HPUB " without the leading 'H'.
+    pub->protoLen = (_HPUB_P_LEN_ - 1) + subjLen + _SPC_LEN_;
+    pub->proto    = (char*) NATS_MALLOC(pub->protoLen);
+    if (pub->proto == NULL)
+    {
+        NATS_FREE(pub);
+        return nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    memcpy(pub->proto, _HPUB_P_ + 1, _HPUB_P_LEN_ - 1);
+    memcpy(pub->proto + _HPUB_P_LEN_ - 1, subj, subjLen);
+    memcpy(pub->proto + _HPUB_P_LEN_ - 1 + subjLen, _SPC_, _SPC_LEN_);
+
+    natsConn_retain(nc);
+    pub->nc = nc;
+
+    *newPub = pub;
+
+    return NATS_OK;
+}
+
+// Writes the protocol and payload of a message published with a prepared
+// publisher. Only the size needs to be encoded, the rest of the protocol
+// is copied as is.
+// Connection lock held on entry.
+static natsStatus
+_writePublisherMsg(natsConnection *nc, natsPublisher *pub, const void *data, int dataLen)
+{
+    natsStatus  s   = NATS_OK;
+    char        dlb[BYTES_SIZE_MAX+_CRLF_LEN_];
+    int         dli = BYTES_SIZE_MAX;
+    int         dlSize;
+
+    memcpy(dlb+BYTES_SIZE_MAX, _CRLF_, _CRLF_LEN_);
+    GETBYTES_SIZE(dataLen, dlb, dli)
+    dlSize = (BYTES_SIZE_MAX + _CRLF_LEN_ - dli);
+
+    if (!nc->usePending
+        && !nc->sockCtx.useEventLoop
+        && (nc->bw != NULL)
+        && (natsBuf_Available(nc->bw) >= pub->protoLen + dlSize))
+    {
+        s = natsBuf_Append(nc->bw, pub->proto, pub->protoLen);
+        if (s == NATS_OK)
+            s = natsBuf_Append(nc->bw, (dlb+dli), dlSize);
+    }
+    else
+    {
+        s = natsConn_bufferWrite(nc, pub->proto, pub->protoLen);
+        if (s == NATS_OK)
+            s = natsConn_bufferWrite(nc, (dlb+dli), dlSize);
+    }
+    if (s == NATS_OK)
+        s = natsConn_bufferWrite(nc, (const char*) data, dataLen);
+    if (s == NATS_OK)
+        s = natsConn_bufferWrite(nc, _CRLF_, _CRLF_LEN_);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsPublisher_Publish(natsPublisher *pub, const void *data, int dataLen)
+{
+    natsStatus      s               = NATS_OK;
+    natsConnection  *nc             = NULL;
+    bool            reconnecting    = false;
+    int             pos             = 0;
+
+    if ((pub == NULL) || (dataLen < 0) || ((data == NULL) && (dataLen > 0)))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    nc = pub->nc;
+
+    natsConn_Lock(nc);
+
+    natsConn_waitForBufferSpace(nc);
+
+    s = _checkPubState(nc);
+    if ((s == NATS_OK) && !nc->initc && ((int64_t) dataLen > nc->info.maxPayload))
+    {
+        s = nats_setError(NATS_MAX_PAYLOAD,
+                          "Payload %d greater than maximum allowed: %" PRId64,
+                          dataLen, nc->info.maxPayload);
+    }
+    IFOK(s, _startWrite(nc, &reconnecting, &pos));
+
+    if (s == NATS_OK)
+    {
+        s = _writePublisherMsg(nc, pub, data, dataLen);
+        if ((s != NATS_OK) && reconnecting)
+            natsBuf_MoveTo(nc->pending, pos);
+    }
+
+    if ((s == NATS_OK) && !reconnecting)
+        s = natsConn_flushOrKickFlusher(nc);
+
+    if (s == NATS_OK)
+    {
+        nc->stats.outMsgs  += 1;
+        nc->stats.outBytes += dataLen;
+    }
+
+    natsConn_Unlock(nc);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+void
+natsPublisher_Destroy(natsPublisher *pub)
+{
+    if (pub == NULL)
+        return;
+
+    natsConn_release(pub->nc);
+    NATS_FREE(pub->proto);
+    NATS_FREE(pub);
+}
+
 natsStatus
 natsConnection_PublishRequest(natsConnection *nc, const char *subj,
                               const char *reply, const void *data, int dataLen)
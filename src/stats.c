@@ -55,6 +55,89 @@ natsStatistics_GetCounts(const natsStatistics *stats,
     return NATS_OK;
 }
 
+natsStatus
+natsStatistics_GetMsgPoolCounts(const natsStatistics *stats,
+                                uint64_t *hits, uint64_t *misses,
+                                int64_t *retainedBytes)
+{
+    if (stats == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    if (hits != NULL)
+        *hits = stats->msgPoolHits;
+    if (misses != NULL)
+        *misses = stats->msgPoolMisses;
+    if (retainedBytes != NULL)
+        *retainedBytes = stats->msgPoolRetained;
+
+    return NATS_OK;
+}
+
+natsStatus
+natsStatistics_GetReadCounts(const natsStatistics *stats,
+                             uint64_t *readCalls, uint64_t *readBytes,
+                             int *bufSize)
+{
+    if (stats == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    if (readCalls != NULL)
+        *readCalls = stats->readCalls;
+    if (readBytes != NULL)
+        *readBytes = stats->readBytes;
+    if (bufSize != NULL)
+        *bufSize = stats->readBufSize;
+
+    return NATS_OK;
+}
+
+natsStatus
+natsStatistics_GetReadWaits(const natsStatistics *stats, uint64_t *readWaits)
+{
+    if ((stats == NULL) || (readWaits == NULL))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    *readWaits = stats->readWaits;
+
+    return NATS_OK;
+}
+
+natsStatus
+natsStatistics_GetFlushCounts(const natsStatistics *stats,
+                              uint64_t *flushes, uint64_t *flushedBytes,
+                              int64_t *windowUs)
+{
+    if (stats == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    if (flushes != NULL)
+        *flushes = stats->flushes;
+    if (flushedBytes != NULL)
+        *flushedBytes = stats->flushedBytes;
+    if (windowUs != NULL)
+        *windowUs = stats->flusherWindow;
+
+    return NATS_OK;
+}
+
+natsStatus
+natsStatistics_GetTLSOffloadCounts(const natsStatistics *stats,
+                                   uint64_t *handshakes, uint64_t *sendOffloads,
+                                   uint64_t *recvOffloads)
+{
+    if (stats == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    if (handshakes != NULL)
+        *handshakes = stats->tlsHandshakes;
+    if (sendOffloads != NULL)
+        *sendOffloads = stats->tlsSendOffloads;
+    if (recvOffloads != NULL)
+        *recvOffloads = stats->tlsRecvOffloads;
+
+    return NATS_OK;
+}
+
 void
 natsStatistics_Destroy(natsStatistics *stats)
 {
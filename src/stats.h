@@ -26,6 +26,19 @@ struct __natsStatistics
     uint64_t    inBytes;
     uint64_t    outBytes;
     uint64_t    reconnects;
+    uint64_t    msgPoolHits;
+    uint64_t    msgPoolMisses;
+    int64_t     msgPoolRetained;
+    uint64_t    readCalls;
+    uint64_t    readBytes;
+    uint64_t    readWaits;
+    int         readBufSize;
+    uint64_t    flushes;
+    uint64_t    flushedBytes;
+    int64_t     flusherWindow;
+    uint64_t    tlsHandshakes;
+    uint64_t    tlsSendOffloads;
+    uint64_t    tlsRecvOffloads;
 
 };
 
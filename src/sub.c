@@ -198,6 +198,10 @@ _setDrainCompleteState(natsSubscription *sub)
 
 void natsSub_setDrainCompleteState(natsSubscription *sub)
 {
+    // This is called before the subscription is removed, whether it has been
+    // drained or has reached its limit, so send the acks it may have buffered.
+    jsSub_flushAcks(sub);
+
     natsSub_Lock(sub);
     _setDrainCompleteState(sub);
     natsSub_Unlock(sub);
@@ -212,7 +216,15 @@ _runOwnDispatcher(natsSubscription *sub, bool forReplies)
         return NATS_ILLEGAL_STATE; // already running
 
     sub->dispatcher = &sub->ownDispatcher;
-    s = natsThread_Create(&sub->ownDispatcher.thread, nats_dispatchThreadOwn, (void *) sub);
+    if (sub->conn->opts->lockFreeDispatchQueue)
+    {
+        s = nats_initLockFreeQueue(&sub->ownDispatcher.queue);
+        // JetStream messages are always queued and processed under the lock.
+        if ((s == NATS_OK) && (sub->jsi != NULL))
+            sub->ownDispatcher.queue.locked = 1;
+    }
+    if (s == NATS_OK)
+        s = natsThread_Create(&sub->ownDispatcher.thread, nats_dispatchThreadOwn, (void *) sub);
     return s;
 }
 
@@ -221,7 +233,9 @@ bool natsSub_setMax(natsSubscription *sub, uint64_t max)
     bool accepted = false;
 
     nats_lockSubAndDispatcher(sub);
-    sub->max = (max <= sub->delivered ? 0 : max);
+    // The limit is checked under the lock, even in lock-free mode.
+    nats_lockQueue(&sub->ownDispatcher.queue);
+    sub->max = (max <= nats_atomicLoad64(&sub->delivered) ? 0 : max);
     accepted = sub->max != 0;
     nats_unlockSubAndDispatcher(sub);
     return accepted;
@@ -256,6 +270,7 @@ void natsSub_close(natsSubscription *sub, bool connectionClosed)
     {
         sub->closed = true;
         sub->connClosed = connectionClosed;
+        nats_lockQueue(&sub->ownDispatcher.queue);
 
         if (sub->jsi != NULL)
         {
@@ -263,6 +278,8 @@ void natsSub_close(natsSubscription *sub, bool connectionClosed)
                 natsTimer_Stop(sub->jsi->hbTimer);
             if ((sub->jsi->fetch != NULL) && (sub->jsi->fetch->expiresTimer != NULL))
                 natsTimer_Stop(sub->jsi->fetch->expiresTimer);
+            if ((sub->jsi->ackBatch != NULL) && (sub->jsi->ackBatch->timer != NULL))
+                natsTimer_Stop(sub->jsi->ackBatch->timer);
         }
 
         // If this is a subscription with timeout, stop the timer.
@@ -342,10 +359,18 @@ natsStatus nats_createControlMessages(natsSubscription *sub)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+// Message handler of subscriptions created with a batch handler, used when
+// their messages are delivered one at a time.
+static void
+_deliverToBatchHandler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+{
+    (*sub->batchCb)(nc, sub, &msg, 1, closure);
+}
+
 natsStatus
 natsSub_create(natsSubscription **newSub, natsConnection *nc, const char *subj,
                const char *queueGroup, int64_t timeout, natsMsgHandler cb, void *cbClosure,
-               bool forReplies, jsSub *jsi)
+               natsMsgBatchHandler batchCb, bool forReplies, jsSub *jsi)
 {
     natsStatus s = NATS_OK;
     natsSubscription *sub = NULL;
@@ -361,11 +386,15 @@ natsSub_create(natsSubscription **newSub, natsConnection *nc, const char *subj,
         return NATS_UPDATE_ERR_STACK(s);
     }
 
+    if (batchCb != NULL)
+        cb = _deliverToBatchHandler;
+
     sub->refs           = 1;
     sub->conn           = nc;
     sub->timeout        = timeout;
     sub->msgCb          = cb;
     sub->msgCbClosure   = cbClosure;
+    sub->batchCb        = batchCb;
     sub->msgsLimit      = nc->opts->maxPendingMsgs;
     sub->bytesLimit     = nc->opts->maxPendingBytes == -1 ? nc->opts->maxPendingMsgs * 1024 : (int)nc->opts->maxPendingBytes;;
     sub->jsi            = jsi;
@@ -449,6 +478,24 @@ natsConnection_Subscribe(natsSubscription **sub, natsConnection *nc, const char
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+/*
+ * Similar to natsConnection_Subscribe() except that messages are delivered
+ * to a natsMsgBatchHandler, possibly several at a time.
+ */
+natsStatus
+natsConnection_SubscribeBatch(natsSubscription **sub, natsConnection *nc, const char *subject,
+                              natsMsgBatchHandler cb, void *cbClosure)
+{
+    natsStatus s;
+
+    if (cb == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    s = natsConn_subscribeImpl(sub, nc, true, subject, NULL, 0, NULL, cbClosure, cb, false, NULL);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 /*
  * Similar to natsConnection_Subscribe() except that a timeout is given.
  * If the subscription has not receive any message for the given timeout,
@@ -762,6 +809,11 @@ _unsubscribe(natsSubscription *sub, int max, bool drainMode, int64_t timeout)
 
     s = natsConn_unsubscribe(nc, sub, max, drainMode, timeout);
 
+    // Now that the subscription is closed or draining, any new ack is sent
+    // directly, so send the ones that may have been buffered.
+    if (max == 0)
+        jsSub_flushAcks(sub);
+
     // If user calls natsSubscription_Unsubscribe() and this
     // is a JS subscription that is supposed to delete the JS
     // consumer, do so now.
@@ -797,6 +849,7 @@ void natsSub_drain(natsSubscription *sub)
         return;
     }
     sub->draining = true;
+    nats_lockQueue(&sub->ownDispatcher.queue);
 
     // If this is a subscription with timeout, stop the timer.
     if (sub->timeout != 0)
@@ -839,6 +892,7 @@ void natsSub_setDrainSkip(natsSubscription *sub, natsStatus s)
     nats_lockSubAndDispatcher(sub);
     _updateDrainStatus(sub, s);
     sub->drainSkip = true;
+    nats_lockQueue(&sub->ownDispatcher.queue);
     nats_unlockSubAndDispatcher(sub);
 }
 
@@ -1130,10 +1184,10 @@ natsSubscription_GetPending(natsSubscription *sub, int *msgs, int *bytes)
     }
 
     if (msgs != NULL)
-        *msgs = sub->ownDispatcher.queue.msgs;
+        *msgs = nats_atomicLoadInt(&sub->ownDispatcher.queue.msgs);
 
     if (bytes != NULL)
-        *bytes = sub->ownDispatcher.queue.bytes;
+        *bytes = nats_atomicLoadInt(&sub->ownDispatcher.queue.bytes);
 
     nats_unlockSubAndDispatcher(sub);
 
@@ -1205,7 +1259,7 @@ natsSubscription_GetDelivered(natsSubscription *sub, int64_t *msgs)
         return nats_setDefaultError(NATS_INVALID_SUBSCRIPTION);
     }
 
-    *msgs = (int64_t)sub->delivered;
+    *msgs = (int64_t)nats_atomicLoad64(&sub->delivered);
 
     nats_unlockSubAndDispatcher(sub);
 
@@ -1248,10 +1302,10 @@ natsSubscription_GetMaxPending(natsSubscription *sub, int *msgs, int *bytes)
     }
 
     if (msgs != NULL)
-        *msgs = sub->msgsMax;
+        *msgs = nats_atomicLoadInt(&sub->msgsMax);
 
     if (bytes != NULL)
-        *bytes = sub->bytesMax;
+        *bytes = nats_atomicLoadInt(&sub->bytesMax);
 
     nats_unlockSubAndDispatcher(sub);
 
@@ -1271,8 +1325,8 @@ natsSubscription_ClearMaxPending(natsSubscription *sub)
         return nats_setDefaultError(NATS_INVALID_SUBSCRIPTION);
     }
 
-    sub->msgsMax = 0;
-    sub->bytesMax = 0;
+    nats_atomicStoreInt(&sub->msgsMax, 0);
+    nats_atomicStoreInt(&sub->bytesMax, 0);
 
     nats_unlockSubAndDispatcher(sub);
 
@@ -1301,19 +1355,19 @@ natsSubscription_GetStats(natsSubscription *sub,
 
     // messages and bytes are up to date even with a shared dispatcher.
     if (pendingMsgs != NULL)
-        *pendingMsgs = sub->ownDispatcher.queue.msgs;
+        *pendingMsgs = nats_atomicLoadInt(&sub->ownDispatcher.queue.msgs);
 
     if (pendingBytes != NULL)
-        *pendingBytes = sub->ownDispatcher.queue.bytes;
+        *pendingBytes = nats_atomicLoadInt(&sub->ownDispatcher.queue.bytes);
 
     if (maxPendingMsgs != NULL)
-        *maxPendingMsgs = sub->msgsMax;
+        *maxPendingMsgs = nats_atomicLoadInt(&sub->msgsMax);
 
     if (maxPendingBytes != NULL)
-        *maxPendingBytes = sub->bytesMax;
+        *maxPendingBytes = nats_atomicLoadInt(&sub->bytesMax);
 
     if (deliveredMsgs != NULL)
-        *deliveredMsgs = (int)sub->delivered;
+        *deliveredMsgs = (int)nats_atomicLoad64(&sub->delivered);
 
     if (droppedMsgs != NULL)
         *droppedMsgs = sub->dropped;
@@ -43,6 +43,14 @@ typedef struct __natsTimer
     int64_t             interval;
     int64_t             absoluteTime;
 
+    // Shard of the library's timers, selected when the timer is created.
+    struct __natsLibTimers  *shard;
+
+    // Position in the shard's timing wheel, level is -1 when the timer
+    // is about to fire.
+    int                 wheelLevel;
+    int                 wheelSlot;
+
     bool                stopped;
     bool                inCallback;
 
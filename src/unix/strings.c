@@ -0,0 +1,50 @@
+// Copyright 2026 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "../natsp.h"
+#include "../mem.h"
+
+// Same as asprintf(), but the string is allocated with NATS_MALLOC so that
+// it can be released with NATS_FREE even when a custom allocator is set.
+int
+nats_asprintf(char **newStr, const char *fmt, ...)
+{
+    char    *str;
+    int     n;
+    va_list ap;
+
+    va_start(ap, fmt);
+    n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+
+    if (n < 0)
+        return -1;
+
+    str = NATS_MALLOC(n + 1);
+    if (str == NULL)
+        return -1;
+
+    va_start(ap, fmt);
+    n = vsnprintf(str, n + 1, fmt, ap);
+    va_end(ap);
+
+    if (n < 0)
+    {
+        NATS_FREE(str);
+        return -1;
+    }
+
+    *newStr = str;
+
+    return n;
+}
@@ -392,6 +392,10 @@ nats_NormalizeErr(char *error)
     error[len] = '\0';
 }
 
+// Allocations made by the JSON parser are accounted as JSON allocations.
+#undef  NATS_MEM_CATEGORY
+#define NATS_MEM_CATEGORY   natsAlloc_JSON
+
 static natsStatus
 _jsonCreateField(nats_JSONField **newField, char *fieldName)
 {
@@ -1658,6 +1662,9 @@ nats_JSONDestroy(nats_JSON *json)
     NATS_FREE(json);
 }
 
+#undef  NATS_MEM_CATEGORY
+#define NATS_MEM_CATEGORY   natsAlloc_Other
+
 natsStatus
 nats_EncodeTimeUTC(char *buf, size_t bufLen, int64_t timeUTC)
 {
@@ -2863,3 +2870,39 @@ nats_encodeRespID(char *buffer, uint64_t id, bool shortest)
     }
     buffer[NATS_MAX_RESP_ID_LEN] = '\0';
 }
+
+// Decodes a response ID encoded with nats_encodeRespID() (without the
+// `shortest` option), that is, exactly NATS_MAX_RESP_ID_LEN characters.
+// Returns false if `buffer` does not hold such an encoded ID.
+bool
+nats_decodeRespID(const char *buffer, int len, uint64_t *id)
+{
+    uint64_t    val = 0;
+    int         i;
+
+    if (len != NATS_MAX_RESP_ID_LEN)
+        return false;
+
+    // Digits are stored with the least significant one first.
+    for (i=NATS_MAX_RESP_ID_LEN-1; i>=0; i--)
+    {
+        char        c = buffer[i];
+        uint64_t    d;
+
+        if ((c >= '0') && (c <= '9'))
+            d = (uint64_t) (c - '0');
+        else if ((c >= 'A') && (c <= 'Z'))
+            d = (uint64_t) (c - 'A' + 10);
+        else if ((c >= 'a') && (c <= 'z'))
+            d = (uint64_t) (c - 'a' + 36);
+        else
+            return false;
+
+        if (val > ((UINT64_MAX - d) / (uint64_t) respIDBase))
+            return false;
+
+        val = val * (uint64_t) respIDBase + d;
+    }
+    *id = val;
+    return true;
+}
@@ -305,4 +305,7 @@ nats_marshalHeader(natsBuffer *buf, bool omitEmpty, bool comma, const char *fiel
 void
 nats_encodeRespID(char *buffer, uint64_t id, bool shortest);
 
+bool
+nats_decodeRespID(const char *buffer, int len, uint64_t *id);
+
 #endif /* UTIL_H_ */
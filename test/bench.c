@@ -12,6 +12,7 @@
 // limitations under the License.
 
 #include "test.h"
+#include "../src/conn.h"
 #include "../src/sub.h"
 
 #define REPEAT 5
@@ -452,6 +453,7 @@ struct _benchArg
     jsCtx           *js;
     natsStatus      s;
     int             count;
+    int64_t         maxWait;
     int             ready;
     int             done;
     bool            go;
@@ -617,6 +619,8 @@ struct _benchJSPubAsync
     int                 count;
     int                 maxPending;
     bool                muxReplies;
+    int64_t             maxWait;
+    bool                adaptive;
 
 };
 
@@ -627,11 +631,14 @@ _benchJSPubAsync(void *closure)
     jsCtx               *js     = NULL;
     int                 count   = 0;
     natsStatus          s       = NATS_OK;
+    jsPubOptions        po;
     int                 i;
 
     natsMutex_Lock(arg->mu);
     count = arg->count;
     js  = arg->js;
+    jsPubOptions_Init(&po);
+    po.MaxWait = arg->maxWait;
     arg->ready++;
     natsCondition_Broadcast(arg->cond);
     while (!arg->go)
@@ -639,7 +646,7 @@ _benchJSPubAsync(void *closure)
     natsMutex_Unlock(arg->mu);
 
     for (i=0; (s == NATS_OK) && (i < count); i++)
-        s = js_PublishAsync(js, "foo", NULL, 0, NULL);
+        s = js_PublishAsync(js, "foo", NULL, 0, (po.MaxWait > 0 ? &po : NULL));
 
     // Wait for all async publish to complete.
     if (s == NATS_OK)
@@ -686,14 +693,18 @@ void test_BenchJetStreamPubAsync(void)
     char                tn[64];
     struct _benchArg    arg;
     struct _benchJSPubAsync tests[] = {
-      {1, 1000000, 1000, false},
-      {1, 1000000, 1000, true},
-      {1, 1000000, 5000, false},
-      {1, 1000000, 5000, true},
-      {2, 500000, 1000, false},
-      {2, 500000, 1000, true},
-      {2, 500000, 5000, false},
-      {2, 500000, 5000, true},
+      {1, 1000000, 1000, false, 0, false},
+      {1, 1000000, 1000, true, 0, false},
+      {1, 1000000, 5000, false, 0, false},
+      {1, 1000000, 5000, true, 0, false},
+      {2, 500000, 1000, false, 0, false},
+      {2, 500000, 1000, true, 0, false},
+      {2, 500000, 5000, false, 0, false},
+      {2, 500000, 5000, true, 0, false},
+      {1, 1000000, 5000, false, 5000, false},
+      {1, 1000000, 5000, true, 5000, false},
+      {1, 1000000, 0, false, 0, true},
+      {2, 500000, 0, false, 0, true},
     };
 
     memset(&arg, 0, sizeof(struct _benchArg));
@@ -735,6 +746,7 @@ void test_BenchJetStreamPubAsync(void)
                 jsOpts.PublishAsync.ErrHandlerClosure   = (void*) &arg;
                 jsOpts.PublishAsync.MaxPending          = (int64_t) tests[i].maxPending;
                 jsOpts.PublishAsync.MuxReplies          = tests[i].muxReplies;
+                jsOpts.PublishAsync.AdaptiveMaxPending  = tests[i].adaptive;
                 s = natsConnection_JetStream(&js1, arg.conn, &jsOpts);
             }
 
@@ -757,6 +769,7 @@ void test_BenchJetStreamPubAsync(void)
 
                 natsMutex_Lock(arg.mu);
                 arg.count   = total / nt;
+                arg.maxWait = b->maxWait;
                 arg.ready   = 0;
                 arg.done    = 0;
                 arg.go      = false;
@@ -765,6 +778,16 @@ void test_BenchJetStreamPubAsync(void)
 
                 snprintf(tn, sizeof(tn), "Ctxs=%d/MaxPending=%d/MuxReplies=%s",
                     b->ctxs, b->maxPending, (b->muxReplies ? "true" : "false"));
+                if (b->maxWait > 0)
+                {
+                    size_t l = strlen(tn);
+                    snprintf(tn+l, sizeof(tn)-l, "/MaxWait=%d", (int) b->maxWait);
+                }
+                if (b->adaptive)
+                {
+                    size_t l = strlen(tn);
+                    snprintf(tn+l, sizeof(tn)-l, "/Adaptive");
+                }
             }
 
             for (j=0; (s == NATS_OK) && (j < nt); j++)
@@ -861,8 +884,13 @@ _flusherWaitName(int64_t waitUs, char *buf, size_t bufLen)
         snprintf(buf, bufLen, "wait=%dus", (int) waitUs);
 }
 
+#define BENCH_PUB_BATCH_SIZE (1000)
+
 // Measures raw core publish throughput of small messages, for various
-// flusher accumulation waits.
+// flusher accumulation waits, publishing one message at a time, then
+// in batches with natsConnection_PublishBatch(), and then one at a time
+// with a prepared publisher. The batch and prepared results include the
+// speedup compared to the single message publish.
 void test_BenchCorePublishSmall(void)
 {
     natsStatus  s        = NATS_OK;
@@ -870,11 +898,19 @@ void test_BenchCorePublishSmall(void)
     const int   total    = 1000000;
     const char  payload[]= "0123456789abcdef";
     int         numTests = (int) (sizeof(_flusherWaits)/sizeof(*_flusherWaits));
+    natsMsg     *msgs[BENCH_PUB_BATCH_SIZE];
     int         i;
 
-    pid = _startServer("nats://127.0.0.1:4222", NULL, true);
-    if (pid == NATS_INVALID_PID)
-        s = NATS_ERR;
+    memset(msgs, 0, sizeof(msgs));
+    for (i=0; (s == NATS_OK) && (i < BENCH_PUB_BATCH_SIZE); i++)
+        s = natsMsg_Create(&(msgs[i]), "perf", NULL, payload, (int) (sizeof(payload)-1));
+
+    if (s == NATS_OK)
+    {
+        pid = _startServer("nats://127.0.0.1:4222", NULL, true);
+        if (pid == NATS_INVALID_PID)
+            s = NATS_ERR;
+    }
 
     printf("[\n");
     fflush(stdout);
@@ -882,8 +918,11 @@ void test_BenchCorePublishSmall(void)
     {
         natsOptions     *opts = NULL;
         natsConnection  *nc   = NULL;
+        natsPublisher   *pub  = NULL;
         char            tn[64];
         int64_t         dur   = 0;
+        int64_t         bdur  = 0;
+        int64_t         pdur  = 0;
         int             run;
 
         _flusherWaitName(_flusherWaits[i], tn, sizeof(tn));
@@ -905,15 +944,49 @@ void test_BenchCorePublishSmall(void)
                 dur += nats_NowMonotonicInNanoSeconds() - start;
         }
 
+        for (run=0; (s == NATS_OK) && (run < REPEAT); run++)
+        {
+            int64_t start = nats_NowMonotonicInNanoSeconds();
+            int     j;
+
+            for (j=0; (s == NATS_OK) && (j < total); j += BENCH_PUB_BATCH_SIZE)
+                s = natsConnection_PublishBatch(nc, msgs, BENCH_PUB_BATCH_SIZE);
+            IFOK(s, natsConnection_Flush(nc));
+            if (s == NATS_OK)
+                bdur += nats_NowMonotonicInNanoSeconds() - start;
+        }
+
+        IFOK(s, natsConnection_PreparePublisher(&pub, nc, "perf"));
+        for (run=0; (s == NATS_OK) && (run < REPEAT); run++)
+        {
+            int64_t start = nats_NowMonotonicInNanoSeconds();
+            int     j;
+
+            for (j=0; (s == NATS_OK) && (j < total); j++)
+                s = natsPublisher_Publish(pub, (const void*) payload, (int) (sizeof(payload)-1));
+            IFOK(s, natsConnection_Flush(nc));
+            if (s == NATS_OK)
+                pdur += nats_NowMonotonicInNanoSeconds() - start;
+        }
+
         if (s == NATS_OK)
         {
             const char *comma = (i < numTests-1 ? "," : "");
 
             dur /= REPEAT;
-            printf("\t{\"name\":\"%s\",\"perf\":%d}%s\n", tn, (int)(((int64_t)total * 1E9L) / dur), comma);
+            bdur /= REPEAT;
+            pdur /= REPEAT;
+            printf("\t{\"name\":\"%s\",\"perf\":%d},\n", tn, (int)(((int64_t)total * 1E9L) / dur));
+            printf("\t{\"name\":\"%s,batch=%d\",\"perf\":%d,\"speedup\":%.2f},\n",
+                   tn, BENCH_PUB_BATCH_SIZE, (int)(((int64_t)total * 1E9L) / bdur),
+                   (double) dur / (double) bdur);
+            printf("\t{\"name\":\"%s,prepared\",\"perf\":%d,\"speedup\":%.2f}%s\n",
+                   tn, (int)(((int64_t)total * 1E9L) / pdur),
+                   (double) dur / (double) pdur, comma);
             fflush(stdout);
         }
 
+        natsPublisher_Destroy(pub);
         natsConnection_Destroy(nc);
         natsOptions_Destroy(opts);
     }
@@ -922,6 +995,9 @@ void test_BenchCorePublishSmall(void)
 
     _stopServer(pid);
 
+    for (i=0; i < BENCH_PUB_BATCH_SIZE; i++)
+        natsMsg_Destroy(msgs[i]);
+
     if (s != NATS_OK)
     {
         printf("Error: %d (%s)\n", s, natsStatus_GetText(s));
@@ -1151,3 +1227,384 @@ void test_BenchCorePublishLatency(void)
 
     testCond(s == NATS_OK);
 }
+
+static void
+_benchTimerCb(natsTimer *timer, void *closure) {}
+
+// Measures the cost of creating, resetting and destroying a large number of
+// library timers, such as the ones of subscriptions with a timeout. Timers
+// are spread over a minute so that none fires during the benchmark.
+void test_BenchTimers(void)
+{
+    natsStatus  s       = NATS_OK;
+    const int   total   = 100000;
+    natsTimer   **timers;
+    int64_t     create  = 0;
+    int64_t     reset   = 0;
+    int64_t     destroy = 0;
+    int         run;
+    int         i;
+
+    timers = (natsTimer**) calloc(total, sizeof(natsTimer*));
+    if (timers == NULL)
+        s = NATS_NO_MEMORY;
+
+    for (run=0; (s == NATS_OK) && (run < REPEAT); run++)
+    {
+        int64_t start = nats_NowMonotonicInNanoSeconds();
+
+        for (i=0; (s == NATS_OK) && (i < total); i++)
+            s = natsTimer_Create(&(timers[i]), _benchTimerCb, NULL, 60000 + (((int64_t) i * 7919) % 60000), NULL);
+        if (s != NATS_OK)
+            break;
+        create += nats_NowMonotonicInNanoSeconds() - start;
+
+        start = nats_NowMonotonicInNanoSeconds();
+        for (i=0; i < total; i++)
+            natsTimer_Reset(timers[i], 60000 + (((int64_t) i * 104729) % 60000));
+        reset += nats_NowMonotonicInNanoSeconds() - start;
+
+        start = nats_NowMonotonicInNanoSeconds();
+        for (i=0; i < total; i++)
+        {
+            natsTimer_Destroy(timers[i]);
+            timers[i] = NULL;
+        }
+        destroy += nats_NowMonotonicInNanoSeconds() - start;
+    }
+
+    if (s == NATS_OK)
+    {
+        printf("[\n");
+        printf("\t{\"name\":\"create\",\"timers\":%d,\"perf\":%d},\n", total, (int)(((int64_t)total * REPEAT * 1E9L) / create));
+        printf("\t{\"name\":\"reset\",\"timers\":%d,\"perf\":%d},\n", total, (int)(((int64_t)total * REPEAT * 1E9L) / reset));
+        printf("\t{\"name\":\"destroy\",\"timers\":%d,\"perf\":%d}\n", total, (int)(((int64_t)total * REPEAT * 1E9L) / destroy));
+        printf("]\n");
+        fflush(stdout);
+    }
+    else
+    {
+        for (i=0; i < total; i++)
+            natsTimer_Destroy(timers[i]);
+        printf("Error: %d (%s)\n", s, natsStatus_GetText(s));
+        nats_PrintLastErrorStack(stdout);
+        fflush(stdout);
+    }
+    free(timers);
+
+    testCond(s == NATS_OK);
+}
+
+// Baseline for test_BenchHash: the separate chaining table that natsHash
+// used before it switched to open addressing (one allocation per entry,
+// bucket count kept at or above the number of entries).
+typedef struct __benchChainEntry
+{
+    int64_t                     key;
+    void                        *data;
+    struct __benchChainEntry    *next;
+
+} benchChainEntry;
+
+typedef struct
+{
+    benchChainEntry **bkts;
+    int             numBkts;
+    int             mask;
+    int             used;
+
+} benchChainHash;
+
+static void
+_benchChainResize(benchChainHash *h, int newSize)
+{
+    benchChainEntry **bkts = (benchChainEntry**) calloc(newSize, sizeof(benchChainEntry*));
+    benchChainEntry *e, *ne;
+    int             k;
+
+    if (bkts == NULL)
+        return;
+
+    for (k = 0; k < h->numBkts; k++)
+    {
+        for (e = h->bkts[k]; e != NULL; e = ne)
+        {
+            ne = e->next;
+            e->next = bkts[e->key & (newSize - 1)];
+            bkts[e->key & (newSize - 1)] = e;
+        }
+    }
+    free(h->bkts);
+    h->bkts    = bkts;
+    h->numBkts = newSize;
+    h->mask    = newSize - 1;
+}
+
+static bool
+_benchChainSet(benchChainHash *h, int64_t key, void *data)
+{
+    benchChainEntry *e;
+
+    for (e = h->bkts[key & h->mask]; e != NULL; e = e->next)
+    {
+        if (e->key == key)
+        {
+            e->data = data;
+            return true;
+        }
+    }
+    e = (benchChainEntry*) malloc(sizeof(benchChainEntry));
+    if (e == NULL)
+        return false;
+
+    e->key  = key;
+    e->data = data;
+    e->next = h->bkts[key & h->mask];
+    h->bkts[key & h->mask] = e;
+    if (++(h->used) > h->numBkts)
+        _benchChainResize(h, h->numBkts * 2);
+
+    return true;
+}
+
+static void*
+_benchChainGet(benchChainHash *h, int64_t key)
+{
+    benchChainEntry *e;
+
+    for (e = h->bkts[key & h->mask]; e != NULL; e = e->next)
+    {
+        if (e->key == key)
+            return e->data;
+    }
+    return NULL;
+}
+
+static void*
+_benchChainRemove(benchChainHash *h, int64_t key)
+{
+    benchChainEntry **e;
+    benchChainEntry *re;
+    void            *data;
+
+    for (e = &(h->bkts[key & h->mask]); *e != NULL; e = &((*e)->next))
+    {
+        if ((*e)->key == key)
+        {
+            re   = *e;
+            data = re->data;
+            *e   = re->next;
+            free(re);
+            if ((--(h->used) < h->numBkts / 4) && (h->numBkts > 8))
+                _benchChainResize(h, h->numBkts / 2);
+            return data;
+        }
+    }
+    return NULL;
+}
+
+#define BENCH_HASH_GET_PASSES (10)
+
+void test_BenchHash(void)
+{
+    natsStatus      s         = NATS_OK;
+    const int       total     = 100000;
+    const char      *names[]  = {"sequential", "scattered"};
+    int64_t         stride[]  = {1, 7919};
+    int64_t         t[2][3];
+    benchChainHash  ch;
+    natsHash        *hash     = NULL;
+    int             *order    = NULL;
+    void            *p        = NULL;
+    uint32_t        rnd       = 12345;
+    int64_t         start;
+    int64_t         key;
+    int             kind;
+    int             impl;
+    int             run;
+    int             i, j, tmp;
+
+    // Keys are inserted in increasing order, the way SIDs are assigned,
+    // but looked up and removed in a shuffled order, the way messages for
+    // many subscriptions would arrive.
+    order = (int*) calloc(total, sizeof(int));
+    if (order == NULL)
+        s = NATS_NO_MEMORY;
+    for (i=0; (s == NATS_OK) && (i < total); i++)
+        order[i] = i + 1;
+    for (i=total-1; (s == NATS_OK) && (i > 0); i--)
+    {
+        rnd = rnd * 1103515245 + 12345;
+        j   = (int) ((rnd >> 8) % (uint32_t) (i + 1));
+        tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    printf("[\n");
+    for (kind=0; (s == NATS_OK) && (kind < 2); kind++)
+    {
+        memset(t, 0, sizeof(t));
+        for (run=0; (s == NATS_OK) && (run < REPEAT); run++)
+        {
+            for (impl=0; (s == NATS_OK) && (impl < 2); impl++)
+            {
+                memset(&ch, 0, sizeof(ch));
+                if (impl == 0)
+                {
+                    s = natsHash_Create(&hash, 8);
+                }
+                else
+                {
+                    ch.bkts = (benchChainEntry**) calloc(8, sizeof(benchChainEntry*));
+                    ch.numBkts = 8;
+                    ch.mask = 7;
+                    if (ch.bkts == NULL)
+                        s = NATS_NO_MEMORY;
+                }
+                if (s != NATS_OK)
+                    break;
+
+                start = nats_NowMonotonicInNanoSeconds();
+                for (i=1; (s == NATS_OK) && (i <= total); i++)
+                {
+                    key = i * stride[kind];
+                    if (impl == 0)
+                        s = natsHash_Set(hash, key, (void*) (intptr_t) i, NULL);
+                    else if (!_benchChainSet(&ch, key, (void*) (intptr_t) i))
+                        s = NATS_NO_MEMORY;
+                }
+                t[impl][0] += nats_NowMonotonicInNanoSeconds() - start;
+
+                start = nats_NowMonotonicInNanoSeconds();
+                for (j=0; (s == NATS_OK) && (j < BENCH_HASH_GET_PASSES); j++)
+                {
+                    for (i=0; (s == NATS_OK) && (i < total); i++)
+                    {
+                        key = order[i] * stride[kind];
+                        if (impl == 0)
+                            p = natsHash_Get(hash, key);
+                        else
+                            p = _benchChainGet(&ch, key);
+                        if (p != (void*) (intptr_t) order[i])
+                            s = NATS_ERR;
+                    }
+                }
+                t[impl][1] += nats_NowMonotonicInNanoSeconds() - start;
+
+                start = nats_NowMonotonicInNanoSeconds();
+                for (i=0; i < total; i++)
+                {
+                    key = order[i] * stride[kind];
+                    if (impl == 0)
+                        (void) natsHash_Remove(hash, key);
+                    else
+                        (void) _benchChainRemove(&ch, key);
+                }
+                t[impl][2] += nats_NowMonotonicInNanoSeconds() - start;
+
+                if ((s == NATS_OK) && (((impl == 0) ? natsHash_Count(hash) : ch.used) != 0))
+                    s = NATS_ERR;
+
+                natsHash_Destroy(hash);
+                hash = NULL;
+                free(ch.bkts);
+            }
+        }
+        for (impl=0; (s == NATS_OK) && (impl < 2); impl++)
+        {
+            printf("\t{\"name\":\"%s\",\"keys\":\"%s\",\"entries\":%d,\"set\":%d,\"get\":%d,\"remove\":%d}%s\n",
+                   (impl == 0 ? "open_addressing" : "chaining"), names[kind], total,
+                   (int)(((int64_t)total * REPEAT * 1E9L) / t[impl][0]),
+                   (int)(((int64_t)total * REPEAT * BENCH_HASH_GET_PASSES * 1E9L) / t[impl][1]),
+                   (int)(((int64_t)total * REPEAT * 1E9L) / t[impl][2]),
+                   ((kind == 1) && (impl == 1) ? "" : ","));
+        }
+    }
+    printf("]\n");
+    if (s != NATS_OK)
+    {
+        printf("Error: %d (%s)\n", s, natsStatus_GetText(s));
+        nats_PrintLastErrorStack(stdout);
+    }
+    fflush(stdout);
+    free(order);
+
+    testCond(s == NATS_OK);
+}
+
+static void
+_benchParserDropMsg(natsConnection *nc, natsMsg **msg, void *closure)
+{
+    natsMsg_Destroy(*msg);
+    *msg = NULL;
+}
+
+void test_BenchParser(void)
+{
+    natsStatus      s        = NATS_OK;
+    natsConnection  *nc      = NULL;
+    natsOptions     *opts    = NULL;
+    const int       perBuf   = 1000;
+    const int       rounds   = 1000;
+    const char      *names[] = {"msg_fast_path", "msg_state_machine", "hmsg_fast_path", "hmsg_state_machine"};
+    const char      *protos[]= {"MSG foo.bar 1 5\r\nhello\r\n",
+                                "msg foo.bar 1 5\r\nhello\r\n",
+                                "HMSG foo.bar 1 _INBOX.abcdef 12 17\r\nNATS/1.0\r\n\r\nhello\r\n",
+                                "hmsg foo.bar 1 _INBOX.abcdef 12 17\r\nNATS/1.0\r\n\r\nhello\r\n"};
+    char            *buf     = NULL;
+    int             kind;
+    int             len;
+    int             i;
+
+    // Use the message pool so that message allocation does not dominate.
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsOptions_UseMessagePool(opts, true, 0));
+    IFOK(s, natsConn_create(&nc, opts));
+    IFOK(s, natsParser_Create(&(nc->ps)));
+    if (s == NATS_OK)
+    {
+        buf = (char*) malloc(perBuf * 128);
+        if (buf == NULL)
+            s = NATS_NO_MEMORY;
+    }
+    // Keep message creation in the measure, as it is part of parsing, but
+    // drop the messages before the subscription lookup.
+    if (s == NATS_OK)
+        natsConn_setFilter(nc, _benchParserDropMsg);
+
+    printf("[\n");
+    for (kind=0; (s == NATS_OK) && (kind < 4); kind++)
+    {
+        int64_t start;
+        int64_t elapsed;
+
+        len = 0;
+        for (i=0; i<perBuf; i++)
+        {
+            memcpy(buf + len, protos[kind], strlen(protos[kind]));
+            len += (int) strlen(protos[kind]);
+        }
+
+        start = nats_NowMonotonicInNanoSeconds();
+        for (i=0; (s == NATS_OK) && (i < rounds); i++)
+            s = natsParser_Parse(nc, buf, len);
+        elapsed = nats_NowMonotonicInNanoSeconds() - start;
+
+        if (s == NATS_OK)
+            printf("\t{\"name\":\"%s\",\"messages\":%d,\"perf\":%d}%s\n", names[kind], perBuf * rounds,
+                   (int)(((int64_t)perBuf * rounds * 1E9L) / elapsed), (kind == 3 ? "" : ","));
+    }
+    printf("]\n");
+    if (s != NATS_OK)
+    {
+        printf("Error: %d (%s)\n", s, natsStatus_GetText(s));
+        nats_PrintLastErrorStack(stdout);
+    }
+    fflush(stdout);
+
+    free(buf);
+    natsConnection_Destroy(nc);
+
+    testCond(s == NATS_OK);
+}